@@ -655,6 +655,60 @@ static int stub_flash_clear_bp(uint32_t bp_flash_addr, uint32_t insn_buf_addr, u
 	return ESP_XTENSA_STUB_ERR_OK;
 }
 
+/* Applies a list of flash breakpoint operations. All operations falling into the same
+ * sector are done with single read-erase-write cycle. */
+static int stub_flash_bp_batch(struct esp_xtensa_flash_bp_op *ops, uint32_t num, uint8_t *insn_sect)
+{
+	esp_rom_spiflash_result_t rc;
+	union {
+		uint32_t d32;
+		uint8_t d8[4];
+	} break_insn;
+
+	STUB_LOGD("%s: %d ops @ 0x%x\n", __func__, num, ops);
+
+	for (uint32_t i = 0; i < num; ) {
+		uint32_t sect_addr = ops[i].flash_addr & ~(STUB_FLASH_SECTOR_SIZE - 1);
+		uint32_t end_addr = sect_addr;
+		uint32_t k;
+
+		rc = esp_rom_spiflash_read(sect_addr, (uint32_t *)insn_sect, STUB_BP_INSN_SECT_BUF_SIZE);
+		if (rc != ESP_ROM_SPIFLASH_RESULT_OK) {
+			STUB_LOGE("Failed to read insn sector (%d)!\n", rc);
+			return ESP_XTENSA_STUB_ERR_FAIL;
+		}
+		for (k = i; k < num &&
+			(ops[k].flash_addr & ~(STUB_FLASH_SECTOR_SIZE - 1)) == sect_addr; k++) {
+			uint8_t *insn = &insn_sect[ops[k].flash_addr - sect_addr];
+			if (ops[k].op == ESP_XTENSA_STUB_FLASH_BP_OP_SET) {
+				ops[k].insn_sz = xtensa_get_insn_size(insn);
+				memcpy(ops[k].insn, insn, ops[k].insn_sz);
+				break_insn.d32 = ops[k].insn_sz == 2 ? XT_INS_BREAKN : XT_INS_BREAK;
+				memcpy(insn, break_insn.d8, ops[k].insn_sz);
+			} else {
+				memcpy(insn, ops[k].insn, ops[k].insn_sz);
+			}
+			if (ops[k].flash_addr + ops[k].insn_sz > end_addr)
+				end_addr = ops[k].flash_addr + ops[k].insn_sz;
+		}
+		/* this will erase full sector or two */
+		if (stub_flash_erase(sect_addr, end_addr - sect_addr) != ESP_XTENSA_STUB_ERR_OK) {
+			STUB_LOGE("Failed to erase insn sector!\n");
+			return ESP_XTENSA_STUB_ERR_FAIL;
+		}
+		rc = esp_rom_spiflash_write(sect_addr, (uint32_t *)insn_sect, STUB_BP_INSN_SECT_BUF_SIZE);
+		if (rc != ESP_ROM_SPIFLASH_RESULT_OK) {
+			STUB_LOGE("Failed to write insn sector (%d)!\n", rc);
+			return ESP_XTENSA_STUB_ERR_FAIL;
+		}
+		STUB_LOGI("Applied %d BP ops in sector 0x%x\n", k - i, sect_addr);
+		i = k;
+	}
+	stub_flash_cache_flush();
+
+	return ESP_XTENSA_STUB_ERR_OK;
+}
+
 static int stub_flash_handler(int cmd, va_list ap)
 {
 	int ret = ESP_XTENSA_STUB_ERR_OK;
@@ -714,6 +768,9 @@ static int stub_flash_handler(int cmd, va_list ap)
 		case ESP_XTENSA_STUB_CMD_FLASH_BP_CLEAR:
 			ret = stub_flash_clear_bp(arg1, arg2, arg3);
 			break;
+		case ESP_XTENSA_STUB_CMD_FLASH_BP_BATCH:
+			ret = stub_flash_bp_batch((struct esp_xtensa_flash_bp_op *)arg1, arg2, arg3);
+			break;
 #if STUB_DEBUG
 		case ESP_XTENSA_STUB_CMD_FLASH_TEST:
 			ret = stub_flash_test();
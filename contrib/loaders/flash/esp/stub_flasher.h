@@ -34,7 +34,8 @@
 #define ESP_XTENSA_STUB_CMD_FLASH_BP_SET        6
 #define ESP_XTENSA_STUB_CMD_FLASH_BP_CLEAR      7
 #define ESP_XTENSA_STUB_CMD_FLASH_TEST          8
-#define ESP_XTENSA_STUB_CMD_FLASH_MAX_ID        ESP_XTENSA_STUB_CMD_FLASH_TEST
+#define ESP_XTENSA_STUB_CMD_FLASH_BP_BATCH      9
+#define ESP_XTENSA_STUB_CMD_FLASH_MAX_ID        ESP_XTENSA_STUB_CMD_FLASH_BP_BATCH
 #define ESP_XTENSA_STUB_CMD_TEST                (ESP_XTENSA_STUB_CMD_FLASH_MAX_ID+2)
 
 #define ESP_XTENSA_STUB_FLASH_MAPPINGS_MAX_NUM  2	/* IROM, DROM */
@@ -50,4 +51,19 @@ struct esp_xtensa_flash_mapping {
 	struct esp_xtensa_flash_region_mapping maps[ESP_XTENSA_STUB_FLASH_MAPPINGS_MAX_NUM];
 };
 
+#define ESP_XTENSA_STUB_FLASH_BP_OP_SET        1
+#define ESP_XTENSA_STUB_FLASH_BP_OP_CLEAR      2
+
+/* Flash breakpoint operation for ESP_XTENSA_STUB_CMD_FLASH_BP_BATCH.
+ * Operations are sorted by address, so ones in the same sector go in a row. */
+struct esp_xtensa_flash_bp_op {
+	uint32_t flash_addr;
+	uint8_t op;
+	/* set: out, original insn size; clear: in, original insn size */
+	uint8_t insn_sz;
+	/* set: out, original insn; clear: in, insn to restore */
+	uint8_t insn[3];
+	uint8_t reserved[3];
+};
+
 #endif	/*ESP_XTENSA_FLASHER_STUB_H */
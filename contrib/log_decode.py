@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""
+Decode a binary OpenOCD log written with "log_async binary" into the usual
+text form, covered by GNU GPLv2 or later.
+
+Usage: ./log_decode.py openocd.log [--level N]
+"""
+
+import argparse
+import struct
+import sys
+
+MAGIC = b"OCDLOG\0\1"
+HEADER = struct.Struct("<IIqIbBHHH")
+LOG_LVL_OUTPUT = -2
+LOG_LVL_USER = -1
+LEVELS = {
+    LOG_LVL_USER: "User : ",
+    0: "Error: ",
+    1: "Warn : ",
+    2: "Info : ",
+    3: "Debug: ",
+    4: "Debug: ",
+}
+
+
+def records(data):
+    pos = len(MAGIC)
+    while pos + HEADER.size <= len(data):
+        size, count, time, line, level, verbose, file_len, func_len, _ = \
+            HEADER.unpack_from(data, pos)
+        body = data[pos + HEADER.size:pos + 4 + size]
+        pos += 4 + size
+        file = body[:file_len].decode(errors="replace")
+        func = body[file_len:file_len + func_len].decode(errors="replace")
+        text = body[file_len + func_len:].decode(errors="replace")
+        yield level, count, time, file, line, func, text, verbose
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("file", help="binary log file")
+    parser.add_argument("--level", type=int, default=4,
+                        help="highest log level to print (default: %(default)s)")
+    args = parser.parse_args()
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+    if not data.startswith(MAGIC):
+        sys.exit("%s: not a binary OpenOCD log" % args.file)
+
+    out = sys.stdout
+    for level, count, time, file, line, func, text, verbose in records(data):
+        if level > args.level:
+            continue
+        if level == LOG_LVL_OUTPUT:
+            out.write(text)
+        elif verbose:
+            out.write("%s%d %d %s:%d %s(): %s" % (LEVELS[level], count, time,
+                                                  file, line, func, text))
+        else:
+            out.write("%s%s" % (LEVELS[level] if level > LOG_LVL_USER else "", text))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,941 @@
+/***************************************************************************
+ *   Simulated Xtensa OCD endpoint for the remote_bitbang driver           *
+ *   Copyright (C) 2020 Espressif Systems Ltd.                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+/*
+  This is a remote bitbang server which simulates the JTAG side of an
+  ESP32-like chip: a chain of Xtensa TAPs, the Debug Module registers
+  reachable through NARSEL (OCD, TRAX, PWRCTL/PWRSTAT) and just enough of
+  the core to execute the instructions OpenOCD feeds through DIR0EXEC to
+  access registers and memory. It lets the JTAG/Xtensa layers of OpenOCD
+  be profiled without an adapter or a board: every TCK cycle, IR/DR scan
+  and Debug Module access is counted and reported when OpenOCD
+  disconnects, together with the wall time of the session.
+
+  What is modelled:
+  - IEEE 1149.1 TAP state machine, IDCODE/BYPASS/PWRCTL/PWRSTAT/NARSEL,
+  - OCD registers (OCDID, DCRSET/DCRCLR, DSR, DDR, DDREXEC, DIR0, DIR0EXEC),
+    debug interrupt halt, BreakIn/BreakOut between cores, RFDO resume,
+  - 64 windowed address registers, special, user and FP registers,
+  - RSR/WSR/XSR, RUR/WUR, RFR/WFR, ROTW, LDDR32P/SDDR32P, L8UI/L16UI/L32I,
+    S8I/S16I/S32I; any other instruction is executed as a NOP,
+  - ESP32 internal memories and peripheral space (RAM backed), accesses
+    outside of them raise EXECEXCEPTION,
+  - TRAX memory and the application tracing control register: while the
+    first core runs and the host is connected it keeps producing blocks of
+    '-a' bytes, so "esp32 apptrace" throughput can be measured.
+
+  Besides the ASCII protocol the server understands the packed clock
+  commands negotiated by "remote_bitbang_binary on".
+
+  Not modelled: flash and its memory mapped regions, code execution (so no
+  flasher stubs or other target algorithms), reset halt, breakpoints.
+
+  To compile run:
+  gcc -Wall -O2 -std=gnu99 -o xtensa_ocd_sim xtensa_ocd_sim.c
+
+  Usage example:
+
+  Listen on TCP port 5555 (default):
+  ./xtensa_ocd_sim -p 5555
+
+  Or serve a single session on stdin/stdout:
+  socat TCP-LISTEN:5555,reuseaddr,fork EXEC:"./xtensa_ocd_sim -p 0"
+
+  Then run:
+  openocd -f contrib/remote_bitbang/xtensa_ocd_sim.cfg \
+	  -f contrib/remote_bitbang/xtensa_ocd_sim_bench.tcl -c "sim_bench; shutdown"
+
+  Options:
+  -p <port>   TCP port to listen on, 0 to use stdin/stdout (default 5555)
+  -c <cores>  number of TAPs/cores in the chain, 1 or 2 (default 2)
+  -a <bytes>  application trace block size, 0 disables (default 16384)
+  -v          log every unknown instruction and faulting access
+*/
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#define LOG_ERROR(...)		do {					\
+		fprintf(stderr, __VA_ARGS__);				\
+		fputc('\n', stderr);					\
+	} while (0)
+#define LOG_INFO(...)		LOG_ERROR(__VA_ARGS__)
+#define LOG_DEBUG(...)		do {					\
+		if (verbose)						\
+			LOG_ERROR(__VA_ARGS__);				\
+	} while (0)
+
+/* values below mirror src/target/xtensa_debug_module.h and xtensa.h */
+#define TAPINS_PWRCTL		0x08
+#define TAPINS_PWRSTAT		0x09
+#define TAPINS_NARSEL		0x1C
+#define TAPINS_IDCODE		0x1E
+#define TAPINS_BYPASS		0x1F
+#define TAP_IR_LEN		5
+#define TAP_IDCODE		0x120034e5
+
+#define NARADR_TRAXID		0x00
+#define NARADR_TRAXCTRL		0x01
+#define NARADR_TRAXSTAT		0x02
+#define NARADR_TRAXDATA		0x03
+#define NARADR_TRAXADDR		0x04
+#define NARADR_TRIGGERPC	0x05
+#define NARADR_PCMATCHCTRL	0x06
+#define NARADR_DELAYCNT		0x07
+#define NARADR_MEMADDRSTART	0x08
+#define NARADR_MEMADDREND	0x09
+#define NARADR_OCDID		0x40
+#define NARADR_DCRCLR		0x42
+#define NARADR_DCRSET		0x43
+#define NARADR_DSR		0x44
+#define NARADR_DDR		0x45
+#define NARADR_DDREXEC		0x46
+#define NARADR_DIR0EXEC		0x47
+#define NARADR_DIR0		0x48
+#define NARADR_MAX		0x7F
+
+#define PWRCTL_JTAGDEBUGUSE	(1 << 7)
+#define PWRCTL_DEBUGRESET	(1 << 6)
+#define PWRCTL_CORERESET	(1 << 4)
+#define PWRSTAT_DEBUGWASRESET	(1 << 6)
+#define PWRSTAT_COREWASRESET	(1 << 4)
+#define PWRSTAT_DOMAINS_ON	0x07
+
+#define OCDDCR_ENABLEOCD	(1 << 0)
+#define OCDDCR_DEBUGINTERRUPT	(1 << 1)
+#define OCDDCR_BREAKINEN	(1 << 16)
+#define OCDDCR_BREAKOUTEN	(1 << 17)
+
+#define OCDDSR_EXECDONE		(1 << 0)
+#define OCDDSR_EXECEXCEPTION	(1 << 1)
+#define OCDDSR_EXECBUSY		(1 << 2)
+#define OCDDSR_EXECOVERRUN	(1 << 3)
+#define OCDDSR_STOPPED		(1 << 4)
+/* status bits the host clears by writing ones to DSR */
+#define OCDDSR_W1C_MASK		0xFFFFFFEF
+
+#define XT_SR_WINDOWBASE	0x48
+#define XT_SR_WINDOWSTART	0x49
+#define XT_SR_DDR		0x68
+#define XT_SR_EPC_DBG		(176 + XT_DEBUG_LEVEL)
+#define XT_SR_EPS_DBG		(192 + XT_DEBUG_LEVEL)
+#define XT_SR_PS		0xE6
+#define XT_SR_DEBUGCAUSE	0xE9
+#define XT_DEBUG_LEVEL		6
+#define XT_DEBUGCAUSE_DI	(1 << 5)
+#define XT_RESET_VECTOR		0x40000400
+
+#define XT_INS_RFDO		0xf1e000
+#define XT_INS_RFDD		0xf1e010
+
+#define SIM_OCDID		0x1C0A3F10
+#define SIM_MAX_TAPS		2
+#define SIM_TRAX_MEM_SZ		0x4000
+
+#define APPTRACE_BLOCK_LEN_MSK	0x7FFFUL
+#define APPTRACE_BLOCK_ID_MSK	0x7FUL
+#define APPTRACE_BLOCK_ID(_id_)	(((_id_) & APPTRACE_BLOCK_ID_MSK) << 15)
+#define APPTRACE_BLOCK_ID_GET(_v_)	(((_v_) >> 15) & APPTRACE_BLOCK_ID_MSK)
+#define APPTRACE_HOST_CONNECT	(1 << 23)
+
+enum tap_state {
+	TAP_RESET, TAP_IDLE,
+	TAP_DRSELECT, TAP_DRCAPTURE, TAP_DRSHIFT, TAP_DREXIT1,
+	TAP_DRPAUSE, TAP_DREXIT2, TAP_DRUPDATE,
+	TAP_IRSELECT, TAP_IRCAPTURE, TAP_IRSHIFT, TAP_IREXIT1,
+	TAP_IRPAUSE, TAP_IREXIT2, TAP_IRUPDATE,
+};
+
+/* next state indexed by [current state][TMS] */
+static const enum tap_state tap_next[16][2] = {
+	[TAP_RESET]	= { TAP_IDLE, TAP_RESET },
+	[TAP_IDLE]	= { TAP_IDLE, TAP_DRSELECT },
+	[TAP_DRSELECT]	= { TAP_DRCAPTURE, TAP_IRSELECT },
+	[TAP_DRCAPTURE]	= { TAP_DRSHIFT, TAP_DREXIT1 },
+	[TAP_DRSHIFT]	= { TAP_DRSHIFT, TAP_DREXIT1 },
+	[TAP_DREXIT1]	= { TAP_DRPAUSE, TAP_DRUPDATE },
+	[TAP_DRPAUSE]	= { TAP_DRPAUSE, TAP_DREXIT2 },
+	[TAP_DREXIT2]	= { TAP_DRSHIFT, TAP_DRUPDATE },
+	[TAP_DRUPDATE]	= { TAP_IDLE, TAP_DRSELECT },
+	[TAP_IRSELECT]	= { TAP_IRCAPTURE, TAP_RESET },
+	[TAP_IRCAPTURE]	= { TAP_IRSHIFT, TAP_IREXIT1 },
+	[TAP_IRSHIFT]	= { TAP_IRSHIFT, TAP_IREXIT1 },
+	[TAP_IREXIT1]	= { TAP_IRPAUSE, TAP_IRUPDATE },
+	[TAP_IRPAUSE]	= { TAP_IRPAUSE, TAP_IREXIT2 },
+	[TAP_IREXIT2]	= { TAP_IRSHIFT, TAP_IRUPDATE },
+	[TAP_IRUPDATE]	= { TAP_IDLE, TAP_DRSELECT },
+};
+
+struct sim_mem_region {
+	const char *name;
+	uint32_t start;
+	uint32_t size;
+	bool writable;
+	uint8_t *data;
+};
+
+/* ESP32 internal memories and peripherals, see src/target/esp32.c */
+static struct sim_mem_region sim_mem_map[] = {
+	{ "dport",	0x3FF00000, 0x00080000, true,  NULL },
+	{ "rtc_fast_d",	0x3FF80000, 0x00002000, true,  NULL },
+	{ "dram",	0x3FFA0000, 0x00060000, true,  NULL },
+	{ "irom_int",	0x40000000, 0x00070000, false, NULL },
+	{ "iram",	0x40070000, 0x00050000, true,  NULL },
+	{ "rtc_fast_i",	0x400C0000, 0x00002000, true,  NULL },
+	{ "rtc_slow",	0x50000000, 0x00002000, true,  NULL },
+};
+
+struct sim_stats {
+	uint64_t bytes_in;
+	uint64_t packets;
+	uint64_t samples;
+	uint64_t tck;
+	uint64_t ir_scans;
+	uint64_t ir_bits;
+	uint64_t dr_scans;
+	uint64_t dr_bits;
+	uint64_t nar_reads;
+	uint64_t nar_writes;
+	uint64_t insns;
+	uint64_t insns_unknown;
+	uint64_t exceptions;
+	uint64_t mem_rd_bytes;
+	uint64_t mem_wr_bytes;
+	uint64_t reg_xfers;
+	uint64_t trax_rd_bytes;
+	uint64_t trace_blocks;
+	uint64_t trace_bytes;
+};
+
+struct sim_core {
+	/* TAP */
+	uint8_t ir;
+	uint64_t shift;
+	int shift_len;
+	bool nar_phase;
+	uint8_t nar;
+	/* Debug Module */
+	uint8_t pwrctl;
+	uint8_t pwrstat;
+	uint32_t dcr;
+	uint32_t dsr;
+	uint32_t ddr;
+	uint32_t dir0;
+	uint32_t trax[NARADR_MEMADDREND + 1];
+	uint8_t trax_mem[SIM_TRAX_MEM_SZ];
+	/* core */
+	uint32_t ar[64];
+	uint32_t sr[256];
+	uint32_t ur[256];
+	uint32_t fr[16];
+};
+
+static struct sim_core sim_cores[SIM_MAX_TAPS];
+static int sim_cores_num = 2;
+static enum tap_state tap_state = TAP_RESET;
+static int last_tck;
+static int last_tdi;
+static int last_tms;
+static uint32_t trace_block_sz = SIM_TRAX_MEM_SZ;
+static uint32_t trace_seq;
+static struct sim_stats stats;
+static int verbose;
+
+static struct sim_mem_region *sim_mem_find(uint32_t addr, uint32_t size)
+{
+	for (size_t i = 0; i < sizeof(sim_mem_map) / sizeof(sim_mem_map[0]); i++) {
+		struct sim_mem_region *r = &sim_mem_map[i];
+		if (addr >= r->start && addr - r->start + size <= r->size)
+			return r;
+	}
+	return NULL;
+}
+
+static bool sim_mem_read(uint32_t addr, uint32_t size, uint32_t *val)
+{
+	struct sim_mem_region *r = sim_mem_find(addr, size);
+
+	if (!r || (addr & (size - 1))) {
+		LOG_DEBUG("read of %u bytes at 0x%08x faulted", size, addr);
+		return false;
+	}
+	*val = 0;
+	memcpy(val, &r->data[addr - r->start], size);
+	stats.mem_rd_bytes += size;
+	return true;
+}
+
+static bool sim_mem_write(uint32_t addr, uint32_t size, uint32_t val)
+{
+	struct sim_mem_region *r = sim_mem_find(addr, size);
+
+	if (!r || !r->writable || (addr & (size - 1))) {
+		LOG_DEBUG("write of %u bytes at 0x%08x faulted", size, addr);
+		return false;
+	}
+	memcpy(&r->data[addr - r->start], &val, size);
+	stats.mem_wr_bytes += size;
+	return true;
+}
+
+static uint32_t *sim_areg(struct sim_core *core, unsigned int idx)
+{
+	return &core->ar[(core->sr[XT_SR_WINDOWBASE] * 4 + idx) & 63];
+}
+
+/* Fill the next application tracing block while the host is connected and
+ * has acknowledged the previous one, like the target side of apptrace does. */
+static void sim_trace_produce(struct sim_core *core)
+{
+	uint32_t ctrl = core->trax[NARADR_DELAYCNT];
+
+	if (core != &sim_cores[0] || !trace_block_sz)
+		return;
+	if ((core->dsr & OCDDSR_STOPPED) || !(ctrl & APPTRACE_HOST_CONNECT) ||
+		(ctrl & APPTRACE_BLOCK_LEN_MSK))
+		return;
+	for (uint32_t i = 0; i < trace_block_sz; i += 4, trace_seq++)
+		memcpy(&core->trax_mem[i], &trace_seq, 4);
+	core->trax[NARADR_DELAYCNT] = APPTRACE_HOST_CONNECT |
+		APPTRACE_BLOCK_ID(APPTRACE_BLOCK_ID_GET(ctrl) + 1) | trace_block_sz;
+	stats.trace_blocks++;
+	stats.trace_bytes += trace_block_sz;
+}
+
+static void sim_core_halt(struct sim_core *core, uint32_t cause)
+{
+	if (core->dsr & OCDDSR_STOPPED)
+		return;
+	core->dsr |= OCDDSR_STOPPED;
+	core->sr[XT_SR_DEBUGCAUSE] = cause;
+	core->sr[XT_SR_EPS_DBG] = core->sr[XT_SR_PS];
+	if (!(core->dcr & OCDDCR_BREAKOUTEN))
+		return;
+	for (int i = 0; i < sim_cores_num; i++) {
+		if (&sim_cores[i] != core && (sim_cores[i].dcr & OCDDCR_BREAKINEN))
+			sim_core_halt(&sim_cores[i], XT_DEBUGCAUSE_DI);
+	}
+}
+
+static void sim_core_reset(struct sim_core *core)
+{
+	memset(core->ar, 0, sizeof(core->ar));
+	memset(core->sr, 0, sizeof(core->sr));
+	memset(core->ur, 0, sizeof(core->ur));
+	memset(core->fr, 0, sizeof(core->fr));
+	core->sr[XT_SR_WINDOWSTART] = 1;
+	core->sr[XT_SR_PS] = 0x1F;
+	core->sr[XT_SR_EPC_DBG] = XT_RESET_VECTOR;
+	core->dsr &= ~OCDDSR_STOPPED;
+	core->pwrstat |= PWRSTAT_COREWASRESET;
+}
+
+static void sim_dm_reset(struct sim_core *core)
+{
+	core->dcr = 0;
+	core->dsr &= OCDDSR_STOPPED;
+	core->ddr = 0;
+	core->dir0 = 0;
+	memset(core->trax, 0, sizeof(core->trax));
+	core->pwrstat |= PWRSTAT_DEBUGWASRESET;
+}
+
+static void sim_exec(struct sim_core *core, uint32_t ins)
+{
+	unsigned int t = (ins >> 4) & 0xF;
+	unsigned int s = (ins >> 8) & 0xF;
+	unsigned int r = (ins >> 12) & 0xF;
+	unsigned int sr = (ins >> 8) & 0xFF;
+	uint32_t val;
+	bool ok = true;
+
+	stats.insns++;
+	if (!(core->dsr & OCDDSR_STOPPED)) {
+		core->dsr |= OCDDSR_EXECOVERRUN;
+		return;
+	}
+	ins &= 0xFFFFFF;
+	if ((ins & 0xFF000F) == 0x030000) {		/* RSR */
+		if (sr == XT_SR_DDR)
+			core->sr[sr] = core->ddr;
+		*sim_areg(core, t) = core->sr[sr];
+		stats.reg_xfers++;
+	} else if ((ins & 0xFF000F) == 0x130000) {	/* WSR */
+		core->sr[sr] = *sim_areg(core, t);
+		if (sr == XT_SR_DDR)
+			core->ddr = core->sr[sr];
+		else if (sr == XT_SR_WINDOWBASE)
+			core->sr[sr] &= 0xF;
+		stats.reg_xfers++;
+	} else if ((ins & 0xFF000F) == 0x610000) {	/* XSR */
+		val = core->sr[sr];
+		core->sr[sr] = *sim_areg(core, t);
+		*sim_areg(core, t) = val;
+	} else if ((ins & 0xFF000F) == 0xE30000) {	/* RUR */
+		*sim_areg(core, r) = core->ur[(ins >> 4) & 0xFF];
+		stats.reg_xfers++;
+	} else if ((ins & 0xFF000F) == 0xF30000) {	/* WUR */
+		core->ur[(ins >> 4) & 0xFF] = *sim_areg(core, r);
+		stats.reg_xfers++;
+	} else if ((ins & 0xFF00FF) == 0xFA0040) {	/* RFR */
+		*sim_areg(core, r) = core->fr[s];
+		stats.reg_xfers++;
+	} else if ((ins & 0xFF00FF) == 0xFA0050) {	/* WFR */
+		core->fr[s] = *sim_areg(core, r);
+		stats.reg_xfers++;
+	} else if ((ins & 0xFFFF0F) == 0x408000) {	/* ROTW */
+		int n = (int)(t ^ 8) - 8;
+		core->sr[XT_SR_WINDOWBASE] = (core->sr[XT_SR_WINDOWBASE] + n) & 0xF;
+	} else if ((ins & 0xFFF0FF) == 0x0070E0) {	/* LDDR32P */
+		ok = sim_mem_read(*sim_areg(core, s), 4, &core->ddr);
+		if (ok)
+			*sim_areg(core, s) += 4;
+	} else if ((ins & 0xFFF0FF) == 0x0070F0) {	/* SDDR32P */
+		ok = sim_mem_write(*sim_areg(core, s), 4, core->ddr);
+		if (ok)
+			*sim_areg(core, s) += 4;
+	} else if ((ins & 0x00000F) == 0x2 && (r == 0 || r == 1 || r == 2)) {
+		/* L8UI, L16UI, L32I */
+		uint32_t sz = 1 << r;
+		ok = sim_mem_read(*sim_areg(core, s) + ((ins >> 16) & 0xFF) * sz, sz, &val);
+		if (ok)
+			*sim_areg(core, t) = val;
+	} else if ((ins & 0x00000F) == 0x2 && (r == 4 || r == 5 || r == 6)) {
+		/* S8I, S16I, S32I */
+		uint32_t sz = 1 << (r - 4);
+		ok = sim_mem_write(*sim_areg(core, s) + ((ins >> 16) & 0xFF) * sz, sz,
+			*sim_areg(core, t));
+	} else if (ins == XT_INS_RFDO || ins == XT_INS_RFDD) {
+		core->dsr &= ~OCDDSR_STOPPED;
+		core->sr[XT_SR_PS] = core->sr[XT_SR_EPS_DBG];
+		sim_trace_produce(core);
+	} else {
+		LOG_DEBUG("unknown instruction 0x%06x executed as NOP", ins);
+		stats.insns_unknown++;
+	}
+	if (!ok) {
+		core->dsr |= OCDDSR_EXECEXCEPTION;
+		stats.exceptions++;
+	}
+	core->dsr |= OCDDSR_EXECDONE;
+}
+
+static uint32_t sim_nar_read(struct sim_core *core, uint8_t reg)
+{
+	uint32_t val = 0;
+
+	stats.nar_reads++;
+	switch (reg) {
+		case NARADR_TRAXID:
+			val = 0x00004000;	/* trace memory present */
+			break;
+		case NARADR_TRAXDATA: {
+			uint32_t off = (core->trax[NARADR_TRAXADDR] * 4) % SIM_TRAX_MEM_SZ;
+			memcpy(&val, &core->trax_mem[off], 4);
+			core->trax[NARADR_TRAXADDR]++;
+			stats.trax_rd_bytes += 4;
+			break;
+		}
+		case NARADR_TRAXCTRL:
+		case NARADR_TRAXSTAT:
+		case NARADR_TRAXADDR:
+		case NARADR_TRIGGERPC:
+		case NARADR_PCMATCHCTRL:
+		case NARADR_DELAYCNT:
+		case NARADR_MEMADDRSTART:
+		case NARADR_MEMADDREND:
+			val = core->trax[reg];
+			break;
+		case NARADR_OCDID:
+			val = SIM_OCDID;
+			break;
+		case NARADR_DCRSET:
+		case NARADR_DCRCLR:
+			val = core->dcr;
+			break;
+		case NARADR_DSR:
+			val = core->dsr;
+			break;
+		case NARADR_DDR:
+			val = core->ddr;
+			break;
+		case NARADR_DDREXEC:
+			val = core->ddr;
+			sim_exec(core, core->dir0);
+			break;
+		case NARADR_DIR0:
+		case NARADR_DIR0EXEC:
+			val = core->dir0;
+			break;
+		default:
+			break;
+	}
+	return val;
+}
+
+static void sim_nar_write(struct sim_core *core, uint8_t reg, uint32_t val)
+{
+	stats.nar_writes++;
+	switch (reg) {
+		case NARADR_TRAXCTRL:
+		case NARADR_TRAXSTAT:
+		case NARADR_TRAXADDR:
+		case NARADR_TRIGGERPC:
+		case NARADR_PCMATCHCTRL:
+		case NARADR_MEMADDRSTART:
+		case NARADR_MEMADDREND:
+			core->trax[reg] = val;
+			break;
+		case NARADR_TRAXDATA: {
+			uint32_t off = (core->trax[NARADR_TRAXADDR] * 4) % SIM_TRAX_MEM_SZ;
+			memcpy(&core->trax_mem[off], &val, 4);
+			core->trax[NARADR_TRAXADDR]++;
+			break;
+		}
+		case NARADR_DELAYCNT:
+			core->trax[reg] = val;
+			sim_trace_produce(core);
+			break;
+		case NARADR_DCRSET:
+			core->dcr |= val;
+			if ((core->dcr & OCDDCR_ENABLEOCD) && (val & OCDDCR_DEBUGINTERRUPT)) {
+				core->dcr &= ~OCDDCR_DEBUGINTERRUPT;
+				sim_core_halt(core, XT_DEBUGCAUSE_DI);
+			}
+			break;
+		case NARADR_DCRCLR:
+			core->dcr &= ~val;
+			break;
+		case NARADR_DSR:
+			core->dsr &= ~(val & OCDDSR_W1C_MASK);
+			break;
+		case NARADR_DDR:
+			core->ddr = val;
+			break;
+		case NARADR_DDREXEC:
+			core->ddr = val;
+			sim_exec(core, core->dir0);
+			break;
+		case NARADR_DIR0:
+			core->dir0 = val;
+			break;
+		case NARADR_DIR0EXEC:
+			core->dir0 = val;
+			sim_exec(core, val);
+			break;
+		default:
+			break;
+	}
+}
+
+static void sim_tap_capture_dr(struct sim_core *core)
+{
+	switch (core->ir) {
+		case TAPINS_IDCODE:
+			core->shift = TAP_IDCODE;
+			core->shift_len = 32;
+			break;
+		case TAPINS_PWRCTL:
+			core->shift = core->pwrctl;
+			core->shift_len = 8;
+			break;
+		case TAPINS_PWRSTAT:
+			core->shift = core->pwrstat;
+			core->shift_len = 8;
+			break;
+		case TAPINS_NARSEL:
+			if (!core->nar_phase) {
+				core->shift = 0;
+				core->shift_len = 8;
+			} else {
+				core->shift = (core->nar & 1) ? 0 : sim_nar_read(core, core->nar >> 1);
+				core->shift_len = 32;
+			}
+			break;
+		default:
+			core->shift = 0;
+			core->shift_len = 1;
+			break;
+	}
+}
+
+static void sim_tap_update_dr(struct sim_core *core)
+{
+	uint32_t val = (uint32_t)core->shift;
+
+	switch (core->ir) {
+		case TAPINS_PWRCTL:
+			if ((val & PWRCTL_DEBUGRESET) && !(core->pwrctl & PWRCTL_DEBUGRESET))
+				sim_dm_reset(core);
+			if ((val & PWRCTL_CORERESET) && !(core->pwrctl & PWRCTL_CORERESET))
+				sim_core_reset(core);
+			core->pwrctl = val & 0xFF;
+			break;
+		case TAPINS_PWRSTAT:
+			/* the value shifted in clears the "was reset" flags */
+			core->pwrstat &= ~(val & (PWRSTAT_DEBUGWASRESET | PWRSTAT_COREWASRESET));
+			break;
+		case TAPINS_NARSEL:
+			if (!core->nar_phase)
+				core->nar = val & 0xFF;
+			else if (core->nar & 1)
+				sim_nar_write(core, core->nar >> 1, val);
+			core->nar_phase = !core->nar_phase;
+			break;
+		default:
+			break;
+	}
+}
+
+static void sim_tap_clock(int tms, int tdi)
+{
+	enum tap_state next = tap_next[tap_state][tms];
+
+	stats.tck++;
+	if (tap_state == TAP_DRSHIFT || tap_state == TAP_IRSHIFT) {
+		/* TDI enters the last TAP in the chain, TDO leaves the first one */
+		uint64_t in = tdi;
+		for (int i = sim_cores_num - 1; i >= 0; i--) {
+			struct sim_core *core = &sim_cores[i];
+			uint64_t out = core->shift & 1;
+			core->shift = (core->shift >> 1) | (in << (core->shift_len - 1));
+			in = out;
+		}
+		if (tap_state == TAP_DRSHIFT)
+			stats.dr_bits++;
+		else
+			stats.ir_bits++;
+	}
+	switch (next) {
+		case TAP_RESET:
+			for (int i = 0; i < sim_cores_num; i++) {
+				sim_cores[i].ir = TAPINS_IDCODE;
+				sim_cores[i].nar_phase = false;
+			}
+			break;
+		case TAP_DRCAPTURE:
+			stats.dr_scans++;
+			for (int i = 0; i < sim_cores_num; i++)
+				sim_tap_capture_dr(&sim_cores[i]);
+			break;
+		case TAP_DRUPDATE:
+			for (int i = 0; i < sim_cores_num; i++)
+				sim_tap_update_dr(&sim_cores[i]);
+			break;
+		case TAP_IRCAPTURE:
+			stats.ir_scans++;
+			for (int i = 0; i < sim_cores_num; i++) {
+				sim_cores[i].shift = 0x01;
+				sim_cores[i].shift_len = TAP_IR_LEN;
+			}
+			break;
+		case TAP_IRUPDATE:
+			for (int i = 0; i < sim_cores_num; i++) {
+				sim_cores[i].ir = sim_cores[i].shift & ((1 << TAP_IR_LEN) - 1);
+				sim_cores[i].nar_phase = false;
+			}
+			break;
+		default:
+			break;
+	}
+	tap_state = next;
+}
+
+static int sim_tdo(void)
+{
+	if (tap_state == TAP_DRSHIFT || tap_state == TAP_IRSHIFT)
+		return sim_cores[0].shift & 1;
+	return 0;
+}
+
+static void sim_write(int tck, int tms, int tdi)
+{
+	if (tck && !last_tck)
+		sim_tap_clock(last_tms, last_tdi);
+	last_tck = tck;
+	last_tms = tms;
+	last_tdi = tdi;
+}
+
+static void sim_reset(int trst, int srst)
+{
+	if (trst)
+		tap_state = TAP_RESET;
+	if (srst) {
+		for (int i = 0; i < sim_cores_num; i++)
+			sim_core_reset(&sim_cores[i]);
+	}
+}
+
+static void sim_init(void)
+{
+	for (size_t i = 0; i < sizeof(sim_mem_map) / sizeof(sim_mem_map[0]); i++) {
+		if (!sim_mem_map[i].data)
+			sim_mem_map[i].data = calloc(1, sim_mem_map[i].size);
+		if (!sim_mem_map[i].data) {
+			LOG_ERROR("Failed to allocate %s memory!", sim_mem_map[i].name);
+			exit(EXIT_FAILURE);
+		}
+	}
+	memset(sim_cores, 0, sizeof(sim_cores));
+	for (int i = 0; i < sim_cores_num; i++) {
+		sim_cores[i].pwrstat = PWRSTAT_DOMAINS_ON;
+		sim_dm_reset(&sim_cores[i]);
+		sim_core_reset(&sim_cores[i]);
+		sim_cores[i].ir = TAPINS_IDCODE;
+	}
+	tap_state = TAP_RESET;
+	trace_seq = 0;
+	memset(&stats, 0, sizeof(stats));
+}
+
+static double sim_rate(uint64_t count, double secs)
+{
+	return secs > 0 ? count / secs : 0;
+}
+
+static void sim_stats_report(double secs)
+{
+	uint64_t bits = stats.ir_bits + stats.dr_bits;
+	uint64_t mem = stats.mem_rd_bytes + stats.mem_wr_bytes;
+
+	LOG_INFO("xtensa_ocd_sim: session %.3f s, %llu bytes received, %llu packed commands, "
+		"%llu TDO samples", secs, (unsigned long long)stats.bytes_in,
+		(unsigned long long)stats.packets, (unsigned long long)stats.samples);
+	LOG_INFO("  TCK          %12llu  (%.0f Hz effective)",
+		(unsigned long long)stats.tck, sim_rate(stats.tck, secs));
+	LOG_INFO("  IR scans     %12llu  %llu bits",
+		(unsigned long long)stats.ir_scans, (unsigned long long)stats.ir_bits);
+	LOG_INFO("  DR scans     %12llu  %llu bits",
+		(unsigned long long)stats.dr_scans, (unsigned long long)stats.dr_bits);
+	LOG_INFO("  NAR reads    %12llu  writes %llu",
+		(unsigned long long)stats.nar_reads, (unsigned long long)stats.nar_writes);
+	LOG_INFO("  instructions %12llu  unknown %llu, exceptions %llu",
+		(unsigned long long)stats.insns, (unsigned long long)stats.insns_unknown,
+		(unsigned long long)stats.exceptions);
+	LOG_INFO("  reg moves    %12llu", (unsigned long long)stats.reg_xfers);
+	LOG_INFO("  memory       %12llu  bytes read, %llu written, %.1f shifted bits/byte",
+		(unsigned long long)stats.mem_rd_bytes, (unsigned long long)stats.mem_wr_bytes,
+		mem ? (double)bits / mem : 0.0);
+	LOG_INFO("  apptrace     %12llu  bytes in %llu blocks, %llu read via TRAXDATA (%.1f KB/s)",
+		(unsigned long long)stats.trace_bytes, (unsigned long long)stats.trace_blocks,
+		(unsigned long long)stats.trax_rd_bytes,
+		sim_rate(stats.trax_rd_bytes, secs) / 1024);
+}
+
+/* Packed clock command ('c'/'C', 16 bit cycle count, 2 bits per cycle) */
+struct sim_packet {
+	int hdr_left;
+	bool capture;
+	uint32_t cycles;
+	uint8_t tdo;
+	int tdo_bits;
+	int tms;
+	int tdi;
+};
+
+struct sim_out {
+	int fd;
+	uint8_t buf[4096];
+	size_t len;
+	bool failed;
+};
+
+static void sim_out_byte(struct sim_out *out, uint8_t c)
+{
+	out->buf[out->len++] = c;
+	if (out->len == sizeof(out->buf)) {
+		if (write(out->fd, out->buf, out->len) != (ssize_t)out->len)
+			out->failed = true;
+		out->len = 0;
+	}
+}
+
+static void sim_packet_data(struct sim_packet *pkt, uint8_t c, struct sim_out *out)
+{
+	for (int k = 0; k < 4 && pkt->cycles; k++, pkt->cycles--) {
+		pkt->tdi = (c >> (2 * k)) & 1;
+		pkt->tms = (c >> (2 * k + 1)) & 1;
+		sim_write(0, pkt->tms, pkt->tdi);
+		if (pkt->capture) {
+			pkt->tdo |= sim_tdo() << pkt->tdo_bits;
+			stats.samples++;
+			if (++pkt->tdo_bits == 8) {
+				sim_out_byte(out, pkt->tdo);
+				pkt->tdo = 0;
+				pkt->tdo_bits = 0;
+			}
+		}
+		sim_write(1, pkt->tms, pkt->tdi);
+	}
+	if (!pkt->cycles) {
+		/* leave TCK low like the ASCII protocol does between commands */
+		sim_write(0, pkt->tms, pkt->tdi);
+		if (pkt->tdo_bits)
+			sim_out_byte(out, pkt->tdo);
+	}
+}
+
+/* Serve one remote_bitbang session, returns when the peer quits or closes */
+static void sim_serve(int fd_in, int fd_out)
+{
+	uint8_t in[4096];
+	struct sim_out out = { .fd = fd_out };
+	struct sim_packet pkt = { 0 };
+	struct timeval start, end;
+	bool quit = false;
+
+	sim_init();
+	gettimeofday(&start, NULL);
+	while (!quit && !out.failed) {
+		ssize_t n = read(fd_in, in, sizeof(in));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		stats.bytes_in += n;
+		for (ssize_t i = 0; i < n && !quit; i++) {
+			uint8_t c = in[i];
+			if (pkt.hdr_left) {
+				pkt.cycles |= (uint32_t)c << (8 * (2 - pkt.hdr_left));
+				pkt.hdr_left--;
+				pkt.tdo = 0;
+				pkt.tdo_bits = 0;
+				continue;
+			}
+			if (pkt.cycles) {
+				sim_packet_data(&pkt, c, &out);
+				continue;
+			}
+			switch (c) {
+				case '0': case '1': case '2': case '3':
+				case '4': case '5': case '6': case '7':
+					sim_write((c - '0') >> 2 & 1, (c - '0') >> 1 & 1, (c - '0') & 1);
+					break;
+				case 'R':
+					sim_out_byte(&out, '0' + sim_tdo());
+					stats.samples++;
+					break;
+				case 'r': case 's': case 't': case 'u':
+					sim_reset((c - 'r') >> 1 & 1, (c - 'r') & 1);
+					break;
+				case 'B':
+				case 'b':
+					break;
+				case 'X':
+					/* packed clock commands are supported */
+					sim_out_byte(&out, 'x');
+					break;
+				case 'c':
+				case 'C':
+					pkt.capture = c == 'C';
+					pkt.hdr_left = 2;
+					pkt.cycles = 0;
+					stats.packets++;
+					break;
+				case 'Q':
+					quit = true;
+					break;
+				default:
+					LOG_DEBUG("unknown command '%c'", c);
+					break;
+			}
+		}
+		/* the host only waits for replies once it has sent everything */
+		if (out.len) {
+			if (write(fd_out, out.buf, out.len) != (ssize_t)out.len)
+				break;
+			out.len = 0;
+		}
+	}
+	gettimeofday(&end, NULL);
+	sim_stats_report((end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+	int port = 5555;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+			port = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+			sim_cores_num = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+			trace_block_sz = strtoul(argv[++i], NULL, 0);
+		} else if (!strcmp(argv[i], "-v")) {
+			verbose = 1;
+		} else {
+			LOG_ERROR("Usage: %s [-p port] [-c cores] [-a trace_block_size] [-v]", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (sim_cores_num < 1 || sim_cores_num > SIM_MAX_TAPS) {
+		LOG_ERROR("Number of cores must be 1..%d", SIM_MAX_TAPS);
+		return EXIT_FAILURE;
+	}
+	trace_block_sz &= ~3UL;
+	if (trace_block_sz > SIM_TRAX_MEM_SZ)
+		trace_block_sz = SIM_TRAX_MEM_SZ;
+
+	if (port == 0) {
+		sim_serve(STDIN_FILENO, STDOUT_FILENO);
+		return EXIT_SUCCESS;
+	}
+
+	int lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0) {
+		LOG_ERROR("socket: %s", strerror(errno));
+		return EXIT_FAILURE;
+	}
+	int one = 1;
+	setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(lfd, 1) < 0) {
+		LOG_ERROR("bind/listen on port %d: %s", port, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	LOG_INFO("xtensa_ocd_sim: %d core(s), listening on 127.0.0.1:%d", sim_cores_num, port);
+	while (1) {
+		int fd = accept(lfd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			LOG_ERROR("accept: %s", strerror(errno));
+			return EXIT_FAILURE;
+		}
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		sim_serve(fd, fd);
+		close(fd);
+	}
+	return EXIT_SUCCESS;
+}
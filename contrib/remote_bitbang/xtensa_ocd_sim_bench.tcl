@@ -0,0 +1,83 @@
+#
+# Benchmarks for the simulated Xtensa OCD endpoint, see xtensa_ocd_sim.c.
+# Wall time is measured here, bits and TCK cycles are reported by the
+# simulator when OpenOCD disconnects.
+#
+# openocd -f contrib/remote_bitbang/xtensa_ocd_sim.cfg \
+#	-f contrib/remote_bitbang/xtensa_ocd_sim_bench.tcl -c "sim_bench; shutdown"
+#
+
+proc sim_bench_report { what count unit t0 } {
+	set dt [expr {[ms] - $t0}]
+	if { $dt == 0 } {
+		set dt 1
+	}
+	echo [format "%-24s %8d %-6s in %6d ms (%.1f %s/s)" \
+		$what $count $unit $dt [expr {$count * 1000.0 / $dt}] $unit]
+}
+
+# Raw JTAG throughput: IDCODE reads and NARSEL register accesses. Compare
+# runs with "remote_bitbang_binary on" and "off" in xtensa_ocd_sim.cfg.
+proc sim_bench_jtag { {loops 200} } {
+	set tap [lindex [jtag names] 0]
+	set t0 [ms]
+	for {set i 0} {$i < $loops} {incr i} {
+		irscan $tap 0x1e
+		drscan $tap 32 0
+	}
+	sim_bench_report "IDCODE scans" $loops scans $t0
+
+	set t0 [ms]
+	for {set i 0} {$i < $loops} {incr i} {
+		irscan $tap 0x1c
+		drscan $tap 8 [expr {0x44 << 1}]
+		drscan $tap 32 0
+	}
+	sim_bench_report "DSR reads" $loops reads $t0
+}
+
+# Halt/resume cycles; every halt fetches the whole register file.
+proc sim_bench_regs { {loops 20} } {
+	set t0 [ms]
+	for {set i 0} {$i < $loops} {incr i} {
+		resume
+		halt
+	}
+	sim_bench_report "register fetch" $loops halts $t0
+}
+
+proc sim_bench_mem { {addr 0x3FFB0000} {size 0x8000} {file xtensa_ocd_sim_bench.bin} } {
+	set t0 [ms]
+	dump_image $file $addr $size
+	sim_bench_report "memory read" $size bytes $t0
+
+	set t0 [ms]
+	load_image $file $addr bin
+	sim_bench_report "memory write" $size bytes $t0
+
+	set t0 [ms]
+	verify_image $file $addr bin
+	sim_bench_report "memory verify" $size bytes $t0
+
+	set t0 [ms]
+	for {set i 0} {$i < 256} {incr i 4} {
+		mww [expr {$addr + $i}] $i
+		mdw [expr {$addr + $i}]
+	}
+	sim_bench_report "single word r/w" 64 words $t0
+}
+
+# Application tracing runs from the poll loop, so it is started here and
+# reports its own throughput when it stops after 'size' bytes.
+proc sim_bench_apptrace { {size 0x40000} {file xtensa_ocd_sim_trace.bin} } {
+	resume
+	esp32 apptrace start file://$file 0 $size 5
+}
+
+proc sim_bench { } {
+	init
+	halt
+	sim_bench_jtag
+	sim_bench_regs
+	sim_bench_mem
+}
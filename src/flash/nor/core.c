@@ -696,8 +696,140 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 }
 
 
-int flash_write_unlock(struct target *target, struct image *image,
-	uint32_t *written, int erase, bool unlock)
+/* One contiguous write to a flash bank. Image data starts at sorted section
+ * 'section', 'section_offset' bytes in, after 'padding_at_start' fill bytes,
+ * and is followed by 'padding_at_end' fill bytes. */
+struct flash_write_run {
+	struct flash_bank *bank;
+	target_addr_t address;
+	uint32_t size;
+	uint32_t padding_at_start;
+	uint32_t padding_at_end;
+	int section;
+	uint32_t section_offset;
+};
+
+/* Whole sectors to unlock and/or erase, merged across runs of one bank */
+struct flash_erase_range {
+	struct flash_bank *bank;
+	target_addr_t address;
+	uint32_t size;
+};
+
+struct flash_write_plan {
+	int num_sections;
+	struct imagesection **sections;	/* image sections sorted by address */
+	int *padding;			/* fill bytes between a sorted section and the next one */
+	int num_runs;
+	struct flash_write_run *runs;
+	int num_erases;
+	struct flash_erase_range *erases;
+};
+
+static void flash_write_plan_free(struct flash_write_plan *plan)
+{
+	free(plan->sections);
+	free(plan->padding);
+	free(plan->runs);
+	free(plan->erases);
+}
+
+/**
+ * Copy the image data of @a run into @a buffer. With a NULL @a buffer only
+ * the position in the image is advanced, which is how the planner finds
+ * where the next run starts.
+ */
+static int flash_write_run_fill(struct image *image, struct flash_write_plan *plan,
+	struct flash_write_run *run, uint8_t *buffer,
+	int *section, uint32_t *section_offset)
+{
+	struct imagesection **sections = plan->sections;
+	uint32_t buffer_idx;
+	uint32_t data_end = run->size - run->padding_at_end;
+	struct flash_bank *c = run->bank;
+
+	*section = run->section;
+	*section_offset = run->section_offset;
+
+	if (buffer && run->padding_at_start)
+		memset(buffer, c->default_padded_value, run->padding_at_start);
+
+	buffer_idx = run->padding_at_start;
+
+	/* read sections to the buffer */
+	while (buffer_idx < data_end && *section < plan->num_sections) {
+		size_t size_read;
+
+		size_read = data_end - buffer_idx;
+		if (size_read > sections[*section]->size - *section_offset)
+			size_read = sections[*section]->size - *section_offset;
+
+		if (buffer) {
+			/* KLUDGE!
+			 *
+			 * #¤%#"%¤% we have to figure out the section # from the sorted
+			 * list of pointers to sections to invoke image_read_section()...
+			 */
+			intptr_t diff = (intptr_t)sections[*section] - (intptr_t)image->sections;
+			int t_section_num = diff / sizeof(struct imagesection);
+
+			LOG_DEBUG("image_read_section: section = %d, t_section_num = %d, "
+					"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
+				*section, t_section_num, *section_offset,
+				buffer_idx, size_read);
+			int retval = image_read_section(image, t_section_num, *section_offset,
+					size_read, buffer + buffer_idx, &size_read);
+			if (retval != ERROR_OK)
+				return retval;
+			if (size_read == 0)
+				return ERROR_FAIL;
+		}
+
+		buffer_idx += size_read;
+		*section_offset += size_read;
+
+		if (*section_offset >= sections[*section]->size) {
+			/* fill the gap to the next section of this run; a section
+			 * cut at the end of a bank keeps its gap for the next run */
+			if (plan->padding[*section]) {
+				if (buffer)
+					memset(buffer + buffer_idx, c->default_padded_value, plan->padding[*section]);
+				buffer_idx += plan->padding[*section];
+			}
+			(*section)++;
+			*section_offset = 0;
+		}
+	}
+
+	if (buffer && buffer_idx < run->size)
+		memset(buffer + buffer_idx, c->default_padded_value, run->size - buffer_idx);
+
+	return ERROR_OK;
+}
+
+/* Like get_flash_bank_by_addr() but without auto-probing, for planning a
+ * dry run without touching the target. Banks of unknown size are skipped. */
+static struct flash_bank *get_known_flash_bank_by_addr(struct target *target,
+	target_addr_t addr)
+{
+	struct flash_bank *c;
+
+	for (c = flash_banks; c; c = c->next) {
+		if (c->target != target || c->size == 0)
+			continue;
+		if ((addr >= c->base) && (addr <= c->base + (c->size - 1)))
+			return c;
+	}
+	return NULL;
+}
+
+/**
+ * Split the image into contiguous runs per flash bank, padding small gaps
+ * as allowed by flash_write_check_gap() and the bank alignment rules, and
+ * collect the sectors the runs touch into as few erase ranges as possible.
+ */
+static int flash_write_plan_build(struct target *target, struct image *image,
+	struct flash_write_plan *plan, int erase, bool unlock, bool probe)
 {
 	int retval = ERROR_OK;
 
@@ -709,23 +841,25 @@ int flash_write_unlock(struct target *target, struct image *image,
 	section = 0;
 	section_offset = 0;
 
-	if (written)
-		*written = 0;
-
-	if (erase) {
-		/* assume all sectors need erasing - stops any problems
-		 * when flash_write is called multiple times */
-
-		flash_set_dirty();
-	}
+	memset(plan, 0, sizeof(*plan));
+	plan->num_sections = image->num_sections;
 
 	/* allocate padding array */
-	padding = calloc(image->num_sections, sizeof(*padding));
+	padding = plan->padding = calloc(image->num_sections, sizeof(*padding));
 
 	/* This fn requires all sections to be in ascending order of addresses,
 	 * whereas an image can have sections out of order. */
-	struct imagesection **sections = malloc(sizeof(struct imagesection *) *
+	struct imagesection **sections = plan->sections = malloc(sizeof(struct imagesection *) *
 			image->num_sections);
+
+	/* never more runs than sections plus one per bank boundary crossed */
+	plan->runs = malloc(sizeof(struct flash_write_run) * (image->num_sections + 1));
+	if (padding == NULL || sections == NULL || plan->runs == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	int runs_allocated = image->num_sections + 1;
+
 	int i;
 	for (i = 0; i < image->num_sections; i++)
 		sections[i] = &image->sections[i];
@@ -735,8 +869,6 @@ int flash_write_unlock(struct target *target, struct image *image,
 
 	/* loop until we reach end of the image */
 	while (section < image->num_sections) {
-		uint32_t buffer_idx;
-		uint8_t *buffer;
 		int section_last;
 		target_addr_t run_address = sections[section]->base_address + section_offset;
 		uint32_t run_size = sections[section]->size - section_offset;
@@ -750,9 +882,12 @@ int flash_write_unlock(struct target *target, struct image *image,
 		}
 
 		/* find the corresponding flash bank */
-		retval = get_flash_bank_by_addr(target, run_address, false, &c);
-		if (retval != ERROR_OK)
-			goto done;
+		if (probe) {
+			retval = get_flash_bank_by_addr(target, run_address, false, &c);
+			if (retval != ERROR_OK)
+				return retval;
+		} else
+			c = get_known_flash_bank_by_addr(target, run_address);
 		if (c == NULL) {
 			LOG_WARNING("no flash bank found for address " TARGET_ADDR_FMT, run_address);
 			section++;	/* and skip it */
@@ -782,8 +917,7 @@ int flash_write_unlock(struct target *target, struct image *image,
 					" overlaps section ending at " TARGET_ADDR_FMT,
 					next_section_base, run_next_addr);
 				LOG_ERROR("Flash write aborted.");
-				retval = ERROR_FAIL;
-				goto done;
+				return ERROR_FAIL;
 			}
 
 			pad_bytes = next_section_base - run_next_addr;
@@ -816,6 +950,7 @@ int flash_write_unlock(struct target *target, struct image *image,
 		}
 
 		uint32_t padding_at_start = 0;
+		uint32_t padding_at_end = 0;
 		if (c->write_start_alignment || c->write_end_alignment) {
 			/* align write region according to bank requirements */
 			target_addr_t aligned_start = flash_write_align_start(c, run_address);
@@ -839,7 +974,7 @@ int flash_write_unlock(struct target *target, struct image *image,
 					" with %d bytes (bank write end alignment)",
 					section_last, run_end + 1, pad_bytes);
 
-				padding[section_last] += pad_bytes;
+				padding_at_end = pad_bytes;
 				run_size += pad_bytes;
 			}
 
@@ -860,80 +995,169 @@ int flash_write_unlock(struct target *target, struct image *image,
 			}
 
 			delta = end - offset_end;
-			padding[section_last] += delta;
+			padding_at_end = delta;
 			run_size += delta;
 		}
 
-		/* allocate buffer */
-		buffer = malloc(run_size);
-		if (buffer == NULL) {
-			LOG_ERROR("Out of memory for flash bank buffer");
-			retval = ERROR_FAIL;
-			goto done;
+		if (plan->num_runs == runs_allocated) {
+			runs_allocated *= 2;
+			struct flash_write_run *runs = realloc(plan->runs,
+					sizeof(struct flash_write_run) * runs_allocated);
+			if (runs == NULL) {
+				LOG_ERROR("Out of memory");
+				return ERROR_FAIL;
+			}
+			plan->runs = runs;
 		}
 
-		if (padding_at_start)
-			memset(buffer, c->default_padded_value, padding_at_start);
+		struct flash_write_run *run = &plan->runs[plan->num_runs++];
+		run->bank = c;
+		run->address = run_address;
+		run->size = run_size;
+		run->padding_at_start = padding_at_start;
+		run->padding_at_end = padding_at_end;
+		run->section = section;
+		run->section_offset = section_offset;
+
+		/* the next run starts where the data of this one ends */
+		flash_write_run_fill(image, plan, run, NULL, &section, &section_offset);
+	}
 
-		buffer_idx = padding_at_start;
+	if (!erase && !unlock)
+		return ERROR_OK;
 
-		/* read sections to the buffer */
-		while (buffer_idx < run_size) {
-			size_t size_read;
+	/* Erase ranges: the sectors each run touches, joined with the previous
+	 * range of the same bank when they are adjacent or overlap, so that a
+	 * driver sees one erase request per contiguous area instead of one per
+	 * image section. */
+	plan->erases = malloc(sizeof(struct flash_erase_range) * (plan->num_runs + 1));
+	if (plan->erases == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
 
-			size_read = run_size - buffer_idx;
-			if (size_read > sections[section]->size - section_offset)
-				size_read = sections[section]->size - section_offset;
+	for (i = 0; i < plan->num_runs; i++) {
+		struct flash_write_run *run = &plan->runs[i];
+		target_addr_t start = run->address;
+		target_addr_t end = run->address + run->size;
 
-			/* KLUDGE!
-			 *
-			 * #¤%#"%¤% we have to figure out the section # from the sorted
-			 * list of pointers to sections to invoke image_read_section()...
-			 */
-			intptr_t diff = (intptr_t)sections[section] - (intptr_t)image->sections;
-			int t_section_num = diff / sizeof(struct imagesection);
+		c = run->bank;
+		if (c->num_sectors > 0) {
+			int sector;
+			uint32_t offset_start = start - c->base;
+			uint32_t offset_last = end - 1 - c->base;
 
-			LOG_DEBUG("image_read_section: section = %d, t_section_num = %d, "
-					"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
-				section, t_section_num, section_offset,
-				buffer_idx, size_read);
-			retval = image_read_section(image, t_section_num, section_offset,
-					size_read, buffer + buffer_idx, &size_read);
-			if (retval != ERROR_OK || size_read == 0) {
-				free(buffer);
-				goto done;
+			for (sector = 0; sector < c->num_sectors; sector++) {
+				struct flash_sector *s = &c->sectors[sector];
+				if (s->offset <= offset_start && offset_start < s->offset + s->size)
+					start = c->base + s->offset;
+				if (s->offset <= offset_last && offset_last < s->offset + s->size) {
+					end = c->base + s->offset + s->size;
+					break;
+				}
 			}
+		}
 
-			buffer_idx += size_read;
-			section_offset += size_read;
+		struct flash_erase_range *prev = plan->num_erases ?
+			&plan->erases[plan->num_erases - 1] : NULL;
+		if (prev && prev->bank == c && start <= prev->address + prev->size) {
+			if (end > prev->address + prev->size)
+				prev->size = end - prev->address;
+			continue;
+		}
 
-			/* see if we need to pad the section */
-			if (padding[section]) {
-				memset(buffer + buffer_idx, c->default_padded_value, padding[section]);
-				buffer_idx += padding[section];
-			}
+		struct flash_erase_range *range = &plan->erases[plan->num_erases++];
+		range->bank = c;
+		range->address = start;
+		range->size = end - start;
+	}
 
-			if (section_offset >= sections[section]->size) {
-				section++;
-				section_offset = 0;
-			}
+	return ERROR_OK;
+}
+
+static void flash_write_plan_print(struct flash_write_plan *plan, int erase, bool unlock)
+{
+	int i;
+
+	for (i = 0; i < plan->num_erases; i++) {
+		struct flash_erase_range *range = &plan->erases[i];
+		LOG_INFO("%s%s bank %s " TARGET_ADDR_FMT " - " TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
+			unlock ? "unlock" : "", unlock && erase ? "/erase" : erase ? "erase" : "",
+			range->bank->name, range->address, range->address + range->size - 1,
+			range->size);
+	}
+
+	for (i = 0; i < plan->num_runs; i++) {
+		struct flash_write_run *run = &plan->runs[i];
+		LOG_INFO("write bank %s " TARGET_ADDR_FMT " - " TARGET_ADDR_FMT " (%" PRIu32 " bytes)",
+			run->bank->name, run->address, run->address + run->size - 1,
+			run->size);
+	}
+}
+
+int flash_write_unlock(struct target *target, struct image *image,
+	uint32_t *written, int erase, bool unlock, bool dry_run)
+{
+	struct flash_write_plan plan;
+	int section;
+	uint32_t section_offset;
+	int i;
+
+	if (written)
+		*written = 0;
+
+	int retval = flash_write_plan_build(target, image, &plan, erase, unlock, !dry_run);
+	if (retval != ERROR_OK)
+		goto done;
+
+	if (dry_run) {
+		flash_write_plan_print(&plan, erase, unlock);
+		for (i = 0; i < plan.num_runs; i++)
+			if (written)
+				*written += plan.runs[i].size;
+		goto done;
+	}
+
+	if (erase) {
+		/* assume all sectors need erasing - stops any problems
+		 * when flash_write is called multiple times */
+
+		flash_set_dirty();
+	}
+
+	/* unlock and erase all areas first, then stream the writes */
+	for (i = 0; i < plan.num_erases; i++) {
+		struct flash_erase_range *range = &plan.erases[i];
+
+		if (unlock) {
+			retval = flash_unlock_address_range(target, range->address, range->size);
+			if (retval != ERROR_OK)
+				goto done;
+		}
+		if (erase) {
+			/* calculate and erase sectors */
+			retval = flash_erase_address_range(target,
+					true, range->address, range->size);
+			if (retval != ERROR_OK)
+				goto done;
 		}
+	}
 
-		retval = ERROR_OK;
+	for (i = 0; i < plan.num_runs; i++) {
+		struct flash_write_run *run = &plan.runs[i];
 
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
-				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
-			}
+		/* allocate buffer */
+		uint8_t *buffer = malloc(run->size);
+		if (buffer == NULL) {
+			LOG_ERROR("Out of memory for flash bank buffer");
+			retval = ERROR_FAIL;
+			goto done;
 		}
 
+		retval = flash_write_run_fill(image, &plan, run, buffer, &section, &section_offset);
 		if (retval == ERROR_OK) {
 			/* write flash sectors */
-			retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+			retval = flash_driver_write(run->bank, buffer, run->address - run->bank->base, run->size);
 		}
 
 		free(buffer);
@@ -944,12 +1168,11 @@ int flash_write_unlock(struct target *target, struct image *image,
 		}
 
 		if (written != NULL)
-			*written += run_size;	/* add run size to total written counter */
+			*written += run->size;	/* add run size to total written counter */
 	}
 
 done:
-	free(sections);
-	free(padding);
+	flash_write_plan_free(&plan);
 
 	return retval;
 }
@@ -957,7 +1180,7 @@ done:
 int flash_write(struct target *target, struct image *image,
 	uint32_t *written, int erase)
 {
-	return flash_write_unlock(target, image, written, erase, false);
+	return flash_write_unlock(target, image, written, erase, false, false);
 }
 
 struct flash_sector *alloc_block_array(uint32_t offset, uint32_t size, int num_blocks)
@@ -119,6 +119,8 @@ static int esp_xtensa_flasher_image_init(struct xtensa_algo_image *flasher_image
 	}
 
 	flasher_image->bss_size = stub_cfg->bss_sz;
+	/* keep stub code loaded between flash operations while the target is halted */
+	flasher_image->resident = true;
 	memset(&flasher_image->image, 0, sizeof(flasher_image->image));
 	int ret = image_open(&flasher_image->image, NULL, "build");
 	if (ret != ERROR_OK) {
@@ -165,6 +167,8 @@ int esp_xtensa_flash_init(struct esp_xtensa_flash_bank *esp_xtensa_info, uint32_
 	esp_xtensa_info->is_drom_address = is_drom_address;
 	esp_xtensa_info->hw_flash_base = 0;
 	esp_xtensa_info->appimage_flash_base = (uint32_t)-1;
+	esp_xtensa_info->wr_buf_sz = 0;
+	esp_xtensa_info->bp_batch_unsupported = false;
 	return ERROR_OK;
 }
 
@@ -472,7 +476,9 @@ static int esp_xtensa_write_state_init(struct target *target,
 		LOG_ERROR("Failed to start workarea alloc time measurement!");
 		return ERROR_FAIL;
 	}
-	uint32_t buffer_size = 64*1024;
+	/* start from the size which fitted last time to avoid failing attempts */
+	uint32_t buffer_size = state->esp_xtensa_info->wr_buf_sz ?
+		state->esp_xtensa_info->wr_buf_sz : 64*1024;
 	while (target_alloc_alt_working_area_try(target, buffer_size,
 			&state->target_buf) != ERROR_OK) {
 		buffer_size /= 2;
@@ -481,6 +487,7 @@ static int esp_xtensa_write_state_init(struct target *target,
 			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 		}
 	}
+	state->esp_xtensa_info->wr_buf_sz = buffer_size;
 	if (duration_measure(&algo_time) != 0) {
 		LOG_ERROR("Failed to stop workarea alloc measurement!");
 		return ERROR_FAIL;
@@ -841,35 +848,17 @@ static void esp_xtensa_flash_bp_op_state_cleanup(struct target *target,
 	target_free_alt_working_area(target, state->target_buf);
 }
 
-int esp_xtensa_flash_breakpoint_add(struct target *target,
-	struct breakpoint *breakpoint,
+static int esp_xtensa_flash_bp_set(struct target *target,
 	struct esp_xtensa_special_breakpoint *sw_bp)
 {
-	struct esp_xtensa_flash_bank *esp_xtensa_info;
+	struct flash_bank *bank = (struct flash_bank *)(sw_bp->priv);
+	struct esp_xtensa_flash_bank *esp_xtensa_info = bank->driver_priv;
 	struct xtensa_algo_run_data run;
-	struct flash_bank *bank;
 	struct esp_xtensa_flash_bp_op_state op_state;
 	struct mem_param mp;
 	struct esp_xtensa_common *esp_xtensa = target_to_esp_xtensa(target);
 	struct xtensa_algo_image flasher_image;
-
-	/* flash belongs to root target, so we need to find flash using it instead of core
-	 * sub-target */
-	int ret = get_flash_bank_by_addr(esp_xtensa->chip_target, breakpoint->address, true, &bank);
-	if (ret != ERROR_OK) {
-		LOG_ERROR("%s: Failed to get flash bank (%d)!", target_name(target), ret);
-		return ret;
-	}
-
-	/* can set set breakpoints in mapped app regions only */
-	if (strcmp(bank->name + strlen(target_name(bank->target)), ".irom") != 0) {
-		LOG_ERROR("%s: Can not set BP outside of IROM (BP addr " TARGET_ADDR_FMT ")!",
-			target_name(target),
-			breakpoint->address);
-		return ERROR_FAIL;
-	}
-
-	esp_xtensa_info = bank->driver_priv;
+	int ret;
 
 	op_state.esp_xtensa_info = esp_xtensa_info;
 	LOG_DEBUG("SEC_SIZE %d", esp_xtensa_info->sec_sz);
@@ -879,9 +868,6 @@ int esp_xtensa_flash_breakpoint_add(struct target *target,
 	run.usr_func_init = (xtensa_algo_usr_func_init_t)esp_xtensa_flash_bp_op_state_init;
 	run.usr_func_done = (xtensa_algo_usr_func_done_t)esp_xtensa_flash_bp_op_state_cleanup;
 
-	sw_bp->data.oocd_bp = breakpoint;
-	sw_bp->priv = bank;
-
 	ret = esp_xtensa_flasher_image_init(&flasher_image, esp_xtensa_info->get_stub(bank));
 	if (ret != ERROR_OK)
 		return ret;
@@ -890,7 +876,7 @@ int esp_xtensa_flash_breakpoint_add(struct target *target,
 	run.mem_args.params = &mp;
 	run.mem_args.count = 1;
 	uint32_t bp_flash_addr = esp_xtensa_info->hw_flash_base +
-		(breakpoint->address - bank->base);
+		(sw_bp->address - bank->base);
 	ret = esp_xtensa_info->run_func_image(esp_xtensa->chip_target,
 		&run,
 		&flasher_image,
@@ -916,7 +902,7 @@ int esp_xtensa_flash_breakpoint_add(struct target *target,
 		"%s: Placed flash SW breakpoint at " TARGET_ADDR_FMT
 		", insn [%02x %02x %02x] %d bytes",
 		target_name(target),
-		breakpoint->address,
+		sw_bp->address,
 		sw_bp->data.insn[0],
 		sw_bp->data.insn[1],
 		sw_bp->data.insn[2],
@@ -925,7 +911,7 @@ int esp_xtensa_flash_breakpoint_add(struct target *target,
 	return ERROR_OK;
 }
 
-int esp_xtensa_flash_breakpoint_remove(struct target *target,
+static int esp_xtensa_flash_bp_clear(struct target *target,
 	struct esp_xtensa_special_breakpoint *sw_bp)
 {
 	struct flash_bank *bank = (struct flash_bank *)(sw_bp->priv);
@@ -953,12 +939,12 @@ int esp_xtensa_flash_breakpoint_remove(struct target *target,
 	run.mem_args.count = 1;
 
 	uint32_t bp_flash_addr = esp_xtensa_info->hw_flash_base +
-		(sw_bp->data.oocd_bp->address - bank->base);
+		(sw_bp->address - bank->base);
 	LOG_DEBUG(
 		"%s: Remove flash SW breakpoint at " TARGET_ADDR_FMT
 		", insn [%02x %02x %02x] %d bytes",
 		target_name(target),
-		sw_bp->data.oocd_bp->address,
+		sw_bp->address,
 		sw_bp->data.insn[0],
 		sw_bp->data.insn[1],
 		sw_bp->data.insn[2],
@@ -981,7 +967,212 @@ int esp_xtensa_flash_breakpoint_remove(struct target *target,
 		return ERROR_FAIL;
 	}
 
+	return ret;
+}
+
+/* Flash breakpoints are not written at once. GDB removes and inserts all breakpoints on
+ * every stop and continue, so set/clear requests are recorded and applied in one go just
+ * before the target is resumed. Pairs of clear and set at the same address cancel out. */
+int esp_xtensa_flash_breakpoint_add(struct target *target,
+	struct breakpoint *breakpoint,
+	struct esp_xtensa_special_breakpoint *sw_bp)
+{
+	struct flash_bank *bank;
+	struct esp_xtensa_common *esp_xtensa = target_to_esp_xtensa(target);
+
+	/* flash belongs to root target, so we need to find flash using it instead of core
+	 * sub-target */
+	int ret = get_flash_bank_by_addr(esp_xtensa->chip_target, breakpoint->address, true, &bank);
+	if (ret != ERROR_OK) {
+		LOG_ERROR("%s: Failed to get flash bank (%d)!", target_name(target), ret);
+		return ret;
+	}
+
+	/* can set set breakpoints in mapped app regions only */
+	if (strcmp(bank->name + strlen(target_name(bank->target)), ".irom") != 0) {
+		LOG_ERROR("%s: Can not set BP outside of IROM (BP addr " TARGET_ADDR_FMT ")!",
+			target_name(target),
+			breakpoint->address);
+		return ERROR_FAIL;
+	}
+
+	if (sw_bp->pending == ESP_XTENSA_SPEC_BP_PENDING_CLEAR &&
+		sw_bp->address == breakpoint->address) {
+		/* break insn is still in flash */
+		LOG_DEBUG("%s: Keep flash SW breakpoint at " TARGET_ADDR_FMT,
+			target_name(target),
+			breakpoint->address);
+		sw_bp->pending = ESP_XTENSA_SPEC_BP_PENDING_NONE;
+	} else {
+		sw_bp->pending = ESP_XTENSA_SPEC_BP_PENDING_SET;
+	}
+	sw_bp->data.oocd_bp = breakpoint;
+	sw_bp->address = breakpoint->address;
+	sw_bp->priv = bank;
+
+	return ERROR_OK;
+}
+
+int esp_xtensa_flash_breakpoint_remove(struct target *target,
+	struct esp_xtensa_special_breakpoint *sw_bp)
+{
+	if (sw_bp->pending == ESP_XTENSA_SPEC_BP_PENDING_SET) {
+		/* not in flash yet */
+		memset(sw_bp, 0, sizeof(*sw_bp));
+		return ERROR_OK;
+	}
+	sw_bp->pending = ESP_XTENSA_SPEC_BP_PENDING_CLEAR;
 	sw_bp->data.oocd_bp = NULL;
+	return ERROR_OK;
+}
+
+static int esp_xtensa_flash_bp_op_cmp(const void *a, const void *b)
+{
+	const struct esp_xtensa_special_breakpoint *bp_a =
+		*(const struct esp_xtensa_special_breakpoint **)a;
+	const struct esp_xtensa_special_breakpoint *bp_b =
+		*(const struct esp_xtensa_special_breakpoint **)b;
+
+	if (bp_a->address < bp_b->address)
+		return -1;
+	return bp_a->address > bp_b->address ? 1 : 0;
+}
+
+/* Runs ESP_XTENSA_STUB_CMD_FLASH_BP_BATCH for the pending breakpoints sorted by address.
+ * If the stub does not support the command, the breakpoints are left pending. */
+static int esp_xtensa_flash_bp_batch(struct target *target, struct flash_bank *bank,
+	struct esp_xtensa_special_breakpoint **ops, size_t num)
+{
+	struct esp_xtensa_flash_bank *esp_xtensa_info = bank->driver_priv;
+	struct xtensa_algo_run_data run;
+	struct esp_xtensa_flash_bp_op_state op_state;
+	struct mem_param mp;
+	struct esp_xtensa_common *esp_xtensa = target_to_esp_xtensa(target);
+	struct xtensa_algo_image flasher_image;
+	struct duration bench;
+
+	int ret = esp_xtensa_flasher_image_init(&flasher_image, esp_xtensa_info->get_stub(bank));
+	if (ret != ERROR_OK)
+		return ret;
+
+	op_state.esp_xtensa_info = esp_xtensa_info;
+	memset(&run, 0, sizeof(run));
+	run.stack_size = 1300;
+	run.usr_func_arg = &op_state;
+	run.usr_func_init = (xtensa_algo_usr_func_init_t)esp_xtensa_flash_bp_op_state_init;
+	run.usr_func_done = (xtensa_algo_usr_func_done_t)esp_xtensa_flash_bp_op_state_cleanup;
+
+	init_mem_param(&mp, 1 /*1st usr arg*/, num * sizeof(struct esp_xtensa_flash_bp_op),
+		PARAM_IN_OUT);
+	for (size_t i = 0; i < num; i++) {
+		uint8_t *op = mp.value + i * sizeof(struct esp_xtensa_flash_bp_op);
+		memset(op, 0, sizeof(struct esp_xtensa_flash_bp_op));
+		target_buffer_set_u32(target, op, esp_xtensa_info->hw_flash_base +
+			(ops[i]->address - bank->base));
+		if (ops[i]->pending == ESP_XTENSA_SPEC_BP_PENDING_SET) {
+			op[4] = ESP_XTENSA_STUB_FLASH_BP_OP_SET;
+		} else {
+			op[4] = ESP_XTENSA_STUB_FLASH_BP_OP_CLEAR;
+			op[5] = ops[i]->data.insn_sz;
+			memcpy(&op[6], ops[i]->data.insn, 3);
+		}
+	}
+	run.mem_args.params = &mp;
+	run.mem_args.count = 1;
+
+	duration_start(&bench);
+	ret = esp_xtensa_info->run_func_image(esp_xtensa->chip_target,
+		&run,
+		&flasher_image,
+		4 /*args num*/,
+		ESP_XTENSA_STUB_CMD_FLASH_BP_BATCH /*cmd*/,
+		0 /*address of ops*/,
+		num /*ops num*/,
+		0 /*address to store insn sectors*/);
+	if (ret != ERROR_OK) {
+		LOG_ERROR("%s: Failed to run flasher stub (%d)!", target_name(target), ret);
+		destroy_mem_param(&mp);
+		return ret;
+	}
+	if (run.ret_code == ESP_XTENSA_STUB_ERR_NOT_SUPPORTED) {
+		/* older stub, ops will be applied one by one */
+		LOG_DEBUG("%s: Flasher stub does not support bp batches", target_name(target));
+		esp_xtensa_info->bp_batch_unsupported = true;
+		destroy_mem_param(&mp);
+		return ERROR_OK;
+	}
+	if (run.ret_code != ESP_XTENSA_STUB_ERR_OK) {
+		LOG_ERROR("%s: Failed to apply flash bps (%d)!", target_name(target), run.ret_code);
+		destroy_mem_param(&mp);
+		return ERROR_FAIL;
+	}
+	for (size_t i = 0; i < num; i++) {
+		uint8_t *op = mp.value + i * sizeof(struct esp_xtensa_flash_bp_op);
+		if (ops[i]->pending == ESP_XTENSA_SPEC_BP_PENDING_SET) {
+			ops[i]->data.insn_sz = op[5];
+			memcpy(ops[i]->data.insn, &op[6], 3);
+			ops[i]->pending = ESP_XTENSA_SPEC_BP_PENDING_NONE;
+		} else {
+			memset(ops[i], 0, sizeof(*ops[i]));
+		}
+	}
+	destroy_mem_param(&mp);
+	if (duration_measure(&bench) == 0)
+		LOG_DEBUG("PROF: Applied %zu flash breakpoint ops in %g ms", num,
+			duration_elapsed(&bench) * 1000);
+
+	return ERROR_OK;
+}
+
+int esp_xtensa_flash_breakpoints_flush(struct target *target,
+	struct esp_xtensa_special_breakpoint *sw_bps,
+	size_t num)
+{
+	struct esp_xtensa_special_breakpoint **ops;
+	size_t ops_num = 0;
+	int ret = ERROR_OK;
+
+	ops = malloc(num * sizeof(*ops));
+	if (ops == NULL) {
+		LOG_ERROR("Failed to alloc memory for flash bp ops!");
+		return ERROR_FAIL;
+	}
+	for (size_t i = 0; i < num; i++) {
+		if (sw_bps[i].pending != ESP_XTENSA_SPEC_BP_PENDING_NONE)
+			ops[ops_num++] = &sw_bps[i];
+	}
+	if (ops_num == 0)
+		goto _exit;
+	/* ops in the same sector go in a row */
+	qsort(ops, ops_num, sizeof(*ops), esp_xtensa_flash_bp_op_cmp);
+
+	for (size_t i = 0; i < ops_num; ) {
+		struct flash_bank *bank = ops[i]->priv;
+		struct esp_xtensa_flash_bank *esp_xtensa_info = bank->driver_priv;
+		size_t k = i;
+		while (k < ops_num && ops[k]->priv == bank)
+			k++;
+		if (!esp_xtensa_info->bp_batch_unsupported) {
+			ret = esp_xtensa_flash_bp_batch(target, bank, &ops[i], k - i);
+			if (ret != ERROR_OK)
+				goto _exit;
+		}
+		for (; i < k; i++) {
+			if (ops[i]->pending == ESP_XTENSA_SPEC_BP_PENDING_SET) {
+				ret = esp_xtensa_flash_bp_set(target, ops[i]);
+				if (ret != ERROR_OK)
+					goto _exit;
+				ops[i]->pending = ESP_XTENSA_SPEC_BP_PENDING_NONE;
+			} else if (ops[i]->pending == ESP_XTENSA_SPEC_BP_PENDING_CLEAR) {
+				ret = esp_xtensa_flash_bp_clear(target, ops[i]);
+				if (ret != ERROR_OK)
+					goto _exit;
+				memset(ops[i], 0, sizeof(*ops[i]));
+			}
+		}
+	}
+_exit:
+	free(ops);
 	return ret;
 }
 
@@ -42,6 +42,10 @@ struct esp_xtensa_flash_bank {
 	uint32_t hw_flash_base;
 	/* Offset of the application image in the HW flash bank */
 	uint32_t appimage_flash_base;
+	/* Size of the target buffer for flash data allocated by the last write */
+	uint32_t wr_buf_sz;
+	/* Flasher stub can not apply flash breakpoints in batches */
+	bool bp_batch_unsupported;
 	const struct esp_xtensa_flasher_stub_config *(*get_stub)(struct flash_bank *bank);
 	/* function to run algorithm on Xtensa target */
 	int (*run_func_image)(struct target *target, struct xtensa_algo_run_data *run,
@@ -82,5 +86,8 @@ int esp_xtensa_flash_breakpoint_add(struct target *target,
 	struct esp_xtensa_special_breakpoint *sw_bp);
 int esp_xtensa_flash_breakpoint_remove(struct target *target,
 	struct esp_xtensa_special_breakpoint *sw_bp);
+int esp_xtensa_flash_breakpoints_flush(struct target *target,
+	struct esp_xtensa_special_breakpoint *sw_bps,
+	size_t num);
 
 #endif	/*FLASH_ESP_XTENSA_H*/
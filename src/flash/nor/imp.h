@@ -42,8 +42,9 @@ int flash_driver_write(struct flash_bank *bank,
 int flash_driver_read(struct flash_bank *bank,
 		uint8_t *buffer, uint32_t offset, uint32_t count);
 
-/* write (optional verify) an image to flash memory of the given target */
+/* write (optional verify) an image to flash memory of the given target;
+ * with dry_run set, only log the planned unlock/erase ranges and writes */
 int flash_write_unlock(struct target *target, struct image *image,
-		uint32_t *written, int erase, bool unlock);
+		uint32_t *written, int erase, bool unlock, bool dry_run);
 
 #endif /* OPENOCD_FLASH_NOR_IMP_H */
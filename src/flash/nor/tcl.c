@@ -415,6 +415,7 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	/* flash auto-erase is disabled by default*/
 	int auto_erase = 0;
 	bool auto_unlock = false;
+	bool dry_run = false;
 
 	while (CMD_ARGC) {
 		if (strcmp(CMD_ARGV[0], "erase") == 0) {
@@ -427,6 +428,10 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 			CMD_ARGV++;
 			CMD_ARGC--;
 			command_print(CMD, "auto unlock enabled");
+		} else if (strcmp(CMD_ARGV[0], "dry_run") == 0) {
+			dry_run = true;
+			CMD_ARGV++;
+			CMD_ARGC--;
 		} else
 			break;
 	}
@@ -456,12 +461,19 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	if (retval != ERROR_OK)
 		return retval;
 
-	retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock);
+	retval = flash_write_unlock(target, &image, &written, auto_erase, auto_unlock, dry_run);
 	if (retval != ERROR_OK) {
 		image_close(&image);
 		return retval;
 	}
 
+	if (dry_run) {
+		command_print(CMD, "dry run: would write %" PRIu32 " bytes from file %s",
+			written, CMD_ARGV[0]);
+		image_close(&image);
+		return retval;
+	}
+
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
 		command_print(CMD, "wrote %" PRIu32 " bytes from file %s "
 			"in %fs (%0.3f KiB/s)", written, CMD_ARGV[0],
@@ -1038,7 +1050,7 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.name = "write_image",
 		.handler = handle_flash_write_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "[erase] [unlock] filename [offset [file_type]]",
+		.usage = "[erase] [unlock] [dry_run] filename [offset [file_type]]",
 		.help = "Write an image to flash.  Optionally first unprotect "
 			"and/or erase the region to be used.  Allow optional "
 			"offset from beginning of bank (defaults to zero)",
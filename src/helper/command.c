@@ -144,34 +144,36 @@ void script_debug(Jim_Interp *interp, const char *name,
 	free(dbg);
 }
 
-static void script_command_args_free(char **words, unsigned nwords)
-{
-	for (unsigned i = 0; i < nwords; i++)
-		free(words[i]);
-	free(words);
-}
+/* argv of up to this many words is built on the stack */
+#define SCRIPT_COMMAND_ARGS_INLINE	16
 
-static char **script_command_args_alloc(
-	unsigned argc, Jim_Obj * const *argv, unsigned *nwords)
+/**
+ * Point @a words at the strings of the Jim arguments; they stay valid for
+ * as long as the caller holds @a argv. Only commands with more than
+ * SCRIPT_COMMAND_ARGS_INLINE words need an allocation, which
+ * script_command_args_free() releases.
+ */
+static const char **script_command_args_alloc(unsigned argc, Jim_Obj * const *argv,
+	const char **inline_words)
 {
-	char **words = malloc(argc * sizeof(char *));
-	if (NULL == words)
-		return NULL;
-
-	unsigned i;
-	for (i = 0; i < argc; i++) {
-		int len;
-		const char *w = Jim_GetString(argv[i], &len);
-		words[i] = strdup(w);
-		if (words[i] == NULL) {
-			script_command_args_free(words, i);
+	const char **words = inline_words;
+	if (argc > SCRIPT_COMMAND_ARGS_INLINE) {
+		words = malloc(argc * sizeof(char *));
+		if (NULL == words)
 			return NULL;
-		}
 	}
-	*nwords = i;
+
+	for (unsigned i = 0; i < argc; i++)
+		words[i] = Jim_GetString(argv[i], NULL);
 	return words;
 }
 
+static void script_command_args_free(const char **words, const char **inline_words)
+{
+	if (words != inline_words)
+		free(words);
+}
+
 struct command_context *current_command_context(Jim_Interp *interp)
 {
 	/* grab the command context from the associated data */
@@ -189,21 +191,26 @@ struct command_context *current_command_context(Jim_Interp *interp)
 	return cmd_ctx;
 }
 
+/* nesting depth of exec_batch, which polls once for all of its commands */
+static unsigned command_batch_depth;
+
 static int script_command_run(Jim_Interp *interp,
 	int argc, Jim_Obj * const *argv, struct command *c)
 {
-	target_call_timer_callbacks_now();
-	LOG_USER_N("%s", "");	/* Keep GDB connection alive*/
+	if (!command_batch_depth) {
+		target_call_timer_callbacks_now();
+		LOG_USER_N("%s", "");	/* Keep GDB connection alive*/
+	}
 
-	unsigned nwords;
-	char **words = script_command_args_alloc(argc, argv, &nwords);
+	const char *inline_words[SCRIPT_COMMAND_ARGS_INLINE];
+	const char **words = script_command_args_alloc(argc, argv, inline_words);
 	if (NULL == words)
 		return JIM_ERR;
 
 	struct command_context *cmd_ctx = current_command_context(interp);
-	int retval = run_command(cmd_ctx, c, (const char **)words, nwords);
+	int retval = run_command(cmd_ctx, c, words, argc);
 
-	script_command_args_free(words, nwords);
+	script_command_args_free(words, inline_words);
 	return command_retval_set(interp, retval);
 }
 
@@ -224,6 +231,39 @@ static struct command *command_root(struct command *c)
 	return c;
 }
 
+/* Besides the sorted lists used for help, all commands are kept in a hash
+ * table keyed by parent and name, so scripts issuing many commands don't
+ * walk the lists on every call. */
+#define COMMAND_HASH_SIZE	1024
+
+static struct command *command_hash[COMMAND_HASH_SIZE];
+
+static unsigned command_hash_key(const struct command *parent, const char *name)
+{
+	/* FNV-1a over the name, then the parent */
+	uint32_t h = 2166136261u;
+	while (*name)
+		h = (h ^ (uint8_t)*name++) * 16777619u;
+	h = (h ^ (uint32_t)((uintptr_t)parent >> 4)) * 16777619u;
+	return (h ^ (h >> 16)) % COMMAND_HASH_SIZE;
+}
+
+static void command_hash_add(struct command *c)
+{
+	unsigned key = command_hash_key(c->parent, c->name);
+	c->hash_next = command_hash[key];
+	command_hash[key] = c;
+}
+
+static void command_hash_remove(struct command *c)
+{
+	struct command **p = &command_hash[command_hash_key(c->parent, c->name)];
+	while (*p && *p != c)
+		p = &(*p)->hash_next;
+	if (*p)
+		*p = c->hash_next;
+}
+
 /**
  * Find a command by name from a list of commands.
  * @returns Returns the named command if it exists in the list.
@@ -231,8 +271,13 @@ static struct command *command_root(struct command *c)
  */
 static struct command *command_find(struct command *head, const char *name)
 {
-	for (struct command *cc = head; cc; cc = cc->next) {
-		if (strcmp(cc->name, name) == 0)
+	if (NULL == head)
+		return NULL;
+
+	/* all commands in a list share the parent */
+	struct command *parent = head->parent;
+	for (struct command *cc = command_hash[command_hash_key(parent, name)]; cc; cc = cc->hash_next) {
+		if (cc->parent == parent && strcmp(cc->name, name) == 0)
 			return cc;
 	}
 	return NULL;
@@ -291,6 +336,8 @@ static void command_free(struct command *c)
 		command_free(tmp);
 	}
 
+	if (c->name)
+		command_hash_remove(c);
 	free(c->name);
 	free(c->help);
 	free(c->usage);
@@ -337,6 +384,7 @@ static struct command *command_new(struct command_context *cmd_ctx,
 	c->mode = cr->mode;
 
 	command_add_child(command_list_for_parent(cmd_ctx, parent), c);
+	command_hash_add(c);
 
 	return c;
 
@@ -801,6 +849,45 @@ static int jim_capture(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
 	return retcode;
 }
 
+/* Run each argument as a command and return the list of their results.
+ * Targets are polled once for the whole batch rather than before every
+ * command, so a client can issue many memory or register accesses in one
+ * round trip. Stops at the first command that fails. */
+static int jim_exec_batch(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	if (argc < 2) {
+		Jim_WrongNumArgs(interp, 1, argv, "command ...");
+		return JIM_ERR;
+	}
+
+	target_call_timer_callbacks_now();
+	LOG_USER_N("%s", "");	/* Keep GDB connection alive*/
+
+	int flushes = jtag_get_flush_queue_count();
+	Jim_Obj *results = Jim_NewListObj(interp, NULL, 0);
+	Jim_IncrRefCount(results);
+
+	int retcode = JIM_OK;
+	command_batch_depth++;
+	for (int i = 1; i < argc; i++) {
+		retcode = Jim_EvalObj(interp, argv[i]);
+		if (retcode != JIM_OK) {
+			Jim_SetResultFormatted(interp, "command %d: %#s", i, Jim_GetResult(interp));
+			break;
+		}
+		Jim_ListAppendElement(interp, results, Jim_GetResult(interp));
+	}
+	command_batch_depth--;
+
+	LOG_DEBUG("batch of %d commands, %d JTAG flushes", argc - 1,
+			jtag_get_flush_queue_count() - flushes);
+
+	if (retcode == JIM_OK)
+		Jim_SetResult(interp, results);
+	Jim_DecrRefCount(interp, results);
+	return retcode;
+}
+
 static COMMAND_HELPER(command_help_find, struct command *head,
 	struct command **out)
 {
@@ -1279,6 +1366,15 @@ static const struct command_registration command_builtin_handlers[] = {
 			"command can be multiple tokens.",
 		.usage = "[command_name]",
 	},
+	{
+		.name = "exec_batch",
+		.mode = COMMAND_ANY,
+		.jim_handler = jim_exec_batch,
+		.help = "Run each argument as a command and return the "
+			"list of their results; targets are polled once "
+			"for the whole batch.",
+		.usage = "command [command ...]",
+	},
 	{
 		.name = "command",
 		.mode = COMMAND_ANY,
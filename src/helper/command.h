@@ -193,6 +193,8 @@ struct command {
 		 * jim_handler_data for any handler specific data */
 	enum command_mode mode;
 	struct command *next;
+	/* next command in the same bucket of the lookup hash table */
+	struct command *hash_next;
 };
 
 /**
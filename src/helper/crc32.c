@@ -0,0 +1,75 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdbool.h>
+
+#include "crc32.h"
+
+/* Slice-by-8: crc32_table[k][i] is the CRC of byte i followed by k zero
+ * bytes, so eight input bytes can be folded in with eight lookups. */
+static uint32_t crc32_table[8][256];
+
+static void crc32_init(void)
+{
+	static bool first_init;
+	if (first_init)
+		return;
+
+	for (unsigned int i = 0; i < 256; i++) {
+		/* as per gdb */
+		uint32_t c = i << 24;
+		for (unsigned int j = 0; j < 8; j++)
+			c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
+		crc32_table[0][i] = c;
+	}
+	for (unsigned int i = 0; i < 256; i++) {
+		uint32_t c = crc32_table[0][i];
+		for (unsigned int k = 1; k < 8; k++) {
+			c = (c << 8) ^ crc32_table[0][c >> 24];
+			crc32_table[k][i] = c;
+		}
+	}
+
+	first_init = true;
+}
+
+uint32_t crc32_gdb(uint32_t crc, const uint8_t *buffer, size_t nbytes)
+{
+	crc32_init();
+
+	while (nbytes >= 8) {
+		crc ^= (uint32_t)buffer[0] << 24 | (uint32_t)buffer[1] << 16 |
+			(uint32_t)buffer[2] << 8 | buffer[3];
+		crc = crc32_table[7][crc >> 24] ^
+			crc32_table[6][(crc >> 16) & 255] ^
+			crc32_table[5][(crc >> 8) & 255] ^
+			crc32_table[4][crc & 255] ^
+			crc32_table[3][buffer[4]] ^
+			crc32_table[2][buffer[5]] ^
+			crc32_table[1][buffer[6]] ^
+			crc32_table[0][buffer[7]];
+		buffer += 8;
+		nbytes -= 8;
+	}
+
+	while (nbytes--)
+		crc = (crc << 8) ^ crc32_table[0][((crc >> 24) ^ *buffer++) & 255];
+
+	return crc;
+}
@@ -0,0 +1,29 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef OPENOCD_HELPER_CRC32_H
+#define OPENOCD_HELPER_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Update a CRC32 the way GDB computes it for "qCRC" and "compare-sections":
+ * polynomial 0x04c11db7, most significant bit first, no reflection and no
+ * final inversion. Start with 0xffffffff.
+ */
+uint32_t crc32_gdb(uint32_t crc, const uint8_t *buffer, size_t nbytes);
+
+#endif /* OPENOCD_HELPER_CRC32_H */
@@ -30,12 +30,21 @@
 #include "configuration.h"
 #include "fileio.h"
 
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 struct fileio {
 	char *url;
 	size_t size;
 	enum fileio_type type;
 	enum fileio_access access;
 	FILE *file;
+	/* read-only mapping of the whole file, see fileio_map() */
+	void *map;
 };
 
 static inline int fileio_close_local(struct fileio *fileio)
@@ -127,6 +136,7 @@ int fileio_open(struct fileio **fileio, const char *url,
 	tmp->type = type;
 	tmp->access = access_type;
 	tmp->url = strdup(url);
+	tmp->map = NULL;
 
 	retval = fileio_open_local(tmp);
 
@@ -145,6 +155,11 @@ int fileio_close(struct fileio *fileio)
 {
 	int retval;
 
+#ifdef HAVE_SYS_MMAN_H
+	if (fileio->map)
+		munmap(fileio->map, fileio->size);
+#endif
+
 	retval = fileio_close_local(fileio);
 
 	free(fileio->url);
@@ -272,3 +287,54 @@ int fileio_size(struct fileio *fileio, size_t *size)
 
 	return ERROR_OK;
 }
+
+/**
+ * Modification time of the file in nanoseconds since the epoch, as precise
+ * as the host reports it; whole seconds where sub-second times are missing.
+ */
+int fileio_mtime(struct fileio *fileio, int64_t *mtime_ns)
+{
+	struct stat st;
+
+	if (fstat(fileno(fileio->file), &st) != 0) {
+		LOG_ERROR("couldn't stat %s: %s", fileio->url, strerror(errno));
+		return ERROR_FILEIO_OPERATION_FAILED;
+	}
+
+	*mtime_ns = (int64_t)st.st_mtime * 1000000000;
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+	*mtime_ns += st.st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+	*mtime_ns += st.st_mtimespec.tv_nsec;
+#endif
+
+	return ERROR_OK;
+}
+
+/**
+ * Map the whole file read-only into memory. The mapping stays valid until
+ * the file is closed. Callers are expected to fall back to fileio_read()
+ * if mapping is not supported on this host or for this file.
+ */
+int fileio_map(struct fileio *fileio, const uint8_t **data)
+{
+#ifdef HAVE_SYS_MMAN_H
+	if (fileio->access != FILEIO_READ || fileio->size == 0)
+		return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+
+	if (!fileio->map) {
+		void *map = mmap(NULL, fileio->size, PROT_READ, MAP_PRIVATE, fileno(fileio->file), 0);
+		if (map == MAP_FAILED) {
+			LOG_DEBUG("couldn't map %s: %s", fileio->url, strerror(errno));
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+		}
+		fileio->map = map;
+	}
+
+	*data = fileio->map;
+
+	return ERROR_OK;
+#else
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
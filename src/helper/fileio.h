@@ -59,6 +59,8 @@ int fileio_write(struct fileio *fileio,
 int fileio_read_u32(struct fileio *fileio, uint32_t *data);
 int fileio_write_u32(struct fileio *fileio, uint32_t data);
 int fileio_size(struct fileio *fileio, size_t *size);
+int fileio_mtime(struct fileio *fileio, int64_t *mtime_ns);
+int fileio_map(struct fileio *fileio, const uint8_t **data);
 
 #define ERROR_FILEIO_LOCATION_UNKNOWN			(-1200)
 #define ERROR_FILEIO_NOT_FOUND					(-1201)
@@ -31,6 +31,7 @@
 #include "time_support.h"
 
 #include <stdarg.h>
+#include <pthread.h>
 
 #ifdef _DEBUG_FREE_SPACE_
 #ifdef HAVE_MALLOC_H
@@ -61,6 +62,255 @@ static const char * const log_strings[6] = {
 
 static int count;
 
+/* Log callbacks (telnet, gdb, tcl notifications) and the output file belong
+ * to the main thread.  Messages logged from helper threads, e.g. the adapter
+ * I/O thread, are queued here and emitted by the main thread the next time
+ * it logs, calls keep_alive() or reaps an asynchronous JTAG queue. */
+struct log_deferred {
+	struct log_deferred *next;
+	enum log_levels level;
+	const char *file;
+	int line;
+	const char *function;
+	char string[];
+};
+
+static pthread_t log_main_thread;
+static bool log_main_thread_valid;
+static pthread_mutex_t log_deferred_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct log_deferred *log_deferred_head;
+static struct log_deferred **log_deferred_tail = &log_deferred_head;
+static bool log_deferred_pending;
+
+/* Asynchronous logging: log_puts() appends each line to a ring, producers
+ * serialized by a mutex, and a writer thread formats the headers and writes
+ * whole batches to log_output, instead of one fprintf()/fflush() per line.
+ * Log callbacks (telnet, gdb) are still called synchronously. */
+enum log_async_mode {
+	LOG_ASYNC_OFF,
+	LOG_ASYNC_TEXT,
+	LOG_ASYNC_BINARY,
+};
+
+static const char * const log_async_mode_names[] = {
+	[LOG_ASYNC_OFF] = "off",
+	[LOG_ASYNC_TEXT] = "text",
+	[LOG_ASYNC_BINARY] = "binary",
+};
+
+#define LOG_ASYNC_RING_SIZE		(4 * 1024 * 1024)
+/* magic at the start of a binary log file, followed by the records */
+#define LOG_BINARY_MAGIC		"OCDLOG\0\1"
+
+struct log_async_record {
+	uint32_t size;			/* whole record incl. strings, 8-byte aligned; 0: skip to ring start */
+	int32_t level;
+	uint32_t count;
+	uint32_t line;
+	int64_t time;			/* ms since log_init() */
+	uint16_t file_len;		/* strings follow, each without terminator */
+	uint16_t function_len;
+	uint32_t string_len;
+	bool verbose;			/* debug_level was >= LOG_LVL_DEBUG */
+};
+
+static struct {
+	enum log_async_mode mode;
+	uint8_t *ring;
+	/* free-running offsets; head is only written by producers holding
+	 * push_lock, tail only by the writer thread */
+	uint64_t head;
+	uint64_t tail;
+	pthread_mutex_t push_lock;
+	bool stop;
+	pthread_t writer;
+} log_async = {
+	.push_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void log_async_write_text(const struct log_async_record *rec)
+{
+	const char *file = (const char *)(rec + 1);
+	const char *function = file + rec->file_len;
+	const char *string = function + rec->function_len;
+
+	if (rec->level == LOG_LVL_OUTPUT) {
+		fwrite(string, 1, rec->string_len, log_output);
+		return;
+	}
+
+	if (rec->verbose)
+		fprintf(log_output, "%s%" PRIu32 " %" PRId64 " %.*s:%" PRIu32 " %.*s(): ",
+			log_strings[rec->level + 1], rec->count, rec->time,
+			rec->file_len, file, rec->line, rec->function_len, function);
+	else if (rec->level > LOG_LVL_USER)
+		fputs(log_strings[rec->level + 1], log_output);
+	fwrite(string, 1, rec->string_len, log_output);
+}
+
+static void log_async_write_binary(const struct log_async_record *rec)
+{
+	uint8_t hdr[28];
+	uint32_t payload = rec->file_len + rec->function_len + rec->string_len;
+
+	h_u32_to_le(hdr, sizeof(hdr) - 4 + payload);
+	h_u32_to_le(hdr + 4, rec->count);
+	h_u64_to_le(hdr + 8, rec->time);
+	h_u32_to_le(hdr + 16, rec->line);
+	hdr[20] = (uint8_t)(int8_t)rec->level;
+	hdr[21] = rec->verbose;
+	h_u16_to_le(hdr + 22, rec->file_len);
+	h_u16_to_le(hdr + 24, rec->function_len);
+	h_u16_to_le(hdr + 26, 0);
+	fwrite(hdr, 1, sizeof(hdr), log_output);
+	fwrite(rec + 1, 1, payload, log_output);
+}
+
+static void *log_async_writer(void *arg)
+{
+	for (;;) {
+		uint64_t head = __atomic_load_n(&log_async.head, __ATOMIC_ACQUIRE);
+		uint64_t tail = log_async.tail;
+
+		if (head == tail) {
+			if (__atomic_load_n(&log_async.stop, __ATOMIC_ACQUIRE))
+				break;
+			usleep(5000);
+			continue;
+		}
+
+		while (tail != head) {
+			uint32_t pos = tail % LOG_ASYNC_RING_SIZE;
+			struct log_async_record *rec = (struct log_async_record *)(log_async.ring + pos);
+
+			if (rec->size == 0) {
+				/* producer wrapped around */
+				tail += LOG_ASYNC_RING_SIZE - pos;
+				continue;
+			}
+
+			if (log_async.mode == LOG_ASYNC_BINARY)
+				log_async_write_binary(rec);
+			else
+				log_async_write_text(rec);
+			tail += rec->size;
+		}
+
+		fflush(log_output);
+		__atomic_store_n(&log_async.tail, tail, __ATOMIC_RELEASE);
+	}
+
+	fflush(log_output);
+	return NULL;
+}
+
+static void log_async_push(enum log_levels level, const char *file, int line,
+	const char *function, const char *string)
+{
+	size_t file_len = MIN(strlen(file), UINT16_MAX);
+	size_t function_len = MIN(strlen(function), UINT16_MAX);
+	size_t string_len = strlen(string);
+	uint32_t size = sizeof(struct log_async_record) + file_len + function_len + string_len;
+	size = (size + 7) & ~7;
+
+	if (size > LOG_ASYNC_RING_SIZE / 4) {
+		/* way too long for the ring, cut it */
+		string_len -= size - LOG_ASYNC_RING_SIZE / 4;
+		size = LOG_ASYNC_RING_SIZE / 4;
+	}
+
+	pthread_mutex_lock(&log_async.push_lock);
+
+	uint64_t head = log_async.head;
+	uint32_t pos = head % LOG_ASYNC_RING_SIZE;
+	/* records are never split, skip the tail end of the ring if needed */
+	uint32_t skip = (pos + size > LOG_ASYNC_RING_SIZE) ? LOG_ASYNC_RING_SIZE - pos : 0;
+
+	/* the writer is behind, wait rather than lose log lines */
+	while (head + skip + size - __atomic_load_n(&log_async.tail, __ATOMIC_ACQUIRE) > LOG_ASYNC_RING_SIZE)
+		usleep(100);
+
+	if (skip) {
+		((struct log_async_record *)(log_async.ring + pos))->size = 0;
+		head += skip;
+		pos = 0;
+	}
+
+	struct log_async_record *rec = (struct log_async_record *)(log_async.ring + pos);
+	rec->size = size;
+	rec->level = level;
+	rec->count = count;
+	rec->line = line;
+	rec->time = timeval_ms() - start;
+	rec->file_len = file_len;
+	rec->function_len = function_len;
+	rec->string_len = string_len;
+	rec->verbose = debug_level >= LOG_LVL_DEBUG;
+	char *p = (char *)(rec + 1);
+	memcpy(p, file, file_len);
+	memcpy(p + file_len, function, function_len);
+	memcpy(p + file_len + function_len, string, string_len);
+
+	__atomic_store_n(&log_async.head, head + size, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&log_async.push_lock);
+}
+
+/* drain the ring and stop the writer thread */
+static void log_async_stop(void)
+{
+	if (log_async.mode == LOG_ASYNC_OFF)
+		return;
+
+	__atomic_store_n(&log_async.stop, true, __ATOMIC_RELEASE);
+	pthread_join(log_async.writer, NULL);
+	log_async.mode = LOG_ASYNC_OFF;
+	free(log_async.ring);
+	log_async.ring = NULL;
+}
+
+static int log_async_start(enum log_async_mode mode)
+{
+	static bool atexit_registered;
+
+	log_async_stop();
+	if (mode == LOG_ASYNC_OFF)
+		return ERROR_OK;
+
+	if (mode == LOG_ASYNC_BINARY && (log_output == stderr || isatty(fileno(log_output)))) {
+		LOG_ERROR("binary log output needs a file, see log_output");
+		return ERROR_FAIL;
+	}
+
+	log_async.ring = malloc(LOG_ASYNC_RING_SIZE);
+	if (!log_async.ring) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	log_async.head = 0;
+	log_async.tail = 0;
+	log_async.stop = false;
+
+	if (mode == LOG_ASYNC_BINARY)
+		fwrite(LOG_BINARY_MAGIC, 1, sizeof(LOG_BINARY_MAGIC) - 1, log_output);
+
+	log_async.mode = mode;
+	if (pthread_create(&log_async.writer, NULL, log_async_writer, NULL) != 0) {
+		log_async.mode = LOG_ASYNC_OFF;
+		free(log_async.ring);
+		log_async.ring = NULL;
+		LOG_ERROR("failed to start log writer thread");
+		return ERROR_FAIL;
+	}
+
+	if (!atexit_registered) {
+		atexit(log_async_stop);
+		atexit_registered = true;
+	}
+
+	return ERROR_OK;
+}
+
 /* forward the log to the listeners */
 static void log_forward(const char *file, unsigned line, const char *function, const char *string)
 {
@@ -84,6 +334,60 @@ static void log_forward(const char *file, unsigned line, const char *function, c
  * target_request.c).
  *
  */
+static void log_puts(enum log_levels level,
+	const char *file,
+	int line,
+	const char *function,
+	const char *string);
+
+static bool log_in_main_thread(void)
+{
+	return !log_main_thread_valid || pthread_equal(pthread_self(), log_main_thread);
+}
+
+static void log_defer(enum log_levels level, const char *file, int line,
+	const char *function, const char *string)
+{
+	size_t len = strlen(string);
+	struct log_deferred *d = malloc(sizeof(*d) + len + 1);
+	if (!d)
+		return;
+
+	d->next = NULL;
+	d->level = level;
+	/* __FILE__ and __func__, they outlive the message */
+	d->file = file;
+	d->line = line;
+	d->function = function;
+	memcpy(d->string, string, len + 1);
+
+	pthread_mutex_lock(&log_deferred_lock);
+	*log_deferred_tail = d;
+	log_deferred_tail = &d->next;
+	__atomic_store_n(&log_deferred_pending, true, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&log_deferred_lock);
+}
+
+void log_flush_deferred(void)
+{
+	if (!__atomic_load_n(&log_deferred_pending, __ATOMIC_ACQUIRE) || !log_in_main_thread())
+		return;
+
+	pthread_mutex_lock(&log_deferred_lock);
+	struct log_deferred *d = log_deferred_head;
+	log_deferred_head = NULL;
+	log_deferred_tail = &log_deferred_head;
+	__atomic_store_n(&log_deferred_pending, false, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&log_deferred_lock);
+
+	while (d) {
+		struct log_deferred *next = d->next;
+		log_puts(d->level, d->file, d->line, d->function, d->string);
+		free(d);
+		d = next;
+	}
+}
+
 static void log_puts(enum log_levels level,
 	const char *file,
 	int line,
@@ -91,6 +395,27 @@ static void log_puts(enum log_levels level,
 	const char *string)
 {
 	char *f;
+
+	if (!log_in_main_thread()) {
+		log_defer(level, file, line, function, string);
+		return;
+	}
+	/* keep the order of the messages */
+	log_flush_deferred();
+
+	if (log_async.mode != LOG_ASYNC_OFF) {
+		if (level != LOG_LVL_OUTPUT) {
+			f = strrchr(file, '/');
+			if (f != NULL)
+				file = f + 1;
+		}
+		if (strlen(string) > 0)
+			log_async_push(level, file, line, function, string);
+		if (level != LOG_LVL_OUTPUT && level <= LOG_LVL_INFO)
+			log_forward(file, line, function, string);
+		return;
+	}
+
 	if (level == LOG_LVL_OUTPUT) {
 		/* do not prepend any headers, just print out what we were given and return */
 		fputs(string, log_output);
@@ -147,7 +472,7 @@ void log_printf(enum log_levels level,
 	char *string;
 	va_list ap;
 
-	count++;
+	__atomic_add_fetch(&count, 1, __ATOMIC_RELAXED);
 	if (level > debug_level)
 		return;
 
@@ -167,7 +492,7 @@ void log_vprintf_lf(enum log_levels level, const char *file, unsigned line,
 {
 	char *tmp;
 
-	count++;
+	__atomic_add_fetch(&count, 1, __ATOMIC_RELAXED);
 
 	if (level > debug_level)
 		return;
@@ -226,16 +551,43 @@ COMMAND_HANDLER(handle_log_output_command)
 			LOG_ERROR("failed to open output log '%s'", CMD_ARGV[0]);
 			return ERROR_FAIL;
 		}
+		/* the writer thread must not see the file change under it */
+		enum log_async_mode mode = log_async.mode;
+		log_async_stop();
 		if (log_output != stderr && log_output != NULL) {
 			/* Close previous log file, if it was open and wasn't stderr. */
 			fclose(log_output);
 		}
 		log_output = file;
+		return log_async_start(mode);
 	}
 
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_log_async_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		enum log_async_mode mode;
+		for (mode = LOG_ASYNC_OFF; mode <= LOG_ASYNC_BINARY; mode++)
+			if (!strcmp(CMD_ARGV[0], log_async_mode_names[mode]))
+				break;
+		if (mode > LOG_ASYNC_BINARY)
+			return ERROR_COMMAND_SYNTAX_ERROR;
+
+		int retval = log_async_start(mode);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	command_print(CMD, "log_async: %s", log_async_mode_names[log_async.mode]);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration log_command_handlers[] = {
 	{
 		.name = "log_output",
@@ -244,6 +596,14 @@ static const struct command_registration log_command_handlers[] = {
 		.help = "redirect logging to a file (default: stderr)",
 		.usage = "file_name",
 	},
+	{
+		.name = "log_async",
+		.handler = handle_log_async_command,
+		.mode = COMMAND_ANY,
+		.help = "write the log from a background thread, as text or "
+			"in a compact binary format for offline decoding",
+		.usage = "['off'|'text'|'binary']",
+	},
 	{
 		.name = "debug_level",
 		.handler = handle_debug_level_command,
@@ -283,12 +643,17 @@ void log_init(void)
 		log_output = stderr;
 
 	start = last_time = timeval_ms();
+
+	log_main_thread = pthread_self();
+	log_main_thread_valid = true;
 }
 
 int set_log_output(struct command_context *cmd_ctx, FILE *output)
 {
+	enum log_async_mode mode = log_async.mode;
+	log_async_stop();
 	log_output = output;
-	return ERROR_OK;
+	return log_async_start(mode);
 }
 
 /* add/remove log callback handler */
@@ -392,6 +757,8 @@ char *alloc_printf(const char *format, ...)
  */
 void keep_alive()
 {
+	log_flush_deferred();
+
 	current_time = timeval_ms();
 	if (current_time-last_time > 1000) {
 		extern int gdb_actual_connections;
@@ -76,6 +76,9 @@ int set_log_output(struct command_context *cmd_ctx, FILE *output);
 
 int log_register_commands(struct command_context *cmd_ctx);
 
+/* emit messages logged by other threads; only acts on the main thread */
+void log_flush_deferred(void);
+
 void keep_alive(void);
 void kept_alive(void);
 
@@ -121,16 +121,19 @@ void *cmd_queue_alloc(size_t size)
 	return t + offset;
 }
 
-static void cmd_queue_free(void)
+static void cmd_queue_pages_free(struct cmd_queue_page *page)
 {
-	struct cmd_queue_page *page = cmd_queue_pages;
-
 	while (page) {
 		struct cmd_queue_page *last = page;
 		free(page->address);
 		page = page->next;
 		free(last);
 	}
+}
+
+static void cmd_queue_free(void)
+{
+	cmd_queue_pages_free(cmd_queue_pages);
 
 	cmd_queue_pages = NULL;
 	cmd_queue_pages_tail = NULL;
@@ -144,6 +147,27 @@ void jtag_command_queue_reset(void)
 	next_command_pointer = &jtag_command_queue;
 }
 
+void jtag_command_queue_detach(struct jtag_command_batch *batch)
+{
+	batch->cmd_queue = jtag_command_queue;
+	batch->pages = cmd_queue_pages;
+
+	/* the pages now belong to the batch, start over with an empty queue */
+	cmd_queue_pages = NULL;
+	cmd_queue_pages_tail = NULL;
+	jtag_command_queue = NULL;
+	next_command_pointer = &jtag_command_queue;
+}
+
+void jtag_command_batch_free(struct jtag_command_batch *batch)
+{
+	cmd_queue_pages_free(batch->pages);
+
+	batch->cmd_queue = NULL;
+	batch->pages = NULL;
+	batch->callbacks = NULL;
+}
+
 /**
  * Copy a struct scan_field for insertion into the queue.
  *
@@ -168,6 +168,36 @@ void *cmd_queue_alloc(size_t size);
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
 
+struct cmd_queue_page;
+struct jtag_callback_entry;
+
+/**
+ * A command queue taken away from jtag_command_queue, so that it can be
+ * executed while the next queue is being built.  The batch owns the
+ * cmd_queue_alloc() pages holding its commands and callbacks.
+ */
+struct jtag_command_batch {
+	/** First command of the detached queue. */
+	struct jtag_command *cmd_queue;
+	/** Memory pages the commands and callbacks were allocated from. */
+	struct cmd_queue_page *pages;
+	/** Callbacks queued with jtag_add_callback4(), run after execution. */
+	struct jtag_callback_entry *callbacks;
+};
+
+/**
+ * Move the current command queue and its memory into @a batch and
+ * leave an empty queue behind.  Queued callbacks are not touched.
+ */
+void jtag_command_queue_detach(struct jtag_command_batch *batch);
+/** Release the memory of a batch detached by jtag_command_queue_detach(). */
+void jtag_command_batch_free(struct jtag_command_batch *batch);
+
+/** Move the queued callbacks into @a batch and leave an empty callback queue. */
+void interface_jtag_callback_queue_detach(struct jtag_command_batch *batch);
+/** Run a detached callback list in order, stopping at the first failure. */
+int interface_jtag_callback_queue_run(struct jtag_callback_entry *callbacks);
+
 void jtag_scan_field_clone(struct scan_field *dst, const struct scan_field *src);
 enum scan_type jtag_scan_type(const struct scan_command *cmd);
 int jtag_scan_size(const struct scan_command *cmd);
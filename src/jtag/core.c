@@ -35,6 +35,7 @@
 #include "interface.h"
 #include <transport/transport.h>
 #include <helper/jep106.h>
+#include <pthread.h>
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -909,6 +910,9 @@ int default_interface_jtag_execute_queue(void)
 
 void jtag_execute_queue_noclear(void)
 {
+	/* queues submitted earlier must complete first */
+	jtag_async_drain();
+
 	jtag_flush_queue_count++;
 	jtag_set_error(interface_jtag_execute_queue());
 
@@ -932,6 +936,289 @@ int jtag_execute_queue(void)
 	return jtag_error_clear();
 }
 
+/*
+ * Asynchronous queue execution.
+ *
+ * When enabled, queues submitted with jtag_execute_queue_async() are
+ * detached from the global command queue and handed to the adapter I/O
+ * thread, which feeds them to the driver's execute_cmd_queue() one after
+ * the other.  Meanwhile the main loop goes on building the next queue,
+ * serving GDB, telnet and Tcl clients.
+ *
+ * Callbacks added with jtag_add_callback4() are not thread safe in
+ * general, so they stay in the batch and run on the main thread when the
+ * future is reaped, oldest first.  Anything talking to the adapter by
+ * other means than the command queue must call jtag_async_drain() first.
+ * Drivers may log from the I/O thread; log_puts() queues those messages
+ * and the main thread emits them, see log_flush_deferred().
+ */
+struct jtag_future {
+	struct jtag_command_batch batch;
+	/** Result of the queue execution, then of its callbacks. */
+	int retval;
+	/** Set by the I/O thread once the queue has been executed. */
+	bool executed;
+	/** Set once the callbacks have run and the batch was freed. */
+	bool reaped;
+	/** Nobody waits for this one, report errors via jtag_set_error(). */
+	bool released;
+	struct jtag_future *next;
+};
+
+static struct {
+	/** asynchronous execution requested by the user */
+	bool requested;
+	/** the I/O thread is running */
+	bool enabled;
+	bool quit;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/** submitted futures not reaped yet, oldest first */
+	struct jtag_future *head;
+	struct jtag_future *tail;
+	/** oldest future not executed yet */
+	struct jtag_future *next_to_run;
+} jtag_async;
+
+static bool jtag_async_in_io_thread(void)
+{
+	return jtag_async.enabled && pthread_equal(pthread_self(), jtag_async.thread);
+}
+
+static void *jtag_async_io_thread(void *arg)
+{
+	pthread_mutex_lock(&jtag_async.lock);
+	while (true) {
+		while (!jtag_async.quit && !jtag_async.next_to_run)
+			pthread_cond_wait(&jtag_async.cond, &jtag_async.lock);
+		struct jtag_future *future = jtag_async.next_to_run;
+		if (!future)
+			break;
+		jtag_async.next_to_run = future->next;
+		pthread_mutex_unlock(&jtag_async.lock);
+
+		int retval = jtag->execute_cmd_queue(future->batch.cmd_queue);
+
+		pthread_mutex_lock(&jtag_async.lock);
+		future->retval = retval;
+		future->executed = true;
+		pthread_cond_broadcast(&jtag_async.cond);
+	}
+	pthread_mutex_unlock(&jtag_async.lock);
+
+	return NULL;
+}
+
+static void jtag_async_finish(struct jtag_future *future)
+{
+#ifndef HAVE_JTAG_MINIDRIVER_H
+	if (future->retval == ERROR_OK)
+		future->retval = interface_jtag_callback_queue_run(future->batch.callbacks);
+#endif
+	jtag_command_batch_free(&future->batch);
+	future->reaped = true;
+
+	if (future->released) {
+		jtag_set_error(future->retval);
+		free(future);
+	}
+}
+
+/* Wait for and finish submitted futures in order, up to and including
+ * @a last, or all of them if @a last is NULL. */
+static void jtag_async_reap(struct jtag_future *last)
+{
+	while (jtag_async.head) {
+		struct jtag_future *future = jtag_async.head;
+		bool done = future == last;
+
+		pthread_mutex_lock(&jtag_async.lock);
+		while (!future->executed)
+			pthread_cond_wait(&jtag_async.cond, &jtag_async.lock);
+		jtag_async.head = future->next;
+		if (!jtag_async.head)
+			jtag_async.tail = NULL;
+		pthread_mutex_unlock(&jtag_async.lock);
+
+		jtag_async_finish(future);
+		if (done)
+			break;
+	}
+
+	/* the driver may have logged from the I/O thread */
+	log_flush_deferred();
+}
+
+int jtag_execute_queue_async(struct jtag_future **future)
+{
+	struct jtag_future *f = NULL;
+
+	if (future) {
+		f = calloc(1, sizeof(struct jtag_future));
+		if (!f) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		*future = f;
+	}
+
+	if (!jtag_async.enabled) {
+		if (!f) {
+			/* leave the error for the next jtag_execute_queue() */
+			jtag_execute_queue_noclear();
+			return ERROR_OK;
+		}
+		f->retval = jtag_execute_queue();
+		f->executed = true;
+		f->reaped = true;
+		return ERROR_OK;
+	}
+
+#ifndef HAVE_JTAG_MINIDRIVER_H
+	if (!f) {
+		f = calloc(1, sizeof(struct jtag_future));
+		if (!f) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+		f->released = true;
+	}
+
+	jtag_flush_queue_count++;
+	jtag_command_queue_detach(&f->batch);
+	interface_jtag_callback_queue_detach(&f->batch);
+
+	pthread_mutex_lock(&jtag_async.lock);
+	if (jtag_async.tail)
+		jtag_async.tail->next = f;
+	else
+		jtag_async.head = f;
+	jtag_async.tail = f;
+	if (!jtag_async.next_to_run)
+		jtag_async.next_to_run = f;
+	pthread_cond_broadcast(&jtag_async.cond);
+	pthread_mutex_unlock(&jtag_async.lock);
+#endif
+
+	return ERROR_OK;
+}
+
+int jtag_future_wait(struct jtag_future *future)
+{
+	if (!future->reaped)
+		jtag_async_reap(future);
+
+	int retval = future->retval;
+	free(future);
+	return retval;
+}
+
+bool jtag_future_done(struct jtag_future *future)
+{
+	if (future->reaped)
+		return true;
+
+	pthread_mutex_lock(&jtag_async.lock);
+	bool executed = future->executed;
+	pthread_mutex_unlock(&jtag_async.lock);
+	return executed;
+}
+
+void jtag_future_release(struct jtag_future *future)
+{
+	if (future->reaped) {
+		jtag_set_error(future->retval);
+		free(future);
+	} else
+		future->released = true;
+}
+
+void jtag_async_drain(void)
+{
+	jtag_async_reap(NULL);
+}
+
+static int jtag_async_start(void)
+{
+#ifdef HAVE_JTAG_MINIDRIVER_H
+	LOG_ERROR("asynchronous queue execution is not supported by minidrivers");
+	return ERROR_JTAG_NOT_IMPLEMENTED;
+#else
+	if (jtag_async.enabled)
+		return ERROR_OK;
+
+	if (!jtag->execute_cmd_queue) {
+		LOG_WARNING("adapter driver '%s' does not support asynchronous "
+			"queue execution", jtag->name);
+		return ERROR_JTAG_NOT_IMPLEMENTED;
+	}
+
+	/* the I/O thread takes over from here, nothing may be left behind */
+	int retval = jtag_execute_queue();
+	if (retval != ERROR_OK)
+		return retval;
+
+	pthread_mutex_init(&jtag_async.lock, NULL);
+	pthread_cond_init(&jtag_async.cond, NULL);
+	jtag_async.quit = false;
+	jtag_async.enabled = true;
+	retval = pthread_create(&jtag_async.thread, NULL, jtag_async_io_thread, NULL);
+	if (retval) {
+		LOG_ERROR("Failed to start adapter I/O thread (%d)!", retval);
+		jtag_async.enabled = false;
+		pthread_cond_destroy(&jtag_async.cond);
+		pthread_mutex_destroy(&jtag_async.lock);
+		return ERROR_FAIL;
+	}
+
+	LOG_DEBUG("adapter I/O thread started");
+	return ERROR_OK;
+#endif
+}
+
+static void jtag_async_stop(void)
+{
+	if (!jtag_async.enabled)
+		return;
+
+	jtag_async_drain();
+
+	pthread_mutex_lock(&jtag_async.lock);
+	jtag_async.quit = true;
+	pthread_cond_broadcast(&jtag_async.cond);
+	pthread_mutex_unlock(&jtag_async.lock);
+
+	pthread_join(jtag_async.thread, NULL);
+	/* clear the flag only now, jtag_sleep() looks at it on the I/O thread */
+	jtag_async.enabled = false;
+	pthread_cond_destroy(&jtag_async.cond);
+	pthread_mutex_destroy(&jtag_async.lock);
+
+	LOG_DEBUG("adapter I/O thread stopped");
+}
+
+int jtag_config_async(bool enable)
+{
+	jtag_async.requested = enable;
+
+	/* this command can be called during CONFIG,
+	 * in which case adapter_init() starts the thread */
+	if (!jtag)
+		return ERROR_OK;
+
+	if (!enable) {
+		jtag_async_stop();
+		return ERROR_OK;
+	}
+	return jtag_async_start();
+}
+
+bool jtag_async_enabled(void)
+{
+	return jtag_async.enabled;
+}
+
 static int jtag_reset_callback(enum jtag_event event, void *priv)
 {
 	struct jtag_tap *tap = priv;
@@ -953,7 +1240,8 @@ static int jtag_reset_callback(enum jtag_event event, void *priv)
  */
 void jtag_sleep(uint32_t us)
 {
-	if (us < 1000)
+	/* keep_alive() must not be called from the adapter I/O thread */
+	if (us < 1000 || jtag_async_in_io_thread())
 		usleep(us);
 	else
 		alive_sleep((us+999)/1000);
@@ -1417,6 +1705,9 @@ int adapter_init(struct command_context *cmd_ctx)
 		return retval;
 	jtag = jtag_interface;
 
+	if (jtag_async.requested)
+		jtag_async_start();
+
 	if (jtag->speed == NULL) {
 		LOG_INFO("This adapter doesn't support configurable speed");
 		return ERROR_OK;
@@ -1536,6 +1827,8 @@ int jtag_init_inner(struct command_context *cmd_ctx)
 
 int adapter_quit(void)
 {
+	jtag_async_stop();
+
 	if (jtag && jtag->quit) {
 		/* close the JTAG interface */
 		int result = jtag->quit();
@@ -1697,7 +1990,10 @@ static int jtag_set_speed(int speed)
 	jtag_speed = speed;
 	/* this command can be called during CONFIG,
 	 * in which case jtag isn't initialized */
-	return jtag ? jtag->speed(speed) : ERROR_OK;
+	if (!jtag)
+		return ERROR_OK;
+	jtag_async_drain();
+	return jtag->speed(speed);
 }
 
 int jtag_config_khz(unsigned khz)
@@ -1778,6 +2074,7 @@ int jtag_power_dropout(int *dropout)
 		LOG_ERROR("No Valid JTAG Interface Configured.");
 		exit(-1);
 	}
+	jtag_async_drain();
 	if (jtag->power_dropout)
 		return jtag->power_dropout(dropout);
 
@@ -1787,6 +2084,7 @@ int jtag_power_dropout(int *dropout)
 
 int jtag_srst_asserted(int *srst_asserted)
 {
+	jtag_async_drain();
 	if (jtag->srst_asserted)
 		return jtag->srst_asserted(srst_asserted);
 
@@ -1920,6 +2218,7 @@ void adapter_deassert_reset(void)
 int adapter_config_trace(bool enabled, enum tpiu_pin_protocol pin_protocol,
 			 uint32_t port_size, unsigned int *trace_freq)
 {
+	jtag_async_drain();
 	if (jtag->config_trace)
 		return jtag->config_trace(enabled, pin_protocol, port_size,
 					  trace_freq);
@@ -1933,6 +2232,7 @@ int adapter_config_trace(bool enabled, enum tpiu_pin_protocol pin_protocol,
 
 int adapter_poll_trace(uint8_t *buf, size_t *size)
 {
+	jtag_async_drain();
 	if (jtag->poll_trace)
 		return jtag->poll_trace(buf, size);
 
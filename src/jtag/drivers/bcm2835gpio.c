@@ -51,6 +51,8 @@ static volatile uint32_t *pio_base;
 
 static bb_value_t bcm2835gpio_read(void);
 static int bcm2835gpio_write(int tck, int tms, int tdi);
+static int bcm2835gpio_scan_bits(const uint8_t *tms_buf, const uint8_t *tdi_buf,
+		uint8_t *tdo_buf, unsigned int n);
 static int bcm2835gpio_reset(int trst, int srst);
 
 static int bcm2835_swdio_read(void);
@@ -62,6 +64,7 @@ static int bcm2835gpio_quit(void);
 static struct bitbang_interface bcm2835gpio_bitbang = {
 	.read = bcm2835gpio_read,
 	.write = bcm2835gpio_write,
+	.scan_bits = bcm2835gpio_scan_bits,
 	.reset = bcm2835gpio_reset,
 	.swdio_read = bcm2835_swdio_read,
 	.swdio_drive = bcm2835_swdio_drive,
@@ -110,6 +113,38 @@ static int bcm2835gpio_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+/* Same timing as write()/read() per cycle, without a call per edge. */
+static int bcm2835gpio_scan_bits(const uint8_t *tms_buf, const uint8_t *tdi_buf,
+		uint8_t *tdo_buf, unsigned int n)
+{
+	for (unsigned int bit = 0; bit < n; bit++) {
+		uint8_t mask = 1 << (bit % 8);
+		uint32_t tms = tms_buf && (tms_buf[bit / 8] & mask);
+		uint32_t tdi = tdi_buf && (tdi_buf[bit / 8] & mask);
+
+		GPIO_SET = tms<<tms_gpio | tdi<<tdi_gpio;
+		GPIO_CLR = 1<<tck_gpio | !tms<<tms_gpio | !tdi<<tdi_gpio;
+
+		for (unsigned int i = 0; i < jtag_delay; i++)
+			asm volatile ("");
+
+		if (tdo_buf) {
+			if (GPIO_LEV & 1<<tdo_gpio)
+				tdo_buf[bit / 8] |= mask;
+			else
+				tdo_buf[bit / 8] &= ~mask;
+		}
+
+		GPIO_SET = 1<<tck_gpio;
+
+		for (unsigned int i = 0; i < jtag_delay; i++)
+			asm volatile ("");
+	}
+	GPIO_CLR = 1<<tck_gpio;
+
+	return ERROR_OK;
+}
+
 static int bcm2835gpio_swd_write(int tck, int tms, int tdi)
 {
 	uint32_t set = tck<<swclk_gpio | tdi<<swdio_gpio;
@@ -526,6 +561,7 @@ static int bcm2835gpio_init(void)
 
 	if (swd_mode) {
 		bcm2835gpio_bitbang.write = bcm2835gpio_swd_write;
+		bcm2835gpio_bitbang.scan_bits = NULL;
 		bitbang_switch_to_swd();
 	}
 
@@ -77,6 +77,15 @@ static int bitbang_state_move(int skip)
 	uint8_t tms_scan = tap_get_tms_path(tap_get_state(), tap_get_end_state());
 	int tms_count = tap_get_tms_path_len(tap_get_state(), tap_get_end_state());
 
+	if (bitbang_interface->scan_bits) {
+		tms_scan >>= skip;
+		if (tms_count > skip &&
+				bitbang_interface->scan_bits(&tms_scan, NULL, NULL, tms_count - skip) != ERROR_OK)
+			return ERROR_FAIL;
+		tap_set_state(tap_get_end_state());
+		return ERROR_OK;
+	}
+
 	for (i = skip; i < tms_count; i++) {
 		tms = (tms_scan >> i) & 1;
 		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
@@ -166,14 +175,20 @@ static int bitbang_runtest(int num_cycles)
 	}
 
 	/* execute num_cycles */
-	for (i = 0; i < num_cycles; i++) {
-		if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
+	if (bitbang_interface->scan_bits) {
+		if (num_cycles > 0 &&
+				bitbang_interface->scan_bits(NULL, NULL, NULL, num_cycles) != ERROR_OK)
 			return ERROR_FAIL;
-		if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
+	} else {
+		for (i = 0; i < num_cycles; i++) {
+			if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
+				return ERROR_FAIL;
+			if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+		if (bitbang_interface->write(CLOCK_IDLE(), 0, 0) != ERROR_OK)
 			return ERROR_FAIL;
 	}
-	if (bitbang_interface->write(CLOCK_IDLE(), 0, 0) != ERROR_OK)
-		return ERROR_FAIL;
 
 	/* finish in end_state */
 	bitbang_end_state(saved_end_state);
@@ -219,62 +234,77 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		bitbang_end_state(saved_end_state);
 	}
 
-	size_t buffered = 0;
-	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
-		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
-		int tdi;
-		int bytec = bit_cnt/8;
-		int bcval = 1 << (bit_cnt % 8);
-
-		/* if we're just reading the scan, but don't care about the output
-		 * default to outputting 'low', this also makes valgrind traces more readable,
-		 * as it removes the dependency on an uninitialised value
-		 */
-		tdi = 0;
-		if ((type != SCAN_IN) && (buffer[bytec] & bcval))
-			tdi = 1;
-
-		if (bitbang_interface->write(0, tms, tdi) != ERROR_OK)
+	if (bitbang_interface->scan_bits) {
+		/* TMS stays low until the last bit, which leaves the shift state */
+		uint8_t *tms_buf = calloc(DIV_ROUND_UP(scan_size, 8), 1);
+		if (!tms_buf)
 			return ERROR_FAIL;
-
-		if (type != SCAN_OUT) {
-			if (bitbang_interface->buf_size) {
-				if (bitbang_interface->sample() != ERROR_OK)
-					return ERROR_FAIL;
-				buffered++;
-			} else {
-				switch (bitbang_interface->read()) {
-					case BB_LOW:
-						buffer[bytec] &= ~bcval;
-						break;
-					case BB_HIGH:
-						buffer[bytec] |= bcval;
-						break;
-					default:
+		tms_buf[(scan_size - 1) / 8] |= 1 << ((scan_size - 1) % 8);
+		int retval = bitbang_interface->scan_bits(tms_buf,
+				type != SCAN_IN ? buffer : NULL,
+				type != SCAN_OUT ? buffer : NULL,
+				scan_size);
+		free(tms_buf);
+		if (retval != ERROR_OK)
+			return ERROR_FAIL;
+	} else {
+		size_t buffered = 0;
+		for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
+			int tms = (bit_cnt == scan_size-1) ? 1 : 0;
+			int tdi;
+			int bytec = bit_cnt/8;
+			int bcval = 1 << (bit_cnt % 8);
+
+			/* if we're just reading the scan, but don't care about the output
+			 * default to outputting 'low', this also makes valgrind traces more readable,
+			 * as it removes the dependency on an uninitialised value
+			 */
+			tdi = 0;
+			if ((type != SCAN_IN) && (buffer[bytec] & bcval))
+				tdi = 1;
+
+			if (bitbang_interface->write(0, tms, tdi) != ERROR_OK)
+				return ERROR_FAIL;
+
+			if (type != SCAN_OUT) {
+				if (bitbang_interface->buf_size) {
+					if (bitbang_interface->sample() != ERROR_OK)
 						return ERROR_FAIL;
+					buffered++;
+				} else {
+					switch (bitbang_interface->read()) {
+						case BB_LOW:
+							buffer[bytec] &= ~bcval;
+							break;
+						case BB_HIGH:
+							buffer[bytec] |= bcval;
+							break;
+						default:
+							return ERROR_FAIL;
+					}
 				}
 			}
-		}
-
-		if (bitbang_interface->write(1, tms, tdi) != ERROR_OK)
-			return ERROR_FAIL;
 
-		if (type != SCAN_OUT && bitbang_interface->buf_size &&
-				(buffered == bitbang_interface->buf_size ||
-				 bit_cnt == scan_size - 1)) {
-			for (unsigned i = bit_cnt + 1 - buffered; i <= bit_cnt; i++) {
-				switch (bitbang_interface->read_sample()) {
-					case BB_LOW:
-						buffer[i/8] &= ~(1 << (i % 8));
-						break;
-					case BB_HIGH:
-						buffer[i/8] |= 1 << (i % 8);
-						break;
-					default:
-						return ERROR_FAIL;
+			if (bitbang_interface->write(1, tms, tdi) != ERROR_OK)
+				return ERROR_FAIL;
+
+			if (type != SCAN_OUT && bitbang_interface->buf_size &&
+					(buffered == bitbang_interface->buf_size ||
+					 bit_cnt == scan_size - 1)) {
+				for (unsigned i = bit_cnt + 1 - buffered; i <= bit_cnt; i++) {
+					switch (bitbang_interface->read_sample()) {
+						case BB_LOW:
+							buffer[i/8] &= ~(1 << (i % 8));
+							break;
+						case BB_HIGH:
+							buffer[i/8] |= 1 << (i % 8);
+							break;
+						default:
+							return ERROR_FAIL;
+					}
 				}
+				buffered = 0;
 			}
-			buffered = 0;
 		}
 	}
 
@@ -291,7 +321,12 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 
 int bitbang_execute_queue(void)
 {
-	struct jtag_command *cmd = jtag_command_queue;	/* currently processed command */
+	return bitbang_execute_cmd_queue(jtag_command_queue);
+}
+
+int bitbang_execute_cmd_queue(struct jtag_command *cmd_queue)
+{
+	struct jtag_command *cmd = cmd_queue;	/* currently processed command */
 	int scan_size;
 	enum scan_type type;
 	uint8_t *buffer;
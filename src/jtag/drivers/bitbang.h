@@ -24,6 +24,8 @@
 
 #include <jtag/swd.h>
 
+struct jtag_command;
+
 typedef enum {
 	BB_LOW,
 	BB_HIGH,
@@ -51,6 +53,17 @@ struct bitbang_interface {
 
 	/** Set TCK, TMS, and TDI to the given values. */
 	int (*write)(int tck, int tms, int tdi);
+
+	/** Clock n TCK cycles in one go. Optional; when missing, every cycle goes
+	 * through write() and read()/sample().
+	 *
+	 * For cycle i, TMS and TDI are set from bit i of tms_buf and tdi_buf
+	 * while TCK is low, TDO is sampled into bit i of tdo_buf, then TCK goes
+	 * high. TCK is left low after the last cycle. A NULL tms_buf or tdi_buf
+	 * means all zeroes, a NULL tdo_buf means TDO is not needed. tdo_buf may
+	 * be the same buffer as tdi_buf. */
+	int (*scan_bits)(const uint8_t *tms_buf, const uint8_t *tdi_buf,
+			uint8_t *tdo_buf, unsigned int n);
 	int (*reset)(int trst, int srst);
 	int (*blink)(int on);
 	int (*swdio_read)(void);
@@ -62,6 +75,7 @@ const struct swd_driver bitbang_swd;
 extern bool swd_mode;
 
 int bitbang_execute_queue(void);
+int bitbang_execute_cmd_queue(struct jtag_command *cmd_queue);
 
 extern struct bitbang_interface *bitbang_interface;
 void bitbang_switch_to_swd(void);
@@ -37,6 +37,7 @@
 #include <jtag/interface.h>
 #include <jtag/commands.h>
 #include <jtag/tcl.h>
+#include <helper/time_support.h>
 
 #include <hidapi.h>
 
@@ -181,6 +182,11 @@ struct pending_transfer_result {
 struct pending_request_block {
 	struct pending_transfer_result *transfers;
 	int transfer_count;
+	int write_count;
+	/* all transfers access the same register, DAP_TransferBlock can be used */
+	bool same_reg;
+	/* CMD_DAP_TFER or CMD_DAP_TFER_BLOCK, as sent */
+	uint8_t command;
 };
 
 struct pending_scan_result {
@@ -196,11 +202,20 @@ struct pending_scan_result {
 
 /* Up to MIN(packet_count, MAX_PENDING_REQUESTS) requests may be issued
  * until the first response arrives */
-#define MAX_PENDING_REQUESTS 3
+#define MAX_PENDING_REQUESTS 8
 
 /* Pending requests are organized as a FIFO - circular buffer */
-/* Each block in FIFO can contain up to pending_queue_len transfers */
+/* Each block in FIFO can contain up to pending_queue_len transfers,
+ * fewer if the request or the response would not fit in a packet */
 static int pending_queue_len;
+
+/* Transfer statistics, reset by "cmsis-dap read_speed" */
+static struct {
+	unsigned int packets;
+	unsigned int block_packets;
+	unsigned int transfers;
+	int max_in_flight;
+} pending_stats;
 static struct pending_request_block pending_fifo[MAX_PENDING_REQUESTS];
 static int pending_fifo_put_idx, pending_fifo_get_idx;
 static int pending_fifo_block_count;
@@ -644,11 +659,21 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 	if (block->transfer_count == 0)
 		goto skip;
 
+	/* DAP_TransferBlock sends the register once and only data for
+	 * each transfer, e.g. for MEM-AP DRW runs of mem_ap_read/write */
+	bool use_block = block->same_reg && block->transfer_count > 1;
+	block->command = use_block ? CMD_DAP_TFER_BLOCK : CMD_DAP_TFER;
+
 	size_t idx = 0;
 	buffer[idx++] = 0;	/* report number */
-	buffer[idx++] = CMD_DAP_TFER;
+	buffer[idx++] = block->command;
 	buffer[idx++] = 0x00;	/* DAP Index */
-	buffer[idx++] = block->transfer_count;
+	if (use_block) {
+		h_u16_to_le(&buffer[idx], block->transfer_count);
+		idx += 2;
+		buffer[idx++] = (block->transfers[0].cmd >> 1) & 0x0f;
+	} else
+		buffer[idx++] = block->transfer_count;
 
 	for (int i = 0; i < block->transfer_count; i++) {
 		struct pending_transfer_result *transfer = &(block->transfers[i]);
@@ -679,7 +704,8 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 			data &= ~CORUNDETECT;
 		}
 
-		buffer[idx++] = (cmd >> 1) & 0x0f;
+		if (!use_block)
+			buffer[idx++] = (cmd >> 1) & 0x0f;
 		if (!(cmd & SWD_CMD_RnW)) {
 			buffer[idx++] = (data) & 0xff;
 			buffer[idx++] = (data >> 8) & 0xff;
@@ -697,10 +723,18 @@ static void cmsis_dap_swd_write_from_queue(struct cmsis_dap *dap)
 	if (pending_fifo_block_count > dap->packet_count)
 		LOG_ERROR("too much pending writes %d", pending_fifo_block_count);
 
+	pending_stats.packets++;
+	if (use_block)
+		pending_stats.block_packets++;
+	pending_stats.transfers += block->transfer_count;
+	if (pending_fifo_block_count > pending_stats.max_in_flight)
+		pending_stats.max_in_flight = pending_fifo_block_count;
+
 	return;
 
 skip:
 	block->transfer_count = 0;
+	block->write_count = 0;
 }
 
 static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
@@ -722,26 +756,37 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
 		goto skip;
 	}
 
-	if (buffer[2] & 0x08) {
-		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", buffer[1]);
+	/* DAP_TransferBlock responds with a 16 bit transfer count */
+	int transfer_count;
+	size_t idx;
+	if (block->command == CMD_DAP_TFER_BLOCK) {
+		transfer_count = le_to_h_u16(&buffer[1]);
+		idx = 3;
+	} else {
+		transfer_count = buffer[1];
+		idx = 2;
+	}
+	uint8_t response = buffer[idx++];
+
+	if (response & 0x08) {
+		LOG_DEBUG("CMSIS-DAP Protocol Error @ %d (wrong parity)", transfer_count);
 		queued_retval = ERROR_FAIL;
 		goto skip;
 	}
-	uint8_t ack = buffer[2] & 0x07;
+	uint8_t ack = response & 0x07;
 	if (ack != SWD_ACK_OK) {
-		LOG_DEBUG("SWD ack not OK @ %d %s", buffer[1],
+		LOG_DEBUG("SWD ack not OK @ %d %s", transfer_count,
 			  ack == SWD_ACK_WAIT ? "WAIT" : ack == SWD_ACK_FAULT ? "FAULT" : "JUNK");
 		queued_retval = ack == SWD_ACK_WAIT ? ERROR_WAIT : ERROR_FAIL;
 		goto skip;
 	}
 
-	if (block->transfer_count != buffer[1])
+	if (block->transfer_count != transfer_count)
 		LOG_ERROR("CMSIS-DAP transfer count mismatch: expected %d, got %d",
-			  block->transfer_count, buffer[1]);
+			  block->transfer_count, transfer_count);
 
-	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %d", buffer[1], pending_fifo_get_idx);
-	size_t idx = 3;
-	for (int i = 0; i < buffer[1]; i++) {
+	LOG_DEBUG_IO("Received results of %d queued transactions FIFO index %d", transfer_count, pending_fifo_get_idx);
+	for (int i = 0; i < transfer_count; i++) {
 		struct pending_transfer_result *transfer = &(block->transfers[i]);
 		if (transfer->cmd & SWD_CMD_RnW) {
 			static uint32_t last_read;
@@ -765,6 +810,7 @@ static void cmsis_dap_swd_read_process(struct cmsis_dap *dap, int timeout_ms)
 
 skip:
 	block->transfer_count = 0;
+	block->write_count = 0;
 	pending_fifo_get_idx = (pending_fifo_get_idx + 1) % dap->packet_count;
 	pending_fifo_block_count--;
 }
@@ -788,9 +834,31 @@ static int cmsis_dap_swd_run_queue(void)
 	return retval;
 }
 
+/* Can one more transfer go into the block without overflowing
+ * the request or the response packet? */
+static bool cmsis_dap_swd_block_fits(struct pending_request_block *block, uint8_t cmd)
+{
+	int pkt_sz = cmsis_dap_handle->packet_size - 1;
+	int transfers = block->transfer_count + 1;
+	int writes = block->write_count + ((cmd & SWD_CMD_RnW) ? 0 : 1);
+	int reads = transfers - writes;
+
+	if (transfers > pending_queue_len)
+		return false;
+
+	/* DAP_Transfer: one request byte per transfer, data for writes */
+	if (transfers <= 255 && 4 + transfers + 4 * writes <= pkt_sz && 3 + 4 * reads <= pkt_sz)
+		return true;
+
+	/* DAP_TransferBlock: data only, but a single register */
+	bool same_reg = block->transfer_count == 0 ||
+		(block->same_reg && block->transfers[0].cmd == cmd);
+	return same_reg && 5 + 4 * writes <= pkt_sz && 4 + 4 * reads <= pkt_sz;
+}
+
 static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 {
-	if (pending_fifo[pending_fifo_put_idx].transfer_count == pending_queue_len) {
+	if (!cmsis_dap_swd_block_fits(&pending_fifo[pending_fifo_put_idx], cmd)) {
 		if (pending_fifo_block_count)
 			cmsis_dap_swd_read_process(cmsis_dap_handle, 0);
 
@@ -811,7 +879,10 @@ static void cmsis_dap_swd_queue_cmd(uint8_t cmd, uint32_t *dst, uint32_t data)
 	if (cmd & SWD_CMD_RnW) {
 		/* Queue a read transaction */
 		transfer->buffer = dst;
-	}
+	} else
+		block->write_count++;
+	block->same_reg = block->transfer_count == 0 ||
+		(block->same_reg && block->transfers[0].cmd == cmd);
 	block->transfer_count++;
 }
 
@@ -1020,10 +1091,11 @@ static int cmsis_dap_init(void)
 	if (data[0] == 2) {  /* short */
 		uint16_t pkt_sz = data[1] + (data[2] << 8);
 
-		/* 4 bytes of command header + 5 bytes per register
-		 * write. For bulk read sequences just 4 bytes are
-		 * needed per transfer, so this is suboptimal. */
-		pending_queue_len = (pkt_sz - 4) / 5;
+		/* Reads need 1 request and 4 response bytes, writes 5
+		 * request bytes, DAP_TransferBlock writes just 4. Size the
+		 * blocks for the densest case, cmsis_dap_swd_block_fits()
+		 * checks the real limits. */
+		pending_queue_len = (pkt_sz - 3) / 4;
 
 		if (cmsis_dap_handle->packet_size != pkt_sz + 1) {
 			/* reallocate buffer */
@@ -1736,6 +1808,47 @@ COMMAND_HANDLER(cmsis_dap_handle_serial_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(cmsis_dap_handle_read_speed_command)
+{
+	uint32_t count = 4096;
+	uint32_t value;
+	struct duration bench;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(u32, CMD_ARGV[0], count);
+	if (count == 0)
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+
+	if (!swd_mode) {
+		command_print(CMD, "read_speed needs the SWD transport");
+		return ERROR_FAIL;
+	}
+
+	/* DPIDR reads have no side effects and are answered directly by the
+	 * DP, so this measures the probe and the SWD link alone */
+	memset(&pending_stats, 0, sizeof(pending_stats));
+	duration_start(&bench);
+	for (uint32_t i = 0; i < count; i++)
+		cmsis_dap_swd_read_reg(swd_cmd(true, false, DP_DPIDR), &value, 0);
+	int retval = cmsis_dap_swd_run_queue();
+	if (retval != ERROR_OK)
+		return retval;
+	duration_measure(&bench);
+
+	command_print(CMD, "%" PRIu32 " DP reads in %fs (%0.3f KiB/s of data)",
+		count, duration_elapsed(&bench),
+		duration_kbps(&bench, (uint64_t)count * 4));
+	command_print(CMD, "%u packets (%u DAP_TransferBlock), %0.1f transfers per packet, "
+		"up to %d of %d packets in flight",
+		pending_stats.packets, pending_stats.block_packets,
+		pending_stats.packets ? (double)pending_stats.transfers / pending_stats.packets : 0.0,
+		pending_stats.max_in_flight, cmsis_dap_handle->packet_count);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 	{
 		.name = "info",
@@ -1751,6 +1864,13 @@ static const struct command_registration cmsis_dap_subcommand_handlers[] = {
 		.usage = "",
 		.help = "issue cmsis-dap command",
 	},
+	{
+		.name = "read_speed",
+		.handler = &cmsis_dap_handle_read_speed_command,
+		.mode = COMMAND_EXEC,
+		.usage = "[count]",
+		.help = "measure raw SWD read throughput with DP register reads",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -359,6 +359,23 @@ void interface_jtag_add_callback4(jtag_callback_t callback,
 	}
 }
 
+void interface_jtag_callback_queue_detach(struct jtag_command_batch *batch)
+{
+	batch->callbacks = jtag_callback_queue_head;
+	jtag_callback_queue_reset();
+}
+
+int interface_jtag_callback_queue_run(struct jtag_callback_entry *callbacks)
+{
+	struct jtag_callback_entry *entry;
+	for (entry = callbacks; entry != NULL; entry = entry->next) {
+		int retval = entry->callback(entry->data0, entry->data1, entry->data2, entry->data3);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	return ERROR_OK;
+}
+
 int interface_jtag_execute_queue(void)
 {
 	static int reentry;
@@ -367,14 +384,8 @@ int interface_jtag_execute_queue(void)
 	reentry++;
 
 	int retval = default_interface_jtag_execute_queue();
-	if (retval == ERROR_OK) {
-		struct jtag_callback_entry *entry;
-		for (entry = jtag_callback_queue_head; entry != NULL; entry = entry->next) {
-			retval = entry->callback(entry->data0, entry->data1, entry->data2, entry->data3);
-			if (retval != ERROR_OK)
-				break;
-		}
-	}
+	if (retval == ERROR_OK)
+		retval = interface_jtag_callback_queue_run(jtag_callback_queue_head);
 
 	jtag_command_queue_reset();
 	jtag_callback_queue_reset();
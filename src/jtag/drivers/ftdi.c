@@ -627,14 +627,14 @@ static void ftdi_execute_command(struct jtag_command *cmd)
 	}
 }
 
-static int ftdi_execute_queue(void)
+static int ftdi_execute_cmd_queue(struct jtag_command *cmd_queue)
 {
 	/* blink, if the current layout has that feature */
 	struct signal *led = find_signal_by_name("LED");
 	if (led)
 		ftdi_set_signal(led, '1');
 
-	for (struct jtag_command *cmd = jtag_command_queue; cmd; cmd = cmd->next) {
+	for (struct jtag_command *cmd = cmd_queue; cmd; cmd = cmd->next) {
 		/* fill the write buffer with the desired command */
 		ftdi_execute_command(cmd);
 	}
@@ -649,6 +649,11 @@ static int ftdi_execute_queue(void)
 	return retval;
 }
 
+static int ftdi_execute_queue(void)
+{
+	return ftdi_execute_cmd_queue(jtag_command_queue);
+}
+
 static int ftdi_initialize(void)
 {
 	if (tap_get_tms_path_len(TAP_IRPAUSE, TAP_IRPAUSE) == 7)
@@ -1255,4 +1260,5 @@ struct jtag_interface ftdi_interface = {
 	.speed_div = ftdi_speed_div,
 	.khz = ftdi_khz,
 	.execute_queue = ftdi_execute_queue,
+	.execute_cmd_queue = ftdi_execute_cmd_queue,
 };
@@ -84,6 +84,8 @@ static inline bool gpio_level(int g)
 
 static bb_value_t imx_gpio_read(void);
 static int imx_gpio_write(int tck, int tms, int tdi);
+static int imx_gpio_scan_bits(const uint8_t *tms_buf, const uint8_t *tdi_buf,
+		uint8_t *tdo_buf, unsigned int n);
 static int imx_gpio_reset(int trst, int srst);
 
 static int imx_gpio_swdio_read(void);
@@ -95,6 +97,7 @@ static int imx_gpio_quit(void);
 static struct bitbang_interface imx_gpio_bitbang = {
 	.read = imx_gpio_read,
 	.write = imx_gpio_write,
+	.scan_bits = imx_gpio_scan_bits,
 	.reset = imx_gpio_reset,
 	.swdio_read = imx_gpio_swdio_read,
 	.swdio_drive = imx_gpio_swdio_drive,
@@ -145,6 +148,45 @@ static int imx_gpio_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+/* Only touch TMS and TDI when they change, and TCK on each edge. */
+static int imx_gpio_scan_bits(const uint8_t *tms_buf, const uint8_t *tdi_buf,
+		uint8_t *tdo_buf, unsigned int n)
+{
+	int last_tms = -1, last_tdi = -1;
+
+	for (unsigned int bit = 0; bit < n; bit++) {
+		uint8_t mask = 1 << (bit % 8);
+		int tms = tms_buf && (tms_buf[bit / 8] & mask);
+		int tdi = tdi_buf && (tdi_buf[bit / 8] & mask);
+
+		if (tms != last_tms)
+			tms ? gpio_set(tms_gpio) : gpio_clear(tms_gpio);
+		if (tdi != last_tdi)
+			tdi ? gpio_set(tdi_gpio) : gpio_clear(tdi_gpio);
+		last_tms = tms;
+		last_tdi = tdi;
+		gpio_clear(tck_gpio);
+
+		for (unsigned int i = 0; i < jtag_delay; i++)
+			asm volatile ("");
+
+		if (tdo_buf) {
+			if (gpio_level(tdo_gpio))
+				tdo_buf[bit / 8] |= mask;
+			else
+				tdo_buf[bit / 8] &= ~mask;
+		}
+
+		gpio_set(tck_gpio);
+
+		for (unsigned int i = 0; i < jtag_delay; i++)
+			asm volatile ("");
+	}
+	gpio_clear(tck_gpio);
+
+	return ERROR_OK;
+}
+
 static int imx_gpio_swd_write(int tck, int tms, int tdi)
 {
 	tdi ? gpio_set(swdio_gpio) : gpio_clear(swdio_gpio);
@@ -547,6 +589,7 @@ static int imx_gpio_init(void)
 
 	if (swd_mode) {
 		imx_gpio_bitbang.write = imx_gpio_swd_write;
+		imx_gpio_bitbang.scan_bits = NULL;
 		bitbang_switch_to_swd();
 	}
 
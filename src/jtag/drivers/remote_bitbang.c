@@ -30,17 +30,48 @@
 /* arbitrary limit on host name length: */
 #define REMOTE_BITBANG_HOST_MAX 255
 
+/* Number of TDO samples bitbang_scan() may request before it reads them back.
+ * The replies to that many samples always fit into the socket buffers, so the
+ * remote end never blocks on its output while we are still sending. */
+#define REMOTE_BITBANG_SAMPLES_MAX 4096
+
+/* Longest packed clock command, limited by its 16 bit cycle count. */
+#define REMOTE_BITBANG_PACKET_CYCLES_MAX 0xFFFF
+
 static char *remote_bitbang_host;
 static char *remote_bitbang_port;
 
-static FILE *remote_bitbang_file;
 static int remote_bitbang_fd;
 
 /* Circular buffer. When start == end, the buffer is empty. */
-static char remote_bitbang_buf[64];
+static char remote_bitbang_buf[REMOTE_BITBANG_SAMPLES_MAX + 1];
 static unsigned remote_bitbang_start;
 static unsigned remote_bitbang_end;
 
+/* Outgoing commands, sent in one write() when full or when a reply is needed. */
+static char remote_bitbang_send_buf[16384];
+static unsigned remote_bitbang_send_len;
+
+/* Packed binary mode, requested by the user and accepted by the remote end. */
+static bool remote_bitbang_binary_requested;
+static bool remote_bitbang_binary;
+
+/* Packed clock command being assembled in remote_bitbang_send_buf. */
+static unsigned remote_bitbang_pkt_start;
+static unsigned remote_bitbang_pkt_cycles;
+static bool remote_bitbang_pkt_capture;
+static bool remote_bitbang_sample_pending;
+static int remote_bitbang_last_tck;
+
+/* Cycle counts of the packed TDO replies not read yet, oldest first. */
+static uint16_t remote_bitbang_replies[REMOTE_BITBANG_SAMPLES_MAX + 1];
+static unsigned remote_bitbang_replies_start;
+static unsigned remote_bitbang_replies_end;
+/* Reply currently being unpacked. */
+static unsigned remote_bitbang_reply_bits;
+static uint8_t remote_bitbang_reply_byte;
+static unsigned remote_bitbang_reply_byte_bits;
+
 static int remote_bitbang_buf_full(void)
 {
 	return remote_bitbang_end ==
@@ -48,10 +79,14 @@ static int remote_bitbang_buf_full(void)
 		 sizeof(remote_bitbang_buf));
 }
 
-/* Read any incoming data, placing it into the buffer. */
-static int remote_bitbang_fill_buf(void)
+/* Read any incoming data, placing it into the buffer. If block is set, wait
+ * until at least one byte has arrived. */
+static int remote_bitbang_fill_buf(bool block)
 {
-	socket_nonblock(remote_bitbang_fd);
+	if (block)
+		socket_block(remote_bitbang_fd);
+	else
+		socket_nonblock(remote_bitbang_fd);
 	while (!remote_bitbang_buf_full()) {
 		unsigned contiguous_available_space;
 		if (remote_bitbang_end >= remote_bitbang_start) {
@@ -70,7 +105,16 @@ static int remote_bitbang_fill_buf(void)
 			remote_bitbang_end += count;
 			if (remote_bitbang_end == sizeof(remote_bitbang_buf))
 				remote_bitbang_end = 0;
+			if (block) {
+				/* pick up whatever else has arrived, but don't wait for it */
+				block = false;
+				socket_nonblock(remote_bitbang_fd);
+			}
 		} else if (count == 0) {
+			if (block) {
+				LOG_ERROR("remote_bitbang_fill_buf: remote end closed the connection");
+				return ERROR_FAIL;
+			}
 			return ERROR_OK;
 		} else if (count < 0) {
 			if (errno == EAGAIN) {
@@ -86,31 +130,95 @@ static int remote_bitbang_fill_buf(void)
 	return ERROR_OK;
 }
 
+/* Finish the packed clock command being assembled, if any. */
+static void remote_bitbang_close_packet(void)
+{
+	if (!remote_bitbang_pkt_cycles)
+		return;
+
+	remote_bitbang_send_buf[remote_bitbang_pkt_start + 1] = remote_bitbang_pkt_cycles & 0xff;
+	remote_bitbang_send_buf[remote_bitbang_pkt_start + 2] = remote_bitbang_pkt_cycles >> 8;
+	if (remote_bitbang_pkt_capture) {
+		remote_bitbang_replies[remote_bitbang_replies_end] = remote_bitbang_pkt_cycles;
+		remote_bitbang_replies_end =
+			(remote_bitbang_replies_end + 1) % ARRAY_SIZE(remote_bitbang_replies);
+	}
+	remote_bitbang_pkt_cycles = 0;
+}
+
+static int remote_bitbang_flush(void)
+{
+	unsigned offset = 0;
+
+	remote_bitbang_close_packet();
+	socket_block(remote_bitbang_fd);
+	while (offset < remote_bitbang_send_len) {
+		ssize_t written = write(remote_bitbang_fd, remote_bitbang_send_buf + offset,
+				remote_bitbang_send_len - offset);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			LOG_ERROR("remote_bitbang_flush: %s (%d)", strerror(errno), errno);
+			remote_bitbang_send_len = 0;
+			return ERROR_FAIL;
+		}
+		offset += written;
+	}
+	remote_bitbang_send_len = 0;
+	return ERROR_OK;
+}
+
 static int remote_bitbang_putc(int c)
 {
-	if (EOF == fputc(c, remote_bitbang_file)) {
-		LOG_ERROR("remote_bitbang_putc: %s", strerror(errno));
+	remote_bitbang_close_packet();
+	if (remote_bitbang_send_len == sizeof(remote_bitbang_send_buf) &&
+			remote_bitbang_flush() != ERROR_OK)
 		return ERROR_FAIL;
+	remote_bitbang_send_buf[remote_bitbang_send_len++] = c;
+	return ERROR_OK;
+}
+
+/* Append one TCK cycle to the packed clock command, starting a new one when
+ * the capture mode changes or there is no room left. */
+static int remote_bitbang_queue_cycle(int tms, int tdi, bool capture)
+{
+	if (remote_bitbang_pkt_cycles && (remote_bitbang_pkt_capture != capture ||
+			remote_bitbang_pkt_cycles == REMOTE_BITBANG_PACKET_CYCLES_MAX))
+		remote_bitbang_close_packet();
+
+	unsigned shift = (remote_bitbang_pkt_cycles % 4) * 2;
+	/* room for the header of a new command and/or its next data byte */
+	unsigned needed = (remote_bitbang_pkt_cycles ? 0 : 3) + (shift ? 0 : 1);
+	if (remote_bitbang_send_len + needed > sizeof(remote_bitbang_send_buf)) {
+		if (remote_bitbang_flush() != ERROR_OK)
+			return ERROR_FAIL;
+		shift = 0;
+	}
+
+	if (!remote_bitbang_pkt_cycles) {
+		remote_bitbang_pkt_start = remote_bitbang_send_len;
+		remote_bitbang_pkt_capture = capture;
+		remote_bitbang_send_buf[remote_bitbang_send_len] = capture ? 'C' : 'c';
+		remote_bitbang_send_len += 3;
 	}
+	if (!shift)
+		remote_bitbang_send_buf[remote_bitbang_send_len++] = 0;
+	remote_bitbang_send_buf[remote_bitbang_send_len - 1] |=
+		((tdi ? 0x1 : 0x0) | (tms ? 0x2 : 0x0)) << shift;
+	remote_bitbang_pkt_cycles++;
 	return ERROR_OK;
 }
 
 static int remote_bitbang_quit(void)
 {
-	if (EOF == fputc('Q', remote_bitbang_file)) {
-		LOG_ERROR("fputs: %s", strerror(errno));
+	if (remote_bitbang_putc('Q') != ERROR_OK)
 		return ERROR_FAIL;
-	}
 
-	if (EOF == fflush(remote_bitbang_file)) {
-		LOG_ERROR("fflush: %s", strerror(errno));
+	if (remote_bitbang_flush() != ERROR_OK)
 		return ERROR_FAIL;
-	}
 
-	/* We only need to close one of the FILE*s, because they both use the same */
-	/* underlying file descriptor. */
-	if (EOF == fclose(remote_bitbang_file)) {
-		LOG_ERROR("fclose: %s", strerror(errno));
+	if (close(remote_bitbang_fd) != 0) {
+		LOG_ERROR("close: %s", strerror(errno));
 		return ERROR_FAIL;
 	}
 
@@ -135,53 +243,131 @@ static bb_value_t char_to_int(int c)
 	}
 }
 
-/* Get the next read response. */
-static bb_value_t remote_bitbang_rread(void)
+/* Get the next byte sent by the remote end, sending out anything still
+ * buffered and waiting for the reply if necessary. */
+static int remote_bitbang_rread(void)
 {
-	if (EOF == fflush(remote_bitbang_file)) {
-		remote_bitbang_quit();
-		LOG_ERROR("fflush: %s", strerror(errno));
-		return BB_ERROR;
+	if (remote_bitbang_start == remote_bitbang_end) {
+		if (remote_bitbang_flush() != ERROR_OK ||
+				remote_bitbang_fill_buf(true) != ERROR_OK)
+			return EOF;
 	}
 
-	/* Enable blocking access. */
-	socket_block(remote_bitbang_fd);
-	char c;
-	ssize_t count = read(remote_bitbang_fd, &c, 1);
-	if (count == 1) {
-		return char_to_int(c);
-	} else {
-		remote_bitbang_quit();
-		LOG_ERROR("read: count=%d, error=%s", (int) count, strerror(errno));
-		return BB_ERROR;
-	}
+	int c = (unsigned char)remote_bitbang_buf[remote_bitbang_start];
+	remote_bitbang_start = (remote_bitbang_start + 1) % sizeof(remote_bitbang_buf);
+	return c;
 }
 
 static int remote_bitbang_sample(void)
 {
-	if (remote_bitbang_fill_buf() != ERROR_OK)
-		return ERROR_FAIL;
-	assert(!remote_bitbang_buf_full());
+	if (remote_bitbang_binary) {
+		remote_bitbang_sample_pending = true;
+		return ERROR_OK;
+	}
 	return remote_bitbang_putc('R');
 }
 
 static bb_value_t remote_bitbang_read_sample(void)
 {
-	if (remote_bitbang_start != remote_bitbang_end) {
-		int c = remote_bitbang_buf[remote_bitbang_start];
-		remote_bitbang_start =
-			(remote_bitbang_start + 1) % sizeof(remote_bitbang_buf);
-		return char_to_int(c);
+	if (!remote_bitbang_binary)
+		return char_to_int(remote_bitbang_rread());
+
+	if (!remote_bitbang_reply_bits) {
+		if (remote_bitbang_replies_start == remote_bitbang_replies_end)
+			remote_bitbang_close_packet();
+		if (remote_bitbang_replies_start == remote_bitbang_replies_end) {
+			LOG_ERROR("BUG: remote_bitbang: no TDO sample was requested");
+			return BB_ERROR;
+		}
+		remote_bitbang_reply_bits = remote_bitbang_replies[remote_bitbang_replies_start];
+		remote_bitbang_replies_start =
+			(remote_bitbang_replies_start + 1) % ARRAY_SIZE(remote_bitbang_replies);
+		remote_bitbang_reply_byte_bits = 0;
+	}
+	if (!remote_bitbang_reply_byte_bits) {
+		int c = remote_bitbang_rread();
+		if (c == EOF)
+			return BB_ERROR;
+		remote_bitbang_reply_byte = c;
+		remote_bitbang_reply_byte_bits = 8;
 	}
-	return remote_bitbang_rread();
+
+	bb_value_t value = (remote_bitbang_reply_byte & 1) ? BB_HIGH : BB_LOW;
+	remote_bitbang_reply_byte >>= 1;
+	remote_bitbang_reply_byte_bits--;
+	/* the rest of the last byte of a reply is padding */
+	if (--remote_bitbang_reply_bits == 0)
+		remote_bitbang_reply_byte_bits = 0;
+	return value;
 }
 
 static int remote_bitbang_write(int tck, int tms, int tdi)
 {
+	if (remote_bitbang_binary) {
+		/* Only rising edges matter; the remote end takes TCK low again
+		 * after each packed command. */
+		int retval = ERROR_OK;
+		if (tck && !remote_bitbang_last_tck) {
+			retval = remote_bitbang_queue_cycle(tms, tdi, remote_bitbang_sample_pending);
+			remote_bitbang_sample_pending = false;
+		}
+		remote_bitbang_last_tck = tck;
+		return retval;
+	}
+
 	char c = '0' + ((tck ? 0x4 : 0x0) | (tms ? 0x2 : 0x0) | (tdi ? 0x1 : 0x0));
 	return remote_bitbang_putc(c);
 }
 
+static int remote_bitbang_scan_bits(const uint8_t *tms_buf, const uint8_t *tdi_buf,
+		uint8_t *tdo_buf, unsigned int n)
+{
+	unsigned int next_tdo = 0;
+	int tms = 0, tdi = 0;
+
+	for (unsigned int i = 0; i < n; i++) {
+		uint8_t mask = 1 << (i % 8);
+		tms = tms_buf && (tms_buf[i / 8] & mask);
+		tdi = tdi_buf && (tdi_buf[i / 8] & mask);
+
+		if (remote_bitbang_binary) {
+			if (remote_bitbang_queue_cycle(tms, tdi, tdo_buf != NULL) != ERROR_OK)
+				return ERROR_FAIL;
+		} else {
+			int c = '0' + ((tms ? 0x2 : 0x0) | (tdi ? 0x1 : 0x0));
+			if (remote_bitbang_putc(c) != ERROR_OK ||
+					(tdo_buf && remote_bitbang_putc('R') != ERROR_OK) ||
+					remote_bitbang_putc(c + 4) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+
+		/* Collect TDO once as many samples are outstanding as the
+		 * receive buffer holds, and at the end. tdo_buf may alias
+		 * tdi_buf, so only bits already sent are overwritten. */
+		if (!tdo_buf || (i + 1 - next_tdo < REMOTE_BITBANG_SAMPLES_MAX && i + 1 < n))
+			continue;
+		for (; next_tdo <= i; next_tdo++) {
+			uint8_t tdo_mask = 1 << (next_tdo % 8);
+			switch (remote_bitbang_read_sample()) {
+				case BB_LOW:
+					tdo_buf[next_tdo / 8] &= ~tdo_mask;
+					break;
+				case BB_HIGH:
+					tdo_buf[next_tdo / 8] |= tdo_mask;
+					break;
+				default:
+					return ERROR_FAIL;
+			}
+		}
+	}
+
+	/* Leave TCK low; in binary mode the remote end already did. */
+	if (!remote_bitbang_binary)
+		return remote_bitbang_write(0, tms, tdi);
+	remote_bitbang_last_tck = 0;
+	return ERROR_OK;
+}
+
 static int remote_bitbang_reset(int trst, int srst)
 {
 	char c = 'r' + ((trst ? 0x2 : 0x0) | (srst ? 0x1 : 0x0));
@@ -194,11 +380,55 @@ static int remote_bitbang_blink(int on)
 	return remote_bitbang_putc(c);
 }
 
+/* Queues that don't read anything back must still reach the remote end
+ * before we return. */
+static int remote_bitbang_execute_queue(void)
+{
+	int retval = bitbang_execute_queue();
+	if (remote_bitbang_flush() != ERROR_OK)
+		return ERROR_FAIL;
+	return retval;
+}
+
+static int remote_bitbang_execute_cmd_queue(struct jtag_command *cmd_queue)
+{
+	int retval = bitbang_execute_cmd_queue(cmd_queue);
+	if (remote_bitbang_flush() != ERROR_OK)
+		return ERROR_FAIL;
+	return retval;
+}
+
+/* Ask the remote end whether it understands packed clock commands. One that
+ * doesn't ignores the 'X' and only answers the 'R'. */
+static int remote_bitbang_negotiate_binary(void)
+{
+	remote_bitbang_binary = false;
+	if (!remote_bitbang_binary_requested)
+		return ERROR_OK;
+
+	if (remote_bitbang_putc('X') != ERROR_OK || remote_bitbang_putc('R') != ERROR_OK)
+		return ERROR_FAIL;
+	int c = remote_bitbang_rread();
+	if (c == 'x') {
+		c = remote_bitbang_rread();
+		remote_bitbang_binary = true;
+	}
+	if (char_to_int(c) == BB_ERROR)
+		return ERROR_FAIL;
+
+	if (remote_bitbang_binary)
+		LOG_INFO("remote_bitbang: using packed binary mode");
+	else
+		LOG_WARNING("remote_bitbang: remote end has no packed binary mode, using ASCII");
+	return ERROR_OK;
+}
+
 static struct bitbang_interface remote_bitbang_bitbang = {
-	.buf_size = sizeof(remote_bitbang_buf) - 1,
+	.buf_size = REMOTE_BITBANG_SAMPLES_MAX,
 	.sample = &remote_bitbang_sample,
 	.read_sample = &remote_bitbang_read_sample,
 	.write = &remote_bitbang_write,
+	.scan_bits = &remote_bitbang_scan_bits,
 	.reset = &remote_bitbang_reset,
 	.blink = &remote_bitbang_blink,
 };
@@ -279,6 +509,13 @@ static int remote_bitbang_init(void)
 
 	remote_bitbang_start = 0;
 	remote_bitbang_end = 0;
+	remote_bitbang_send_len = 0;
+	remote_bitbang_pkt_cycles = 0;
+	remote_bitbang_replies_start = 0;
+	remote_bitbang_replies_end = 0;
+	remote_bitbang_reply_bits = 0;
+	remote_bitbang_sample_pending = false;
+	remote_bitbang_last_tck = 0;
 
 	LOG_INFO("Initializing remote_bitbang driver");
 	if (remote_bitbang_port == NULL)
@@ -289,10 +526,8 @@ static int remote_bitbang_init(void)
 	if (remote_bitbang_fd < 0)
 		return remote_bitbang_fd;
 
-	remote_bitbang_file = fdopen(remote_bitbang_fd, "w+");
-	if (remote_bitbang_file == NULL) {
-		LOG_ERROR("fdopen: failed to open write stream");
-		close(remote_bitbang_fd);
+	if (remote_bitbang_negotiate_binary() != ERROR_OK) {
+		LOG_ERROR("remote_bitbang: no reply from the remote end");
 		return ERROR_FAIL;
 	}
 
@@ -312,6 +547,15 @@ COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_port_command)
 	return ERROR_COMMAND_SYNTAX_ERROR;
 }
 
+COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_binary_command)
+{
+	if (CMD_ARGC == 1) {
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], remote_bitbang_binary_requested);
+		return ERROR_OK;
+	}
+	return ERROR_COMMAND_SYNTAX_ERROR;
+}
+
 COMMAND_HANDLER(remote_bitbang_handle_remote_bitbang_host_command)
 {
 	if (CMD_ARGC == 1) {
@@ -339,12 +583,20 @@ static const struct command_registration remote_bitbang_command_handlers[] = {
 			"  if port is 0 or unset, this is the name of the unix socket to use.",
 		.usage = "host_name",
 	},
+	{
+		.name = "remote_bitbang_binary",
+		.handler = remote_bitbang_handle_remote_bitbang_binary_command,
+		.mode = COMMAND_CONFIG,
+		.help = "Use packed binary clock commands if the remote end supports them.",
+		.usage = "('on'|'off')",
+	},
 	COMMAND_REGISTRATION_DONE,
 };
 
 struct jtag_interface remote_bitbang_interface = {
 	.name = "remote_bitbang",
-	.execute_queue = &bitbang_execute_queue,
+	.execute_queue = &remote_bitbang_execute_queue,
+	.execute_cmd_queue = &remote_bitbang_execute_cmd_queue,
 	.transports = jtag_only,
 	.commands = remote_bitbang_command_handlers,
 	.init = &remote_bitbang_init,
@@ -179,6 +179,8 @@ static inline tap_state_t jtag_debug_state_machine(const void *tms_buf,
 		return start_tap_state;
 }
 
+struct jtag_command;
+
 /**
  * Represents a driver for a debugging interface.
  *
@@ -212,6 +214,16 @@ struct jtag_interface {
 	 */
 	int (*execute_queue)(void);
 
+	/**
+	 * Execute a command queue detached from jtag_command_queue.
+	 * Optional.  Drivers providing it must not look at the global
+	 * queue from here, since it may be called from the adapter I/O
+	 * thread while the next queue is being built (see jtag_async).
+	 * @param cmd_queue The first command of the queue to execute.
+	 * @returns ERROR_OK on success, or an error code on failure.
+	 */
+	int (*execute_cmd_queue)(struct jtag_command *cmd_queue);
+
 	/**
 	 * Set the interface speed.
 	 * @param speed The new interface speed setting.
@@ -562,6 +562,52 @@ void jtag_execute_queue_noclear(void);
 /** @returns the number of times the scan queue has been flushed */
 int jtag_get_flush_queue_count(void);
 
+/**
+ * Handle to a queue handed over to the adapter I/O thread by
+ * jtag_execute_queue_async().
+ */
+struct jtag_future;
+
+/**
+ * Submit the current queue for execution and return without waiting
+ * for it, so that the caller can go on building the next queue.
+ *
+ * The queue runs on the adapter I/O thread when asynchronous execution
+ * is enabled (see jtag_config_async()), otherwise it is executed right
+ * away.  Either way, queues run in the order they were submitted and
+ * any later jtag_execute_queue() waits for all of them first.  Results
+ * of in_value fields and queued callbacks are only valid once the
+ * future completed.
+ *
+ * @param future If non-NULL, receives a handle which must be passed to
+ * jtag_future_wait() or jtag_future_release().  If NULL, the result
+ * is reported by the next jtag_execute_queue().
+ * @returns ERROR_OK if the queue was submitted, or an error code.
+ */
+int jtag_execute_queue_async(struct jtag_future **future);
+/**
+ * Wait for a submitted queue to complete, run its callbacks and free
+ * the handle.
+ * @returns The result of the queue execution.
+ */
+int jtag_future_wait(struct jtag_future *future);
+/** @returns true if the queue behind @a future has been executed. */
+bool jtag_future_done(struct jtag_future *future);
+/**
+ * Free the handle without waiting.  The queue still completes and its
+ * result is reported by the next jtag_execute_queue().
+ */
+void jtag_future_release(struct jtag_future *future);
+/**
+ * Wait for all submitted queues to complete and run their callbacks.
+ * Errors of released futures are left for the next jtag_execute_queue().
+ */
+void jtag_async_drain(void);
+/** Enable or disable execution of queues on the adapter I/O thread. */
+int jtag_config_async(bool enable);
+/** @returns true if queues are executed on the adapter I/O thread. */
+bool jtag_async_enabled(void);
+
 /** Report Tcl event to all TAPs */
 void jtag_notify_event(enum jtag_event);
 
@@ -1220,6 +1220,25 @@ COMMAND_HANDLER(handle_verify_jtag_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_jtag_async_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1) {
+		bool enable;
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], enable);
+		int retval = jtag_config_async(enable);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	const char *status = jtag_async_enabled() ? "enabled" : "disabled";
+	command_print(CMD, "asynchronous queue execution is %s", status);
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_tms_sequence_command)
 {
 	if (CMD_ARGC > 1)
@@ -1371,6 +1390,15 @@ static const struct command_registration jtag_command_handlers[] = {
 			"verify values captured during IR and DR scans.",
 		.usage = "['enable'|'disable']",
 	},
+	{
+		.name = "jtag_async",
+		.handler = handle_jtag_async_command,
+		.mode = COMMAND_ANY,
+		.help = "Display or assign flag controlling whether JTAG "
+			"queues may be executed by a background adapter "
+			"I/O thread.",
+		.usage = "['enable'|'disable']",
+	},
 	{
 		.name = "tms_sequence",
 		.handler = handle_tms_sequence_command,
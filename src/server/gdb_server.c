@@ -184,6 +184,12 @@ static int check_pending(struct connection *connection,
 		return ERROR_OK;
 	}
 
+	/* GDB won't send anything before it has seen our queued reply */
+	if (timeout_s > 0 && connection_flush(connection, true) != ERROR_OK) {
+		gdb_con->closed = true;
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
 	FD_ZERO(&read_fds);
 	FD_SET(connection->fd, &read_fds);
 
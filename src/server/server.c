@@ -77,6 +77,11 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 	c->cmd_ctx = copy_command_context(cmd_ctx);
 	c->service = service;
 	c->input_pending = 0;
+	c->out_buf = NULL;
+	c->out_size = 0;
+	c->out_len = 0;
+	c->out_sent = 0;
+	c->out_error = false;
 	c->priv = NULL;
 	c->next = NULL;
 
@@ -97,6 +102,10 @@ static int add_connection(struct service *service, struct command_context *cmd_c
 			(char *)&flag,			/* the cast is historical cruft */
 			sizeof(int));			/* length of option value */
 
+		/* output is queued and written when the socket takes it, so a slow
+		 * client does not stall the main loop */
+		socket_nonblock(c->fd);
+
 		LOG_INFO("accepting '%s' connection on tcp/%s", service->name, service->port);
 		retval = service->new_connection(c);
 		if (retval != ERROR_OK) {
@@ -171,8 +180,12 @@ static int remove_connection(struct service *service, struct connection *connect
 	while ((c = *p)) {
 		if (c->fd == connection->fd) {
 			service->connection_closed(c);
-			if (service->type == CONNECTION_TCP)
+			if (service->type == CONNECTION_TCP) {
+				/* last words, e.g. the reply to "shutdown", if the socket takes them */
+				if (!c->out_error)
+					connection_flush(c, false);
 				close_socket(c->fd);
+			}
 			else if (service->type == CONNECTION_PIPE) {
 				/* The service will listen to the pipe again */
 				c->service->fd = c->fd;
@@ -182,6 +195,7 @@ static int remove_connection(struct service *service, struct connection *connect
 
 			/* delete connection */
 			*p = c->next;
+			free(c->out_buf);
 			free(c);
 
 			if (service->max_connections != CONNECTION_LIMIT_UNLIMITED)
@@ -436,6 +450,7 @@ int server_loop(struct command_context *command_context)
 
 	/* used in select() */
 	fd_set read_fds;
+	fd_set write_fds;
 	int fd_max;
 
 	/* used in accept() */
@@ -450,6 +465,7 @@ int server_loop(struct command_context *command_context)
 		/* monitor sockets for activity */
 		fd_max = 0;
 		FD_ZERO(&read_fds);
+		FD_ZERO(&write_fds);
 
 		/* add service and connection fds to read_fds */
 		for (service = services; service; service = service->next) {
@@ -469,6 +485,13 @@ int server_loop(struct command_context *command_context)
 					FD_SET(c->fd, &read_fds);
 					if (c->fd > fd_max)
 						fd_max = c->fd;
+
+					/* and for room to write queued output */
+					if (connection_out_pending(c)) {
+						FD_SET(c->fd_out, &write_fds);
+						if (c->fd_out > fd_max)
+							fd_max = c->fd_out;
+					}
 				}
 			}
 		}
@@ -479,14 +502,14 @@ int server_loop(struct command_context *command_context)
 			/* we're just polling this iteration, this is faster on embedded
 			 * hosts */
 			tv.tv_usec = 0;
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = socket_select(fd_max + 1, &read_fds, &write_fds, NULL, &tv);
 		} else {
 			/* Every 100ms, can be changed with "poll_period" command */
 			tv.tv_usec = polling_period * 1000;
 			/* Only while we're sleeping we'll let others run */
 			openocd_sleep_prelude();
 			kept_alive();
-			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
+			retval = socket_select(fd_max + 1, &read_fds, &write_fds, NULL, &tv);
 			openocd_sleep_postlude();
 		}
 
@@ -495,17 +518,19 @@ int server_loop(struct command_context *command_context)
 
 			errno = WSAGetLastError();
 
-			if (errno == WSAEINTR)
+			if (errno == WSAEINTR) {
 				FD_ZERO(&read_fds);
-			else {
+				FD_ZERO(&write_fds);
+			} else {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
 			}
 #else
 
-			if (errno == EINTR)
+			if (errno == EINTR) {
 				FD_ZERO(&read_fds);
-			else {
+				FD_ZERO(&write_fds);
+			} else {
 				LOG_ERROR("error during select: %s", strerror(errno));
 				return ERROR_FAIL;
 			}
@@ -517,8 +542,10 @@ int server_loop(struct command_context *command_context)
 			 *out */
 			target_call_timer_callbacks();
 			process_jim_events(command_context);
+			log_flush_deferred();
 
 			FD_ZERO(&read_fds);	/* eCos leaves read_fds unchanged in this case!  */
+			FD_ZERO(&write_fds);
 
 			/* We timed out/there was nothing to do, timeout rather than poll next time
 			 **/
@@ -562,22 +589,25 @@ int server_loop(struct command_context *command_context)
 				struct connection *c;
 
 				for (c = service->connections; c; ) {
-					if ((FD_ISSET(c->fd, &read_fds)) || c->input_pending) {
+					retval = ERROR_OK;
+					if (connection_out_pending(c) && FD_ISSET(c->fd_out, &write_fds))
+						retval = connection_flush(c, false);
+					if (retval == ERROR_OK &&
+							((FD_ISSET(c->fd, &read_fds)) || c->input_pending))
 						retval = service->input(c);
-						if (retval != ERROR_OK) {
-							struct connection *next = c->next;
-							if (service->type == CONNECTION_PIPE ||
-									service->type == CONNECTION_STDINOUT) {
-								/* if connection uses a pipe then
-								 * shutdown openocd on error */
-								shutdown_openocd = SHUTDOWN_REQUESTED;
-							}
-							remove_connection(service, c);
-							LOG_INFO("dropped '%s' connection",
-								service->name);
-							c = next;
-							continue;
+					if (retval != ERROR_OK) {
+						struct connection *next = c->next;
+						if (service->type == CONNECTION_PIPE ||
+								service->type == CONNECTION_STDINOUT) {
+							/* if connection uses a pipe then
+							 * shutdown openocd on error */
+							shutdown_openocd = SHUTDOWN_REQUESTED;
 						}
+						remove_connection(service, c);
+						LOG_INFO("dropped '%s' connection",
+							service->name);
+						c = next;
+						continue;
 					}
 					c = c->next;
 				}
@@ -716,16 +746,155 @@ void exit_on_signal(int sig)
 #endif
 }
 
+static bool connection_would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/* Write as much of the queued output as the socket takes. */
+static int connection_out_send(struct connection *connection)
+{
+	while (connection->out_sent < connection->out_len) {
+		int wlen = write_socket(connection->fd_out,
+				connection->out_buf + connection->out_sent,
+				connection->out_len - connection->out_sent);
+		if (wlen < 0) {
+			if (connection_would_block())
+				break;
+			connection->out_error = true;
+			return ERROR_SERVER_REMOTE_CLOSED;
+		}
+		connection->out_sent += wlen;
+	}
+
+	if (connection->out_sent == connection->out_len) {
+		connection->out_sent = 0;
+		connection->out_len = 0;
+	}
+
+	return ERROR_OK;
+}
+
+/* Wait until no more than @a level bytes of output are queued. */
+static int connection_out_drain(struct connection *connection, size_t level)
+{
+	while (connection_out_pending(connection) > level) {
+		fd_set write_fds;
+
+		FD_ZERO(&write_fds);
+		FD_SET(connection->fd_out, &write_fds);
+		if (socket_select(connection->fd_out + 1, NULL, &write_fds, NULL, NULL) == -1) {
+#ifdef _WIN32
+			if (WSAGetLastError() == WSAEINTR)
+				continue;
+#else
+			if (errno == EINTR)
+				continue;
+#endif
+			connection->out_error = true;
+			return ERROR_SERVER_REMOTE_CLOSED;
+		}
+
+		int retval = connection_out_send(connection);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+/* Queue output of a TCP connection and write what the socket takes right
+ * away; the rest is written by server_loop() once the socket is writable.
+ * Only when CONNECTION_OUT_MAX bytes pile up does this block, until the
+ * client has caught up to CONNECTION_OUT_HIGH_WATER. Pipes and stdio are
+ * written synchronously. Returns @a len, or -1 on error. */
 int connection_write(struct connection *connection, const void *data, int len)
 {
 	if (len == 0) {
 		/* successful no-op. Sockets and pipes behave differently here... */
 		return 0;
 	}
-	if (connection->service->type == CONNECTION_TCP)
-		return write_socket(connection->fd_out, data, len);
-	else
+	if (connection->service->type != CONNECTION_TCP)
 		return write(connection->fd_out, data, len);
+
+	if (connection->out_error)
+		return -1;
+
+	const uint8_t *p = data;
+	size_t left = len;
+
+	if (!connection_out_pending(connection)) {
+		int wlen = write_socket(connection->fd_out, p, left);
+		if (wlen < 0 && !connection_would_block()) {
+			connection->out_error = true;
+			return -1;
+		}
+		if (wlen > 0) {
+			p += wlen;
+			left -= wlen;
+		}
+		if (!left)
+			return len;
+	}
+
+	if (connection->out_sent) {
+		/* drop what has already been written */
+		memmove(connection->out_buf, connection->out_buf + connection->out_sent,
+				connection->out_len - connection->out_sent);
+		connection->out_len -= connection->out_sent;
+		connection->out_sent = 0;
+	}
+
+	if (connection->out_len + left > connection->out_size) {
+		size_t size = MAX(MAX(connection->out_size * 2, connection->out_len + left), 4096);
+		uint8_t *buf = realloc(connection->out_buf, size);
+		if (!buf) {
+			LOG_ERROR("out of memory queueing '%s' output", connection->service->name);
+			connection->out_error = true;
+			return -1;
+		}
+		connection->out_buf = buf;
+		connection->out_size = size;
+	}
+
+	memcpy(connection->out_buf + connection->out_len, p, left);
+	connection->out_len += left;
+
+	if (connection->out_len >= CONNECTION_OUT_MAX &&
+			connection_out_drain(connection, CONNECTION_OUT_HIGH_WATER) != ERROR_OK)
+		return -1;
+
+	return len;
+}
+
+/* Write queued output without blocking, or all of it if @a block is set,
+ * e.g. before waiting for a reply to it. */
+int connection_flush(struct connection *connection, bool block)
+{
+	if (connection->out_error)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
+	if (block)
+		return connection_out_drain(connection, 0);
+
+	return connection_out_send(connection);
+}
+
+/* Bytes of output still queued. */
+size_t connection_out_pending(struct connection *connection)
+{
+	return connection->out_len - connection->out_sent;
+}
+
+/* True when the client is lagging behind and output that can be dropped
+ * or deferred, like notifications, should be. */
+bool connection_out_full(struct connection *connection)
+{
+	return connection_out_pending(connection) >= CONNECTION_OUT_HIGH_WATER;
 }
 
 int connection_read(struct connection *connection, void *data, int len)
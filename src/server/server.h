@@ -43,6 +43,13 @@ enum connection_type {
 
 #define CONNECTION_LIMIT_UNLIMITED		(-1)
 
+/* Queued output above which producers that can drop or defer data should
+ * do so, see connection_out_full(). */
+#define CONNECTION_OUT_HIGH_WATER		(256 * 1024)
+/* Queued output at which connection_write() blocks until the client has
+ * caught up to the high-water mark. */
+#define CONNECTION_OUT_MAX				(16 * 1024 * 1024)
+
 struct connection {
 	int fd;
 	int fd_out;	/* When using pipes we're writing to a different fd */
@@ -50,6 +57,13 @@ struct connection {
 	struct command_context *cmd_ctx;
 	struct service *service;
 	int input_pending;
+	/* queued output of TCP connections, [out_sent, out_len) is still to
+	 * be written; pipes and stdio are written synchronously */
+	uint8_t *out_buf;
+	size_t out_size;
+	size_t out_len;
+	size_t out_sent;
+	bool out_error;
 	void *priv;
 	struct connection *next;
 };
@@ -92,6 +106,9 @@ int server_register_commands(struct command_context *context);
 
 int connection_write(struct connection *connection, const void *data, int len);
 int connection_read(struct connection *connection, void *data, int len);
+int connection_flush(struct connection *connection, bool block);
+size_t connection_out_pending(struct connection *connection);
+bool connection_out_full(struct connection *connection);
 
 /**
  * Used by server_loop(), defined in server_stubs.c
@@ -22,12 +22,22 @@
 
 #include "tcl_server.h"
 #include <target/target.h>
+#include <target/live_watch.h>
 #include <helper/binarybuffer.h>
 
 #define TCL_SERVER_VERSION		"TCL Server 0.1"
 #define TCL_LINE_INITIAL		(4*1024)
 #define TCL_LINE_MAX			(4*1024*1024)
 
+/* notifications queued for a client that does not read them fast enough
+ * are dropped beyond this, rather than blocking the server loop */
+#define TCL_NOTIFY_QUEUE_MAX	(1024*1024)
+/* consecutive binary trace events are merged into frames up to this size */
+#define TCL_TRACE_FRAME_MAX		(64*1024)
+#define TCL_NOTIFY_FLUSH_MS		10
+
+#define TCL_TRACE_BINARY_HEADER	"type target_trace binary "
+
 struct tcl_connection {
 	int tc_linedrop;
 	int tc_lineoffset;
@@ -37,6 +47,18 @@ struct tcl_connection {
 	enum target_state tc_laststate;
 	bool tc_notify;
 	bool tc_trace;
+	bool tc_trace_binary;
+	/* notifications held back while the connection's output queue is full */
+	uint8_t *tc_notify_buf;
+	size_t tc_notify_size;
+	size_t tc_notify_len;
+	/* start of the binary trace frame at the end of the queue, which later
+	 * trace data may be appended to, or SIZE_MAX */
+	size_t tc_trace_frame;
+	/* notifications dropped since the last drop report, and in total */
+	uint32_t tc_dropped;
+	uint64_t tc_dropped_bytes;
+	uint32_t tc_dropped_total;
 };
 
 static char *tcl_port;
@@ -47,6 +69,109 @@ static int tcl_input(struct connection *connection);
 static int tcl_output(struct connection *connection, const void *buf, ssize_t len);
 static int tcl_closed(struct connection *connection);
 
+/* Move the notification queue to the connection's output queue while that
+ * is below its high-water mark, or regardless if @a block is set. */
+static int tcl_notify_flush(struct connection *connection, bool block)
+{
+	struct tcl_connection *tclc = connection->priv;
+	size_t len = tclc->tc_notify_len;
+
+	if (!len || (!block && connection_out_full(connection)))
+		return ERROR_OK;
+
+	if (connection_write(connection, tclc->tc_notify_buf, len) != (int)len) {
+		LOG_ERROR("error during write: %s", strerror(errno));
+		tclc->tc_outerror = 1;
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	tclc->tc_notify_len = 0;
+	tclc->tc_trace_frame = SIZE_MAX;
+
+	return ERROR_OK;
+}
+
+static int tcl_notify_timer(void *priv)
+{
+	struct connection *connection = priv;
+	struct tcl_connection *tclc = connection->priv;
+
+	if (tclc->tc_notify_len && !tclc->tc_outerror)
+		tcl_notify_flush(connection, false);
+
+	return ERROR_OK;
+}
+
+/* Make room for @a len more bytes at the end of the notification queue,
+ * or return NULL if the queue is full. */
+static uint8_t *tcl_notify_reserve(struct tcl_connection *tclc, size_t len)
+{
+	if (tclc->tc_notify_len + len > TCL_NOTIFY_QUEUE_MAX)
+		return NULL;
+
+	if (tclc->tc_notify_len + len > tclc->tc_notify_size) {
+		size_t size = MAX(tclc->tc_notify_size * 2, tclc->tc_notify_len + len);
+		size = MIN(MAX(size, 4096), TCL_NOTIFY_QUEUE_MAX);
+		uint8_t *buf = realloc(tclc->tc_notify_buf, size);
+		if (!buf)
+			return NULL;
+		tclc->tc_notify_buf = buf;
+		tclc->tc_notify_size = size;
+	}
+
+	return tclc->tc_notify_buf + tclc->tc_notify_len;
+}
+
+/* Count a notification that did not fit into the queue. */
+static void tcl_notify_drop(struct tcl_connection *tclc, size_t len)
+{
+	tclc->tc_dropped++;
+	tclc->tc_dropped_total++;
+	tclc->tc_dropped_bytes += len;
+}
+
+/* Tell the client how much it missed, once there is room again. */
+static bool tcl_notify_report_drops(struct tcl_connection *tclc, size_t next_len)
+{
+	char buf[128];
+
+	if (!tclc->tc_dropped)
+		return true;
+
+	int len = snprintf(buf, sizeof(buf), "type notifications_dropped count %" PRIu32
+			" bytes %" PRIu64 "\r\n\x1a", tclc->tc_dropped, tclc->tc_dropped_bytes);
+	uint8_t *p = tcl_notify_reserve(tclc, len + next_len);
+	if (!p)
+		return false;
+	memcpy(p, buf, len);
+	tclc->tc_notify_len += len;
+	tclc->tc_trace_frame = SIZE_MAX;
+	tclc->tc_dropped = 0;
+	tclc->tc_dropped_bytes = 0;
+	return true;
+}
+
+/* Queue a text notification for the client and start sending it. */
+static void tcl_notify(struct connection *connection, const char *msg)
+{
+	struct tcl_connection *tclc = connection->priv;
+	size_t len = strlen(msg);
+
+	if (tclc->tc_outerror)
+		return;
+
+	uint8_t *p = tcl_notify_report_drops(tclc, len) ? tcl_notify_reserve(tclc, len) : NULL;
+	if (!p) {
+		tcl_notify_drop(tclc, len);
+		return;
+	}
+	memcpy(p, msg, len);
+	tclc->tc_notify_len += len;
+	tclc->tc_trace_frame = SIZE_MAX;
+
+	tcl_notify_flush(connection, false);
+}
+
 static int tcl_target_callback_event_handler(struct target *target,
 		enum target_event event, void *priv)
 {
@@ -58,14 +183,14 @@ static int tcl_target_callback_event_handler(struct target *target,
 
 	if (tclc->tc_notify) {
 		snprintf(buf, sizeof(buf), "type target_event event %s\r\n\x1a", target_event_name(event));
-		tcl_output(connection, buf, strlen(buf));
+		tcl_notify(connection, buf);
 	}
 
 	if (tclc->tc_laststate != target->state) {
 		tclc->tc_laststate = target->state;
 		if (tclc->tc_notify) {
 			snprintf(buf, sizeof(buf), "type target_state state %s\r\n\x1a", target_state_name(target));
-			tcl_output(connection, buf, strlen(buf));
+			tcl_notify(connection, buf);
 		}
 	}
 
@@ -83,33 +208,107 @@ static int tcl_target_callback_reset_handler(struct target *target,
 
 	if (tclc->tc_notify) {
 		snprintf(buf, sizeof(buf), "type target_reset mode %s\r\n\x1a", target_reset_mode_name(reset_mode));
-		tcl_output(connection, buf, strlen(buf));
+		tcl_notify(connection, buf);
 	}
 
 	return ERROR_OK;
 }
 
+/* Binary trace frames are "type target_trace binary LLLLLLLL\r\n", where
+ * LLLLLLLL is the payload length in hex, followed by the raw payload and
+ * \x1a. Events arriving while the last frame is still queued are appended
+ * to it. */
+static void tcl_trace_binary(struct connection *connection, size_t len, const uint8_t *data)
+{
+	struct tcl_connection *tclc = connection->priv;
+	const size_t header_len = strlen(TCL_TRACE_BINARY_HEADER) + 8 + 2;
+	char header[48];
+	uint8_t *p;
+
+	if (tclc->tc_trace_frame != SIZE_MAX) {
+		uint8_t *frame = tclc->tc_notify_buf + tclc->tc_trace_frame;
+		size_t frame_len = strtoul((char *)frame + strlen(TCL_TRACE_BINARY_HEADER), NULL, 16);
+
+		if (frame_len + len <= TCL_TRACE_FRAME_MAX) {
+			p = tcl_notify_reserve(tclc, len);
+			if (p) {
+				/* tcl_notify_reserve() may have moved the queue */
+				frame = tclc->tc_notify_buf + tclc->tc_trace_frame;
+				memcpy(p - 1, data, len);
+				p[len - 1] = '\x1a';
+				tclc->tc_notify_len += len;
+				snprintf(header, sizeof(header), "%08zx", frame_len + len);
+				memcpy(frame + strlen(TCL_TRACE_BINARY_HEADER), header, 8);
+				return;
+			}
+		}
+	}
+
+	p = tcl_notify_report_drops(tclc, header_len + len + 1) ?
+		tcl_notify_reserve(tclc, header_len + len + 1) : NULL;
+	if (!p) {
+		tcl_notify_drop(tclc, len);
+		return;
+	}
+	snprintf(header, sizeof(header), TCL_TRACE_BINARY_HEADER "%08zx\r\n", len);
+	memcpy(p, header, header_len);
+	memcpy(p + header_len, data, len);
+	p[header_len + len] = '\x1a';
+	tclc->tc_trace_frame = tclc->tc_notify_len;
+	tclc->tc_notify_len += header_len + len + 1;
+}
+
 static int tcl_target_callback_trace_handler(struct target *target,
 		size_t len, uint8_t *data, void *priv)
 {
 	struct connection *connection = priv;
 	struct tcl_connection *tclc;
-	char *header = "type target_trace data ";
-	char *trailer = "\r\n\x1a";
-	size_t hex_len = len * 2 + 1;
-	size_t max_len = hex_len + strlen(header) + strlen(trailer);
-	char *buf, *hex;
+	const char *header = "type target_trace data ";
+	const char *trailer = "\r\n\x1a";
 
 	tclc = connection->priv;
 
-	if (tclc->tc_trace) {
-		hex = malloc(hex_len);
-		buf = malloc(max_len);
-		hexify(hex, data, len, hex_len);
-		snprintf(buf, max_len, "%s%s%s", header, hex, trailer);
-		tcl_output(connection, buf, strlen(buf));
-		free(hex);
-		free(buf);
+	if (!tclc->tc_trace || tclc->tc_outerror)
+		return ERROR_OK;
+
+	if (tclc->tc_trace_binary) {
+		tcl_trace_binary(connection, len, data);
+	} else {
+		/* hex-encode straight into the queue */
+		size_t msg_len = strlen(header) + len * 2 + strlen(trailer);
+		uint8_t *p = tcl_notify_report_drops(tclc, msg_len) ?
+			tcl_notify_reserve(tclc, msg_len + 1) : NULL;
+		if (!p) {
+			tcl_notify_drop(tclc, len);
+			return ERROR_OK;
+		}
+		strcpy((char *)p, header);
+		hexify((char *)p + strlen(header), data, len, len * 2 + 1);
+		memcpy(p + strlen(header) + len * 2, trailer, strlen(trailer));
+		tclc->tc_notify_len += msg_len;
+		tclc->tc_trace_frame = SIZE_MAX;
+	}
+
+	tcl_notify_flush(connection, false);
+
+	return ERROR_OK;
+}
+
+static int tcl_live_watch_handler(const struct live_watch_sample *sample, void *priv)
+{
+	struct connection *connection = priv;
+	struct tcl_connection *tclc;
+	char buf[256];
+
+	tclc = connection->priv;
+
+	if (tclc->tc_notify) {
+		snprintf(buf, sizeof(buf), "type live_watch target %s name %s address 0x%" TARGET_PRIxADDR
+				" value 0x%" PRIx64 " time %" PRId64 ".%03u\r\n\x1a",
+				target_name(sample->target), sample->name, sample->address,
+				sample->value, sample->timestamp / 1000,
+				(unsigned int)(sample->timestamp % 1000));
+		tcl_notify(connection, buf);
 	}
 
 	return ERROR_OK;
@@ -117,8 +316,9 @@ static int tcl_target_callback_trace_handler(struct target *target,
 
 /* write data out to a socket.
  *
- * this is a blocking write, so the return value must equal the length, if
- * that is not the case then flag the connection with an output error.
+ * the data is queued by connection_write(), so the return value must equal
+ * the length, if that is not the case then flag the connection with an
+ * output error.
  */
 int tcl_output(struct connection *connection, const void *data, ssize_t len)
 {
@@ -129,6 +329,10 @@ int tcl_output(struct connection *connection, const void *data, ssize_t len)
 	if (tclc->tc_outerror)
 		return ERROR_SERVER_REMOTE_CLOSED;
 
+	/* queued notifications go first, a reply must not split one */
+	if (tcl_notify_flush(connection, true) != ERROR_OK)
+		return ERROR_SERVER_REMOTE_CLOSED;
+
 	wlen = connection_write(connection, data, len);
 
 	if (wlen == len)
@@ -167,6 +371,10 @@ static int tcl_new_connection(struct connection *connection)
 	target_register_event_callback(tcl_target_callback_event_handler, connection);
 	target_register_reset_callback(tcl_target_callback_reset_handler, connection);
 	target_register_trace_callback(tcl_target_callback_trace_handler, connection);
+	live_watch_register_callback(tcl_live_watch_handler, connection);
+	tclc->tc_trace_frame = SIZE_MAX;
+	target_register_timer_callback(tcl_notify_timer, TCL_NOTIFY_FLUSH_MS,
+			TARGET_TIMER_TYPE_PERIODIC, connection);
 
 	return ERROR_OK;
 }
@@ -264,14 +472,21 @@ static int tcl_closed(struct connection *connection)
 
 	/* cleanup connection context */
 	if (tclc) {
+		if (tclc->tc_dropped_total)
+			LOG_INFO("tcl: dropped %" PRIu32 " notifications for a slow client",
+					tclc->tc_dropped_total);
 		free(tclc->tc_line);
+		free(tclc->tc_notify_buf);
 		free(tclc);
 		connection->priv = NULL;
 	}
 
+	target_unregister_timer_callback(tcl_notify_timer, connection);
+
 	target_unregister_event_callback(tcl_target_callback_event_handler, connection);
 	target_unregister_reset_callback(tcl_target_callback_reset_handler, connection);
 	target_unregister_trace_callback(tcl_target_callback_trace_handler, connection);
+	live_watch_unregister_callback(tcl_live_watch_handler, connection);
 
 	return ERROR_OK;
 }
@@ -320,6 +535,14 @@ COMMAND_HANDLER(handle_tcl_trace_command)
 
 	if (connection != NULL && !strcmp(connection->service->name, "tcl")) {
 		tclc = connection->priv;
+		if (CMD_ARGC == 1 && !strcmp(CMD_ARGV[0], "binary")) {
+			tclc->tc_trace = true;
+			tclc->tc_trace_binary = true;
+			LOG_INFO("Target trace output is binary");
+			return ERROR_OK;
+		}
+		if (CMD_ARGC == 1)
+			tclc->tc_trace_binary = false;
 		return CALL_COMMAND_HANDLER(handle_command_parse_bool, &tclc->tc_trace, "Target trace output ");
 	} else {
 		LOG_ERROR("%s: can only be called from the tcl server", CMD_NAME);
@@ -348,8 +571,8 @@ static const struct command_registration tcl_command_handlers[] = {
 		.name = "tcl_trace",
 		.handler = handle_tcl_trace_command,
 		.mode = COMMAND_EXEC,
-		.help = "Target trace output",
-		.usage = "[on|off]",
+		.help = "Target trace output, hex-encoded or as binary frames",
+		.usage = "[on|off|binary]",
 	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -29,6 +29,7 @@
 #include "config.h"
 #endif
 
+#include <pthread.h>
 #include <jtag/jtag.h>
 #include "svf.h"
 #include <helper/time_support.h>
@@ -206,7 +207,8 @@ struct svf_check_tdo_para {
 	int bit_len;		/* bit length to check */
 };
 
-#define SVF_CHECK_TDO_PARA_SIZE 1024
+/* Scans are executed in batches of up to half this many TDO checks */
+#define SVF_CHECK_TDO_PARA_SIZE 16384
 static struct svf_check_tdo_para *svf_check_tdo_para;
 static int svf_check_tdo_para_index;
 
@@ -224,6 +226,42 @@ static size_t svf_command_buffer_size;
 static int svf_line_number;
 static int svf_getline(char **lineptr, size_t *n, FILE *stream);
 
+/*
+ * Lines are read and assembled into commands by a reader thread, so file
+ * I/O overlaps the scans. The reader owns svf_fd, svf_read_line,
+ * svf_command_buffer and svf_line_number; the main thread only sees the
+ * copies queued here. Commands are queued as text: HDR/HIR/TDR/TIR,
+ * ENDIR/ENDDR and the -tap padding are applied by svf_run_command() when
+ * a command executes, so reading ahead doesn't depend on them.
+ */
+#define SVF_READ_AHEAD_COMMANDS 32
+
+struct svf_queued_command {
+	char *command;
+	char *line;			/* last line of the command, NULL when quiet */
+	int line_number;
+	long offset;		/* file position after the command, -1 if unknown */
+};
+
+static struct {
+	pthread_t thread;
+	pthread_mutex_t mux;
+	pthread_cond_t cond;
+	bool started;
+	bool stop;
+	bool done;
+	struct svf_queued_command queue[SVF_READ_AHEAD_COMMANDS];
+	/* free running counters, the queue index is the counter modulo its size */
+	unsigned int head;
+	unsigned int tail;
+} svf_reader = {
+	.mux = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* line of the command being run by the main thread */
+static int svf_run_line_number;
+
 #define SVF_MAX_BUFFER_SIZE_TO_COMMIT   (1024 * 1024)
 static uint8_t *svf_tdi_buffer, *svf_tdo_buffer, *svf_mask_buffer;
 static int svf_buffer_index, svf_buffer_size ;
@@ -237,7 +275,7 @@ static int svf_set_padding(struct svf_xxr_para *para, int len, unsigned char tdi
 
 /* Progress Indicator */
 static int svf_progress_enabled;
-static long svf_total_lines;
+static long svf_total_size;
 static int svf_percentage;
 static int svf_last_printed_percentage = -1;
 
@@ -355,6 +393,126 @@ int svf_add_statemove(tap_state_t state_to)
 	return ERROR_FAIL;
 }
 
+/* Value of each character in a (upper case) hex string */
+#define SVF_HEX_SPACE	-1
+#define SVF_HEX_INVALID	-2
+static int8_t svf_hex_value[256];
+
+static void svf_hex_value_init(void)
+{
+	for (int c = 0; c < 256; c++) {
+		if (c >= '0' && c <= '9')
+			svf_hex_value[c] = c - '0';
+		else if (c >= 'A' && c <= 'F')
+			svf_hex_value[c] = c - 'A' + 10;
+		else if (isspace(c))
+			svf_hex_value[c] = SVF_HEX_SPACE;
+		else
+			svf_hex_value[c] = SVF_HEX_INVALID;
+	}
+}
+
+static void *svf_reader_thread(void *arg)
+{
+	while (true) {
+		pthread_mutex_lock(&svf_reader.mux);
+		while (!svf_reader.stop &&
+				svf_reader.head - svf_reader.tail == SVF_READ_AHEAD_COMMANDS)
+			pthread_cond_wait(&svf_reader.cond, &svf_reader.mux);
+		bool stop = svf_reader.stop;
+		pthread_mutex_unlock(&svf_reader.mux);
+		if (stop)
+			break;
+
+		if (svf_read_command_from_file(svf_fd) != ERROR_OK)
+			break;
+
+		struct svf_queued_command cmd = {
+			.command = strdup(svf_command_buffer),
+			.line = svf_quiet ? NULL : strdup(svf_read_line),
+			.line_number = svf_line_number,
+			.offset = svf_progress_enabled ? ftell(svf_fd) : -1,
+		};
+		if (!cmd.command || (!svf_quiet && !cmd.line)) {
+			LOG_ERROR("not enough memory");
+			free(cmd.command);
+			free(cmd.line);
+			break;
+		}
+
+		pthread_mutex_lock(&svf_reader.mux);
+		svf_reader.queue[svf_reader.head % SVF_READ_AHEAD_COMMANDS] = cmd;
+		svf_reader.head++;
+		pthread_cond_broadcast(&svf_reader.cond);
+		pthread_mutex_unlock(&svf_reader.mux);
+	}
+
+	pthread_mutex_lock(&svf_reader.mux);
+	svf_reader.done = true;
+	pthread_cond_broadcast(&svf_reader.cond);
+	pthread_mutex_unlock(&svf_reader.mux);
+	return NULL;
+}
+
+static int svf_reader_start(void)
+{
+	svf_reader.stop = false;
+	svf_reader.done = false;
+	svf_reader.head = 0;
+	svf_reader.tail = 0;
+	if (pthread_create(&svf_reader.thread, NULL, svf_reader_thread, NULL) != 0) {
+		LOG_ERROR("can't start svf reader thread");
+		return ERROR_FAIL;
+	}
+	svf_reader.started = true;
+	return ERROR_OK;
+}
+
+/* Takes the next command off the queue, false at the end of the file. */
+static bool svf_reader_next(struct svf_queued_command *cmd)
+{
+	pthread_mutex_lock(&svf_reader.mux);
+	while (svf_reader.head == svf_reader.tail && !svf_reader.done) {
+		pthread_mutex_unlock(&svf_reader.mux);
+		/* print what the reader logged while the queue was empty */
+		log_flush_deferred();
+		pthread_mutex_lock(&svf_reader.mux);
+		if (svf_reader.head == svf_reader.tail && !svf_reader.done)
+			pthread_cond_wait(&svf_reader.cond, &svf_reader.mux);
+	}
+	bool ok = svf_reader.head != svf_reader.tail;
+	if (ok) {
+		*cmd = svf_reader.queue[svf_reader.tail % SVF_READ_AHEAD_COMMANDS];
+		svf_reader.tail++;
+		pthread_cond_broadcast(&svf_reader.cond);
+	}
+	pthread_mutex_unlock(&svf_reader.mux);
+	return ok;
+}
+
+static void svf_free_queued_command(struct svf_queued_command *cmd)
+{
+	free(cmd->command);
+	free(cmd->line);
+}
+
+static void svf_reader_stop(void)
+{
+	if (!svf_reader.started)
+		return;
+
+	pthread_mutex_lock(&svf_reader.mux);
+	svf_reader.stop = true;
+	pthread_cond_broadcast(&svf_reader.cond);
+	pthread_mutex_unlock(&svf_reader.mux);
+	pthread_join(svf_reader.thread, NULL);
+	svf_reader.started = false;
+
+	while (svf_reader.head != svf_reader.tail)
+		svf_free_queued_command(&svf_reader.queue[svf_reader.tail++ % SVF_READ_AHEAD_COMMANDS]);
+	log_flush_deferred();
+}
+
 COMMAND_HANDLER(handle_svf_command)
 {
 #define SVF_MIN_NUM_OF_OPTIONS 1
@@ -417,7 +575,10 @@ COMMAND_HANDLER(handle_svf_command)
 
 	/* init */
 	svf_line_number = 0;
+	svf_run_line_number = 0;
 	svf_command_buffer_size = 0;
+	svf_total_size = 0;
+	svf_hex_value_init();
 
 	svf_check_tdo_para_index = 0;
 	svf_check_tdo_para = malloc(sizeof(struct svf_check_tdo_para) * SVF_CHECK_TDO_PARA_SIZE);
@@ -489,39 +650,53 @@ COMMAND_HANDLER(handle_svf_command)
 	}
 
 	if (svf_progress_enabled) {
-		/* Count total lines in file. */
-		while (!feof(svf_fd)) {
-			svf_getline(&svf_command_buffer, &svf_command_buffer_size, svf_fd);
-			svf_total_lines++;
+		/* Progress is tracked by file position, no need for an extra pass.
+		 * If the size is unknown (e.g. a pipe), no percentage is shown. */
+		if (fseek(svf_fd, 0, SEEK_END) == 0) {
+			svf_total_size = ftell(svf_fd);
+			rewind(svf_fd);
 		}
-		rewind(svf_fd);
 	}
-	while (ERROR_OK == svf_read_command_from_file(svf_fd)) {
+
+	if (svf_reader_start() != ERROR_OK) {
+		ret = ERROR_FAIL;
+		goto free_all;
+	}
+
+	struct svf_queued_command queued;
+	while (svf_reader_next(&queued)) {
+		svf_run_line_number = queued.line_number;
+
 		/* Log Output */
+		bool show_progress = svf_progress_enabled && svf_total_size > 0 && queued.offset >= 0;
+		if (show_progress)
+			svf_percentage = ((queued.offset * 20) / svf_total_size) * 5;
 		if (svf_quiet) {
-			if (svf_progress_enabled) {
-				svf_percentage = ((svf_line_number * 20) / svf_total_lines) * 5;
+			if (show_progress) {
 				if (svf_last_printed_percentage != svf_percentage) {
 					LOG_USER_N("\r%d%%    ", svf_percentage);
 					svf_last_printed_percentage = svf_percentage;
 				}
 			}
 		} else {
-			if (svf_progress_enabled) {
-				svf_percentage = ((svf_line_number * 20) / svf_total_lines) * 5;
-				LOG_USER_N("%3d%%  %s", svf_percentage, svf_read_line);
+			if (show_progress) {
+				LOG_USER_N("%3d%%  %s", svf_percentage, queued.line);
 			} else
-				LOG_USER_N("%s", svf_read_line);
+				LOG_USER_N("%s", queued.line);
 		}
 		/* Run Command */
-		if (ERROR_OK != svf_run_command(CMD_CTX, svf_command_buffer)) {
-			LOG_ERROR("fail to run command at line %d", svf_line_number);
+		ret = svf_run_command(CMD_CTX, queued.command);
+		svf_free_queued_command(&queued);
+		if (ERROR_OK != ret) {
+			LOG_ERROR("fail to run command at line %d", svf_run_line_number);
 			ret = ERROR_FAIL;
 			break;
 		}
 		command_num++;
 	}
 
+	svf_reader_stop();
+
 	if ((!svf_nil) && (ERROR_OK != jtag_execute_queue()))
 		ret = ERROR_FAIL;
 	else if (ERROR_OK != svf_check_tdo())
@@ -542,6 +717,7 @@ COMMAND_HANDLER(handle_svf_command)
 
 free_all:
 
+	svf_reader_stop();
 	fclose(svf_fd);
 	svf_fd = 0;
 
@@ -593,8 +769,8 @@ free_all:
 
 static int svf_getline(char **lineptr, size_t *n, FILE *stream)
 {
-#define MIN_CHUNK 16	/* Buffer is increased by this size each time as required */
-	size_t i = 0;
+#define MIN_CHUNK 256	/* Initial buffer size, doubled each time as required */
+	size_t len = 0;
 
 	if (*lineptr == NULL) {
 		*n = MIN_CHUNK;
@@ -603,22 +779,23 @@ static int svf_getline(char **lineptr, size_t *n, FILE *stream)
 			return -1;
 	}
 
-	(*lineptr)[0] = fgetc(stream);
-	while ((*lineptr)[i] != '\n') {
-		(*lineptr)[++i] = fgetc(stream);
-		if (feof(stream)) {
-			(*lineptr)[0] = 0;
-			return -1;
-		}
-		if ((i + 2) > *n) {
-			*n += MIN_CHUNK;
-			*lineptr = realloc(*lineptr, *n);
-		}
+	/* long bitstring lines are common, grow geometrically */
+	while (fgets(*lineptr + len, *n - len, stream)) {
+		len += strlen(*lineptr + len);
+		if (len > 0 && (*lineptr)[len - 1] == '\n')
+			return len;
+		if (len + 1 < *n)
+			break;	/* EOF without a newline */
+		char *tmp = realloc(*lineptr, *n * 2);
+		if (!tmp)
+			break;
+		*lineptr = tmp;
+		*n *= 2;
 	}
 
-	(*lineptr)[++i] = 0;
-
-	return sizeof(*lineptr);
+	/* a last line without a newline is ignored */
+	(*lineptr)[0] = 0;
+	return -1;
 }
 
 #define SVFP_CMD_INC_CNT 1024
@@ -682,8 +859,8 @@ static int svf_read_command_from_file(FILE *fd)
 				 *  - terminating NUL ('\0')
 				 */
 				if (cmd_pos + 3 > svf_command_buffer_size) {
-					svf_command_buffer = realloc(svf_command_buffer, cmd_pos + 3);
-					svf_command_buffer_size = cmd_pos + 3;
+					svf_command_buffer_size = MAX(2 * svf_command_buffer_size, cmd_pos + 3);
+					svf_command_buffer = realloc(svf_command_buffer, svf_command_buffer_size);
 					if (svf_command_buffer == NULL) {
 						LOG_ERROR("not enough memory");
 						return ERROR_FAIL;
@@ -812,7 +989,7 @@ static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_l
 	for (i = 0; i < str_hbyte_len; i++) {
 		ch = 0;
 		while (str_len > 0) {
-			ch = str[--str_len];
+			int8_t val = svf_hex_value[(uint8_t)str[--str_len]];
 
 			/* Skip whitespace.  The SVF specification (rev E) is
 			 * deficient in terms of basic lexical issues like
@@ -820,20 +997,13 @@ static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_l
 			 * require line ends for correctness, since there is
 			 * a hard limit on line length.
 			 */
-			if (!isspace(ch)) {
-				if ((ch >= '0') && (ch <= '9')) {
-					ch = ch - '0';
-					break;
-				} else if ((ch >= 'A') && (ch <= 'F')) {
-					ch = ch - 'A' + 10;
-					break;
-				} else {
-					LOG_ERROR("invalid hex string");
-					return ERROR_FAIL;
-				}
+			if (val >= 0) {
+				ch = val;
+				break;
+			} else if (val == SVF_HEX_INVALID) {
+				LOG_ERROR("invalid hex string");
+				return ERROR_FAIL;
 			}
-
-			ch = 0;
 		}
 
 		/* write bin */
@@ -895,7 +1065,7 @@ static int svf_add_check_para(uint8_t enabled, int buffer_offset, int bit_len)
 		return ERROR_FAIL;
 	}
 
-	svf_check_tdo_para[svf_check_tdo_para_index].line_num = svf_line_number;
+	svf_check_tdo_para[svf_check_tdo_para_index].line_num = svf_run_line_number;
 	svf_check_tdo_para[svf_check_tdo_para_index].bit_len = bit_len;
 	svf_check_tdo_para[svf_check_tdo_para_index].enabled = enabled;
 	svf_check_tdo_para[svf_check_tdo_para_index].buffer_offset = buffer_offset;
@@ -313,6 +313,112 @@ int mem_ap_write_atomic_u32(struct adiv5_ap *ap, uint32_t address,
 	return dap_run(ap->dap);
 }
 
+static int mem_ap_item_csw_size(struct adiv5_ap *ap, uint32_t address, uint32_t size,
+		uint32_t *csw_size)
+{
+	if (size == 4)
+		*csw_size = CSW_32BIT;
+	else if (size == 2)
+		*csw_size = CSW_16BIT;
+	else if (size == 1)
+		*csw_size = CSW_8BIT;
+	else
+		return ERROR_TARGET_UNALIGNED_ACCESS;
+
+	if (ap->unaligned_access_bad && (address % size != 0))
+		return ERROR_TARGET_UNALIGNED_ACCESS;
+
+	return ERROR_OK;
+}
+
+/* DRW byte lane holding the byte at @a address, see mem_ap_read() and
+ * mem_ap_write() for the TI BE-32 quirks */
+static unsigned mem_ap_item_lane(struct adiv5_ap *ap, uint32_t address)
+{
+	return ap->dap->ti_be_32_quirks ? 3 - (address & 3) : address & 3;
+}
+
+/**
+ * Asynchronous (queued) read of a single item of @a size bytes, which
+ * unlike mem_ap_read_u32() may be a byte or half-word.
+ *
+ * @param ap The MEM-AP to access.
+ * @param address Address of the item to read.
+ * @param size The access size, 1, 2 or 4.
+ * @param drw points to where the raw DRW value will be stored when the
+ *	transaction queue is flushed; pass it to mem_ap_item_from_drw()
+ *	then.
+ *
+ * @return ERROR_OK for success.  Otherwise a fault code.
+ */
+int mem_ap_read_item(struct adiv5_ap *ap, uint32_t address, uint32_t size,
+		uint32_t *drw)
+{
+	uint32_t csw_size;
+	int retval = mem_ap_item_csw_size(ap, address, size, &csw_size);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = mem_ap_setup_transfer(ap, csw_size | CSW_ADDRINC_SINGLE, address);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = dap_queue_ap_read(ap, MEM_AP_REG_DRW, drw);
+	if (retval != ERROR_OK)
+		return retval;
+
+	mem_ap_update_tar_cache(ap);
+	return ERROR_OK;
+}
+
+/**
+ * Store the item read by mem_ap_read_item() from its raw DRW value
+ * into @a buffer, in target memory order.
+ */
+void mem_ap_item_from_drw(struct adiv5_ap *ap, uint32_t address, uint32_t size,
+		uint32_t drw, uint8_t *buffer)
+{
+	for (uint32_t i = 0; i < size; i++)
+		buffer[i] = drw >> 8 * mem_ap_item_lane(ap, address + i);
+}
+
+/**
+ * Asynchronous (queued) write of a single item of @a size bytes, which
+ * unlike mem_ap_write_u32() may be a byte or half-word.
+ *
+ * @param ap The MEM-AP to access.
+ * @param address Address of the item to write.
+ * @param size The access size, 1, 2 or 4.
+ * @param buffer The item, in target memory order.
+ *
+ * @return ERROR_OK for success.  Otherwise a fault code.
+ */
+int mem_ap_write_item(struct adiv5_ap *ap, uint32_t address, uint32_t size,
+		const uint8_t *buffer)
+{
+	uint32_t csw_size;
+	int retval = mem_ap_item_csw_size(ap, address, size, &csw_size);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* TI BE-32 quirks: sub-word writes land at TAR ^ (4 - size) */
+	uint32_t addr_xor = ap->dap->ti_be_32_quirks ? (4 - size) & 3 : 0;
+	retval = mem_ap_setup_transfer(ap, csw_size | CSW_ADDRINC_SINGLE, address ^ addr_xor);
+	if (retval != ERROR_OK)
+		return retval;
+
+	uint32_t outvalue = 0;
+	for (uint32_t i = 0; i < size; i++)
+		outvalue |= (uint32_t)buffer[i] << 8 * mem_ap_item_lane(ap, address + i);
+
+	retval = dap_queue_ap_write(ap, MEM_AP_REG_DRW, outvalue);
+	if (retval != ERROR_OK)
+		return retval;
+
+	mem_ap_update_tar_cache(ap);
+	return ERROR_OK;
+}
+
 /**
  * Synchronous write of a block of memory, using a specific access size.
  *
@@ -496,6 +496,14 @@ int mem_ap_read_u32(struct adiv5_ap *ap,
 int mem_ap_write_u32(struct adiv5_ap *ap,
 		uint32_t address, uint32_t value);
 
+/* Queued single-item MEM-AP access of any size. */
+int mem_ap_read_item(struct adiv5_ap *ap, uint32_t address, uint32_t size,
+		uint32_t *drw);
+void mem_ap_item_from_drw(struct adiv5_ap *ap, uint32_t address, uint32_t size,
+		uint32_t drw, uint8_t *buffer);
+int mem_ap_write_item(struct adiv5_ap *ap, uint32_t address, uint32_t size,
+		const uint8_t *buffer);
+
 /* Synchronous MEM-AP memory mapped single word transfers. */
 int mem_ap_read_atomic_u32(struct adiv5_ap *ap,
 		uint32_t address, uint32_t *value);
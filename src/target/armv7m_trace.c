@@ -19,34 +19,297 @@
 #include "config.h"
 #endif
 
+#include <pthread.h>
 #include <target/target.h>
 #include <target/armv7m.h>
 #include <target/cortex_m.h>
 #include <target/armv7m_trace.h>
 #include <jtag/interface.h>
+#include <helper/time_support.h>
 
 #define TRACE_BUF_SIZE	4096
 
+/* Adapter reads per timer tick while the adapter keeps returning full buffers */
+#define TRACE_POLL_MAX_READS	64
+
+/* The capture ring holds this many seconds of trace at the port rate */
+#define TRACE_RING_SECONDS	2
+#define TRACE_RING_MIN_SIZE	(64 * 1024)
+#define TRACE_RING_MAX_SIZE	(64 * 1024 * 1024)
+
+#define ITM_STIM_PORTS_NUM	32
+
+/*
+ * Trace data is captured into a ring buffer by the timer callback and
+ * written out by a separate thread, so slow file or pipe writes don't
+ * stall the adapter polling.
+ */
+struct armv7m_trace_sink {
+	pthread_t writer;
+	pthread_mutex_t mux;
+	pthread_cond_t cond;
+	bool running;
+
+	uint8_t *ring;
+	size_t ring_size;
+	/* free running counters, the ring index is the counter modulo ring_size */
+	uint64_t head;
+	uint64_t tail;
+
+	uint64_t captured;
+	uint64_t dropped;
+	size_t high_water;
+	int64_t last_drop_report;
+
+	FILE *file;
+
+	/* errors seen by the writer thread, which must not log; they are
+	 * reported once by the main thread */
+	bool write_failed;
+	bool write_failed_reported;
+	uint32_t port_open_failed;
+	uint32_t port_open_reported;
+
+	/* ITM stimulus port demultiplexer, only touched by the writer thread */
+	const char *demux_prefix;
+	FILE *port_files[ITM_STIM_PORTS_NUM];
+	unsigned int itm_left;
+	int itm_port;
+	bool itm_cont;
+	bool itm_prev_zero;
+};
+
+static FILE *itm_demux_port_file(struct armv7m_trace_sink *sink, unsigned int port)
+{
+	if (!sink->port_files[port]) {
+		/* don't retry for every payload byte */
+		if (__atomic_load_n(&sink->port_open_failed, __ATOMIC_RELAXED) & (1u << port))
+			return NULL;
+		char *name = alloc_printf("%s.%u", sink->demux_prefix, port);
+		if (name)
+			sink->port_files[port] = fopen(name, "ab");
+		if (!sink->port_files[port])
+			__atomic_or_fetch(&sink->port_open_failed, 1u << port, __ATOMIC_RELAXED);
+		free(name);
+	}
+	return sink->port_files[port];
+}
+
+/*
+ * Split the software source (stimulus port) payloads out of an ITM packet
+ * stream. Hardware source, timestamp, extension and sync packets are skipped.
+ */
+static void itm_demux_feed(struct armv7m_trace_sink *sink, const uint8_t *buf, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		uint8_t b = buf[i];
+
+		if (sink->itm_left) {
+			if (sink->itm_port >= 0) {
+				FILE *f = itm_demux_port_file(sink, sink->itm_port);
+				if (f)
+					fputc(b, f);
+			}
+			sink->itm_left--;
+			continue;
+		}
+		if (sink->itm_cont) {
+			sink->itm_cont = b & 0x80;
+			continue;
+		}
+
+		bool prev_zero = sink->itm_prev_zero;
+		sink->itm_prev_zero = (b == 0);
+		if ((b & 0x03) == 0) {
+			/* protocol packet; 0x80 after zeroes terminates a sync packet */
+			if ((b & 0x80) && !(b == 0x80 && prev_zero))
+				sink->itm_cont = true;
+			continue;
+		}
+		sink->itm_left = (b & 0x03) == 3 ? 4 : (b & 0x03);
+		sink->itm_port = (b & 0x04) ? -1 : (b >> 3);
+	}
+}
+
+static void armv7m_trace_sink_flush(struct armv7m_trace_sink *sink)
+{
+	if (sink->file)
+		fflush(sink->file);
+	for (unsigned int i = 0; i < ITM_STIM_PORTS_NUM; i++) {
+		if (sink->port_files[i])
+			fflush(sink->port_files[i]);
+	}
+}
+
+static void *armv7m_trace_sink_writer(void *arg)
+{
+	struct armv7m_trace_sink *sink = arg;
+
+	pthread_mutex_lock(&sink->mux);
+	while (true) {
+		if (sink->head == sink->tail) {
+			if (!sink->running)
+				break;
+			pthread_mutex_unlock(&sink->mux);
+			armv7m_trace_sink_flush(sink);
+			pthread_mutex_lock(&sink->mux);
+			while (sink->running && sink->head == sink->tail)
+				pthread_cond_wait(&sink->cond, &sink->mux);
+			continue;
+		}
+		size_t offset = sink->tail % sink->ring_size;
+		size_t size = MIN(sink->head - sink->tail, sink->ring_size - offset);
+		pthread_mutex_unlock(&sink->mux);
+
+		/* the producer never touches the used part of the ring */
+		if (sink->file && fwrite(sink->ring + offset, 1, size, sink->file) != size)
+			__atomic_store_n(&sink->write_failed, true, __ATOMIC_RELAXED);
+		if (sink->demux_prefix)
+			itm_demux_feed(sink, sink->ring + offset, size);
+
+		pthread_mutex_lock(&sink->mux);
+		sink->tail += size;
+	}
+	pthread_mutex_unlock(&sink->mux);
+
+	return NULL;
+}
+
+/* main thread only */
+static void armv7m_trace_sink_report_errors(struct armv7m_trace_sink *sink)
+{
+	if (!sink->write_failed_reported && __atomic_load_n(&sink->write_failed, __ATOMIC_RELAXED)) {
+		LOG_ERROR("Error writing to the trace destination file");
+		sink->write_failed_reported = true;
+	}
+
+	uint32_t failed = __atomic_load_n(&sink->port_open_failed, __ATOMIC_RELAXED);
+	uint32_t new_failed = failed & ~sink->port_open_reported;
+	for (unsigned int port = 0; new_failed; port++, new_failed >>= 1) {
+		if (new_failed & 1)
+			LOG_ERROR("Can't open ITM port %u destination file %s.%u",
+				port, sink->demux_prefix, port);
+	}
+	sink->port_open_reported = failed;
+}
+
+static void armv7m_trace_sink_put(struct armv7m_trace_sink *sink, const uint8_t *buf, size_t size)
+{
+	pthread_mutex_lock(&sink->mux);
+	size_t used = sink->head - sink->tail;
+	size_t n = MIN(size, sink->ring_size - used);
+	size_t offset = sink->head % sink->ring_size;
+	size_t first = MIN(n, sink->ring_size - offset);
+
+	memcpy(sink->ring + offset, buf, first);
+	memcpy(sink->ring, buf + first, n - first);
+	sink->head += n;
+	sink->captured += size;
+	sink->dropped += size - n;
+	if (used + n > sink->high_water)
+		sink->high_water = used + n;
+	pthread_cond_signal(&sink->cond);
+	pthread_mutex_unlock(&sink->mux);
+
+	armv7m_trace_sink_report_errors(sink);
+
+	if (n < size && timeval_ms() - sink->last_drop_report >= 1000) {
+		sink->last_drop_report = timeval_ms();
+		LOG_WARNING("Trace buffer overflow, %" PRIu64 " bytes dropped so far",
+			sink->dropped);
+	}
+}
+
+static int armv7m_trace_sink_start(struct armv7m_common *armv7m)
+{
+	struct armv7m_trace_config *trace_config = &armv7m->trace_config;
+	struct armv7m_trace_sink *sink = calloc(1, sizeof(*sink));
+	if (!sink) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	/* UART coding needs 10 bit times per byte, sync ports are faster but rarely used */
+	size_t ring_size = (size_t)trace_config->trace_freq / 10 * TRACE_RING_SECONDS;
+	if (trace_config->pin_protocol == TPIU_PIN_PROTOCOL_SYNC)
+		ring_size = (size_t)trace_config->trace_freq / 8 * trace_config->port_size *
+			TRACE_RING_SECONDS;
+	sink->ring_size = MIN(MAX(ring_size, TRACE_RING_MIN_SIZE), TRACE_RING_MAX_SIZE);
+	sink->ring = malloc(sink->ring_size);
+	if (!sink->ring) {
+		LOG_ERROR("Can't allocate %zu bytes of trace buffer", sink->ring_size);
+		free(sink);
+		return ERROR_FAIL;
+	}
+	sink->file = trace_config->trace_file;
+	sink->demux_prefix = trace_config->itm_demux_prefix;
+	sink->running = true;
+	pthread_mutex_init(&sink->mux, NULL);
+	pthread_cond_init(&sink->cond, NULL);
+	if (pthread_create(&sink->writer, NULL, armv7m_trace_sink_writer, sink)) {
+		LOG_ERROR("Can't start trace writer thread");
+		pthread_cond_destroy(&sink->cond);
+		pthread_mutex_destroy(&sink->mux);
+		free(sink->ring);
+		free(sink);
+		return ERROR_FAIL;
+	}
+	LOG_DEBUG("Trace buffer of %zu bytes", sink->ring_size);
+
+	armv7m->trace_config.sink = sink;
+	return ERROR_OK;
+}
+
+static void armv7m_trace_sink_stop(struct armv7m_common *armv7m)
+{
+	struct armv7m_trace_sink *sink = armv7m->trace_config.sink;
+	if (!sink)
+		return;
+
+	/* the writer drains the ring before it exits */
+	pthread_mutex_lock(&sink->mux);
+	sink->running = false;
+	pthread_cond_signal(&sink->cond);
+	pthread_mutex_unlock(&sink->mux);
+	pthread_join(sink->writer, NULL);
+
+	armv7m_trace_sink_flush(sink);
+	armv7m_trace_sink_report_errors(sink);
+	for (unsigned int i = 0; i < ITM_STIM_PORTS_NUM; i++) {
+		if (sink->port_files[i])
+			fclose(sink->port_files[i]);
+	}
+	if (sink->dropped)
+		LOG_WARNING("%" PRIu64 " of %" PRIu64 " trace bytes were dropped",
+			sink->dropped, sink->captured);
+	pthread_cond_destroy(&sink->cond);
+	pthread_mutex_destroy(&sink->mux);
+	free(sink->ring);
+	free(sink);
+	armv7m->trace_config.sink = NULL;
+}
+
 static int armv7m_poll_trace(void *target)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 	uint8_t buf[TRACE_BUF_SIZE];
-	size_t size = sizeof(buf);
 	int retval;
 
-	retval = adapter_poll_trace(buf, &size);
-	if (retval != ERROR_OK || !size)
-		return retval;
+	/* a full buffer means more data is likely waiting in the adapter */
+	for (unsigned int i = 0; i < TRACE_POLL_MAX_READS; i++) {
+		size_t size = sizeof(buf);
 
-	target_call_trace_callbacks(target, size, buf);
+		retval = adapter_poll_trace(buf, &size);
+		if (retval != ERROR_OK || !size)
+			return retval;
 
-	if (armv7m->trace_config.trace_file != NULL) {
-		if (fwrite(buf, 1, size, armv7m->trace_config.trace_file) == size)
-			fflush(armv7m->trace_config.trace_file);
-		else {
-			LOG_ERROR("Error writing to the trace destination file");
-			return ERROR_FAIL;
-		}
+		target_call_trace_callbacks(target, size, buf);
+
+		if (armv7m->trace_config.sink)
+			armv7m_trace_sink_put(armv7m->trace_config.sink, buf, size);
+
+		if (size < sizeof(buf))
+			break;
 	}
 
 	return ERROR_OK;
@@ -60,7 +323,7 @@ int armv7m_trace_tpiu_config(struct target *target)
 	int retval;
 
 	target_unregister_timer_callback(armv7m_poll_trace, target);
-
+	armv7m_trace_sink_stop(armv7m);
 
 	retval = adapter_config_trace(trace_config->config_type == TRACE_CONFIG_TYPE_INTERNAL,
 				      trace_config->pin_protocol,
@@ -115,9 +378,17 @@ int armv7m_trace_tpiu_config(struct target *target)
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (trace_config->config_type == TRACE_CONFIG_TYPE_INTERNAL)
+	if (trace_config->config_type == TRACE_CONFIG_TYPE_INTERNAL) {
+		if (trace_config->trace_file || trace_config->itm_demux_prefix) {
+			if (trace_config->itm_demux_prefix && trace_config->formatter)
+				LOG_WARNING("ITM demultiplexing needs the TPIU formatter disabled");
+			retval = armv7m_trace_sink_start(armv7m);
+			if (retval != ERROR_OK)
+				return retval;
+		}
 		target_register_timer_callback(armv7m_poll_trace, 1,
 		TARGET_TIMER_TYPE_PERIODIC, target);
+	}
 
 	target_call_event_callbacks(target, TARGET_EVENT_TRACE_CONFIG);
 
@@ -156,11 +427,23 @@ int armv7m_trace_itm_config(struct target *target)
 
 static void close_trace_file(struct armv7m_common *armv7m)
 {
+	armv7m_trace_sink_stop(armv7m);
 	if (armv7m->trace_config.trace_file)
 		fclose(armv7m->trace_config.trace_file);
 	armv7m->trace_config.trace_file = NULL;
 }
 
+void armv7m_trace_deinit(struct target *target)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+
+	/* write out what is still buffered before the files are closed */
+	target_unregister_timer_callback(armv7m_poll_trace, target);
+	close_trace_file(armv7m);
+	free(armv7m->trace_config.itm_demux_prefix);
+	armv7m->trace_config.itm_demux_prefix = NULL;
+}
+
 COMMAND_HANDLER(handle_tpiu_config_command)
 {
 	struct target *target = get_current_target(CMD_CTX);
@@ -301,6 +584,30 @@ COMMAND_HANDLER(handle_itm_ports_command)
 		return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_tpiu_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct armv7m_trace_sink *sink = armv7m->trace_config.sink;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!sink) {
+		command_print(CMD, "Trace capture buffer is not active");
+		return ERROR_OK;
+	}
+
+	pthread_mutex_lock(&sink->mux);
+	command_print(CMD, "captured %" PRIu64 " bytes, written %" PRIu64 " bytes, dropped %" PRIu64
+		" bytes, buffer %zu/%zu bytes used (max %zu)",
+		sink->captured, sink->tail, sink->dropped,
+		(size_t)(sink->head - sink->tail), sink->ring_size, sink->high_water);
+	pthread_mutex_unlock(&sink->mux);
+
+	return ERROR_OK;
+}
+
 static const struct command_registration tpiu_command_handlers[] = {
 	{
 		.name = "config",
@@ -312,9 +619,49 @@ static const struct command_registration tpiu_command_handlers[] = {
 		"(sync <port width> | ((manchester | uart) <formatter enable>)) "
 		"<TRACECLKIN freq> [<trace freq>]))",
 	},
+	{
+		.name = "stats",
+		.handler = handle_tpiu_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "Show trace capture buffer statistics",
+		.usage = "",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
+COMMAND_HANDLER(handle_itm_demux_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct armv7m_trace_config *trace_config = &armv7m->trace_config;
+
+	if (CMD_ARGC == 0) {
+		command_print(CMD, "ITM demultiplexing is %s%s",
+			trace_config->itm_demux_prefix ? "on, prefix " : "off",
+			trace_config->itm_demux_prefix ? trace_config->itm_demux_prefix : "");
+		return ERROR_OK;
+	}
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	/* the capture thread holds the prefix, takes effect with the next tpiu config */
+	if (armv7m->trace_config.sink) {
+		command_print(CMD, "Can't change ITM demultiplexing while trace is captured");
+		return ERROR_FAIL;
+	}
+	free(trace_config->itm_demux_prefix);
+	trace_config->itm_demux_prefix = NULL;
+	if (strcmp(CMD_ARGV[0], "off") != 0) {
+		trace_config->itm_demux_prefix = strdup(CMD_ARGV[0]);
+		if (!trace_config->itm_demux_prefix) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static const struct command_registration itm_command_handlers[] = {
 	{
 		.name = "port",
@@ -330,6 +677,13 @@ static const struct command_registration itm_command_handlers[] = {
 		.help = "Enable or disable all ITM stimulus ports",
 		.usage = "(0|1|on|off)",
 	},
+	{
+		.name = "demux",
+		.handler = handle_itm_demux_command,
+		.mode = COMMAND_ANY,
+		.help = "Write the data of each ITM stimulus port to its own file",
+		.usage = "[<file prefix> | off]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -26,6 +26,8 @@
  * Holds the interface to TPIU, ITM and DWT configuration functions.
  */
 
+struct armv7m_trace_sink;
+
 enum trace_config_type {
 	TRACE_CONFIG_TYPE_DISABLED,	/**< tracing is disabled */
 	TRACE_CONFIG_TYPE_EXTERNAL,	/**< trace output is captured externally */
@@ -75,6 +77,10 @@ struct armv7m_trace_config {
 	unsigned int trace_freq;
 	/** Handle to output trace data in INTERNAL capture mode */
 	FILE *trace_file;
+	/** File name prefix for per stimulus port output, NULL to disable */
+	char *itm_demux_prefix;
+	/** Capture buffer and writer thread in INTERNAL capture mode */
+	struct armv7m_trace_sink *sink;
 };
 
 extern const struct command_registration armv7m_trace_command_handlers[];
@@ -87,5 +93,9 @@ int armv7m_trace_tpiu_config(struct target *target);
  * Configure hardware accordingly to the current ITM target settings
  */
 int armv7m_trace_itm_config(struct target *target);
+/**
+ * Stop trace capture, flush and close the trace files
+ */
+void armv7m_trace_deinit(struct target *target);
 
 #endif /* OPENOCD_TARGET_ARMV7M_TRACE_H */
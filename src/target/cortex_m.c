@@ -1788,6 +1788,56 @@ static int cortex_m_write_memory(struct target *target, target_addr_t address,
 	return mem_ap_write_buf(armv7m->debug_ap, buffer, size, count, address);
 }
 
+static int cortex_m_mem_batch(struct target *target, struct target_mem_op *ops,
+	unsigned int count)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct adiv5_ap *ap = armv7m->debug_ap;
+	int retval = ERROR_OK;
+
+	uint32_t *drw = calloc(count, sizeof(uint32_t));
+	if (!drw && count) {
+		LOG_ERROR("Failed to allocate read buffer");
+		return ERROR_FAIL;
+	}
+
+	/* queue every access, then run the DAP queue once */
+	for (unsigned int i = 0; i < count; i++) {
+		uint32_t address = ops[i].address;
+		uint32_t size = ops[i].size;
+
+		if (armv7m->arm.is_armv6m && (address & (size - 1))) {
+			/* armv6m does not handle unaligned memory access */
+			retval = ERROR_TARGET_UNALIGNED_ACCESS;
+			break;
+		}
+
+		if (ops[i].write)
+			retval = mem_ap_write_item(ap, address, size, ops[i].data);
+		else
+			retval = mem_ap_read_item(ap, address, size, &drw[i]);
+		if (retval != ERROR_OK)
+			break;
+	}
+
+	/* what has been queued runs even if a later access was refused */
+	int run_retval = dap_run(ap->dap);
+	if (retval == ERROR_OK)
+		retval = run_retval;
+
+	if (retval == ERROR_OK) {
+		for (unsigned int i = 0; i < count; i++) {
+			if (!ops[i].write)
+				mem_ap_item_from_drw(ap, ops[i].address, ops[i].size, drw[i], ops[i].data);
+		}
+	} else if (run_retval != ERROR_OK) {
+		LOG_ERROR("Failed batch of %u memory accesses", count);
+	}
+
+	free(drw);
+	return retval;
+}
+
 static int cortex_m_init_target(struct command_context *cmd_ctx,
 	struct target *target)
 {
@@ -1802,6 +1852,7 @@ void cortex_m_deinit_target(struct target *target)
 
 	free(cortex_m->fp_comparator_list);
 
+	armv7m_trace_deinit(target);
 	cortex_m_dwt_free(target);
 	armv7m_free_reg_cache(target);
 
@@ -2666,6 +2717,7 @@ struct target_type cortexm_target = {
 
 	.read_memory = cortex_m_read_memory,
 	.write_memory = cortex_m_write_memory,
+	.mem_batch = cortex_m_mem_batch,
 	.checksum_memory = armv7m_checksum_memory,
 	.blank_check_memory = armv7m_blank_check_memory,
 
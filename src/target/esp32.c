@@ -622,6 +622,7 @@ static struct target_type esp32_xtensa_core_target_type = {
 
 	.read_buffer = xtensa_read_buffer,
 	.write_buffer = xtensa_write_buffer,
+	.mem_batch = xtensa_mem_batch,
 
 	.checksum_memory = xtensa_checksum_memory,
 
@@ -663,7 +664,8 @@ static struct xtensa_core_ops esp32_xtensa_mcores_ops = {
 
 static struct esp_xtensa_special_breakpoint_ops esp32_xtensa_spec_brp_ops = {
 	.breakpoint_add = esp_xtensa_flash_breakpoint_add,
-	.breakpoint_remove = esp_xtensa_flash_breakpoint_remove
+	.breakpoint_remove = esp_xtensa_flash_breakpoint_remove,
+	.breakpoints_flush = esp_xtensa_flash_breakpoints_flush
 };
 
 static const struct xtensa_chip_ops esp32_chip_ops = {
@@ -828,6 +830,89 @@ static const struct command_registration esp32_command_handlers[] = {
 	COMMAND_REGISTRATION_DONE
 };
 
+static int esp32_read_memory(struct target *target,
+	target_addr_t address,
+	uint32_t size,
+	uint32_t count,
+	uint8_t *buffer)
+{
+	struct xtensa_mcore_common *xtensa_mcore = target_to_xtensa_mcore(target);
+
+	int ret = xtensa_mcore_read_memory(target, address, size, count, buffer);
+	if (ret != ERROR_OK)
+		return ret;
+	/* flash BPs are kept by the core they were added through, not the active one */
+	for (size_t i = 0; i < xtensa_mcore->configured_cores_num; i++)
+		esp_xtensa_special_breakpoints_unpatch(&xtensa_mcore->cores_targets[i],
+			address, size * count, buffer);
+	return ERROR_OK;
+}
+
+static int esp32_read_buffer(struct target *target,
+	target_addr_t address,
+	uint32_t count,
+	uint8_t *buffer)
+{
+	return esp32_read_memory(target, address, 1, count, buffer);
+}
+
+static int esp32_mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count)
+{
+	struct xtensa_mcore_common *xtensa_mcore = target_to_xtensa_mcore(target);
+
+	int ret = xtensa_mcore_mem_batch(target, ops, count);
+	if (ret != ERROR_OK)
+		return ret;
+	for (unsigned int i = 0; i < count; i++) {
+		if (ops[i].write)
+			continue;
+		for (size_t k = 0; k < xtensa_mcore->configured_cores_num; k++)
+			esp_xtensa_special_breakpoints_unpatch(&xtensa_mcore->cores_targets[k],
+				ops[i].address, ops[i].size, ops[i].data);
+	}
+	return ERROR_OK;
+}
+
+/* Flash BPs are kept by the core they were added through, apply them all
+ * before any core runs */
+static int esp32_special_breakpoints_flush(struct target *target)
+{
+	struct xtensa_mcore_common *xtensa_mcore = target_to_xtensa_mcore(target);
+
+	for (size_t i = 0; i < xtensa_mcore->configured_cores_num; i++) {
+		int ret = esp_xtensa_special_breakpoints_flush(&xtensa_mcore->cores_targets[i]);
+		if (ret != ERROR_OK)
+			return ret;
+	}
+	return ERROR_OK;
+}
+
+static int esp32_resume(struct target *target,
+	int current,
+	target_addr_t address,
+	int handle_breakpoints,
+	int debug_execution)
+{
+	/* flash BPs belong to the user program, not to algorithms run by OpenOCD */
+	if (!debug_execution) {
+		int ret = esp32_special_breakpoints_flush(target);
+		if (ret != ERROR_OK)
+			return ret;
+	}
+	return xtensa_mcore_resume(target, current, address, handle_breakpoints, debug_execution);
+}
+
+static int esp32_step(struct target *target,
+	int current,
+	target_addr_t address,
+	int handle_breakpoints)
+{
+	int ret = esp32_special_breakpoints_flush(target);
+	if (ret != ERROR_OK)
+		return ret;
+	return xtensa_mcore_step(target, current, address, handle_breakpoints);
+}
+
 /** Holds methods for Xtensa targets. */
 struct target_type esp32_target = {
 	.name = "esp32",
@@ -836,19 +921,20 @@ struct target_type esp32_target = {
 	.arch_state = esp32_arch_state,
 
 	.halt = xtensa_mcore_halt,
-	.resume = xtensa_mcore_resume,
-	.step = xtensa_mcore_step,
+	.resume = esp32_resume,
+	.step = esp32_step,
 
 	.assert_reset = esp32_assert_reset,
 	.deassert_reset = xtensa_mcore_deassert_reset,
 
 	.virt2phys = esp32_virt2phys,
 	.mmu = xtensa_mcore_mmu,
-	.read_memory = xtensa_mcore_read_memory,
+	.read_memory = esp32_read_memory,
 	.write_memory = xtensa_mcore_write_memory,
 
-	.read_buffer = xtensa_mcore_read_buffer,
+	.read_buffer = esp32_read_buffer,
 	.write_buffer = xtensa_mcore_write_buffer,
+	.mem_batch = esp32_mem_batch,
 
 	.checksum_memory = xtensa_mcore_checksum_memory,
 
@@ -2384,6 +2384,39 @@ static int esp_gcov_ftell(struct esp32_gcov_cmd_data *cmd_data,
 	return ERROR_OK;
 }
 
+/* Sends a reply to the request which has just been received from the target. */
+static int esp32_apptrace_usr_resp_write(struct esp32_apptrace_cmd_ctx *ctx,
+	const uint8_t *resp,
+	uint32_t resp_len)
+{
+	struct esp32_apptrace_target_state target_state[ESP_APPTRACE_MAX_CORES_NUM];
+	uint32_t fired_target_num = 0;
+	/* get current block id */
+	int res = esp32_apptrace_get_data_info(ctx, target_state, &fired_target_num);
+	if (res != ERROR_OK) {
+		LOG_ERROR("Failed to read target data info!");
+		return res;
+	}
+	if (fired_target_num == (uint32_t)-1) {
+		/* it can happen that there is no pending target data, but block was
+		 * switched */
+		/* in this case block_ids on both CPUs are equal, so select the first one */
+		fired_target_num = 0;
+	}
+	/* write response */
+	res =
+		esp_xtensa_apptrace_usr_block_write(ctx->cpus[fired_target_num],
+		target_state[fired_target_num].block_id,
+		resp,
+		resp_len);
+	if (res != ERROR_OK) {
+		LOG_ERROR("Failed to write data to (%s)!",
+			target_name(ctx->cpus[fired_target_num]));
+		return res;
+	}
+	return ERROR_OK;
+}
+
 /*TODO: support for multi-block data transfers */
 static int esp_gcov_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 	int core_id,
@@ -2432,34 +2465,9 @@ static int esp_gcov_process_data(struct esp32_apptrace_cmd_ctx *ctx,
 		return ret;
 
 	if (resp_len) {
-		struct esp32_apptrace_target_state target_state[ESP_APPTRACE_MAX_CORES_NUM];
-		uint32_t fired_target_num = 0;
-		/* get current block id */
-		int res = esp32_apptrace_get_data_info(ctx, target_state, &fired_target_num);
-		if (res != ERROR_OK) {
-			LOG_ERROR("Failed to read target data info!");
-			free(resp);
-			return res;
-		}
-		if (fired_target_num == (uint32_t)-1) {
-			/* it can happen that there is no pending target data, but block was
-			 * switched */
-			/* in this case block_ids on both CPUs are equal, so select the first one */
-			fired_target_num = 0;
-		}
-		/* write response */
-		res =
-			esp_xtensa_apptrace_usr_block_write(ctx->cpus[fired_target_num],
-			target_state[fired_target_num].block_id,
-			resp,
-			resp_len);
-		if (res != ERROR_OK) {
-			LOG_ERROR("Failed to write data to (%s)!",
-				target_name(ctx->cpus[fired_target_num]));
-			free(resp);
-			return res;
-		}
+		int res = esp32_apptrace_usr_resp_write(ctx, resp, resp_len);
 		free(resp);
+		return res;
 	}
 
 	return ERROR_OK;
@@ -2564,6 +2572,237 @@ COMMAND_HANDLER(esp32_cmd_gcov)
 	return res;
 }
 
+/*********************************************************************
+*                    Semihosting over apptrace
+**********************************************************************/
+
+/* Request is [u8 ESP_SYS_* code][u32 args][data], args are:
+ *   ESP_SYS_OPEN:  flags, name follows
+ *   ESP_SYS_CLOSE: fd
+ *   ESP_SYS_WRITE: fd, data follows
+ *   ESP_SYS_READ:  fd, len
+ *   ESP_SYS_SEEK:  fd, offset, whence
+ * Response is [s32 ret][s32 errno] followed by the data for ESP_SYS_READ. */
+#define ESP_SEMIHOST_ARGS_MAX_NUM       3
+#define ESP_SEMIHOST_RESP_HDR_SZ        (2*sizeof(int32_t))
+
+struct esp32_semihost_cmd_data {
+	uint32_t calls;
+	uint32_t errors;
+	uint64_t bytes_written;
+	uint64_t bytes_read;
+};
+
+static int esp_semihost_process_data(struct esp32_apptrace_cmd_ctx *ctx,
+	int core_id,
+	uint8_t *data,
+	uint32_t data_len)
+{
+	struct esp32_semihost_cmd_data *cmd_data = ctx->cmd_priv;
+	struct target *core_target = ctx->cpus[core_id < ctx->cores_num ? core_id : 0];
+	uint32_t args[ESP_SEMIHOST_ARGS_MAX_NUM];
+	uint32_t args_num;
+	int32_t ret = -1, err = EINVAL;
+
+	if (data_len < 1) {
+		LOG_ERROR("Too small data length %d!", data_len);
+		return ERROR_FAIL;
+	}
+	switch (data[0]) {
+		case ESP_SYS_OPEN:
+		case ESP_SYS_CLOSE:
+		case ESP_SYS_WRITE:
+			args_num = 1;
+			break;
+		case ESP_SYS_READ:
+			args_num = 2;
+			break;
+		case ESP_SYS_SEEK:
+			args_num = 3;
+			break;
+		default:
+			LOG_WARNING("Unsupported syscall %x!", data[0]);
+			args_num = 0;
+	}
+	uint32_t hdr_len = 1 + args_num*sizeof(uint32_t);
+	if (data_len < hdr_len) {
+		LOG_ERROR("Missed args for syscall %x!", data[0]);
+		args_num = 0;
+	}
+	memcpy(args, data + 1, args_num*sizeof(uint32_t));
+
+	uint32_t resp_len = ESP_SEMIHOST_RESP_HDR_SZ;
+	if (args_num && data[0] == ESP_SYS_READ) {
+		uint32_t max_len = esp_xtensa_apptrace_usr_block_max_size_get(core_target) -
+			ESP_SEMIHOST_RESP_HDR_SZ;
+		if (args[1] > max_len)
+			args[1] = max_len;
+		resp_len += args[1];
+	}
+	uint8_t *resp = malloc(resp_len);
+	if (!resp) {
+		LOG_ERROR("Failed to alloc mem for resp!");
+		return ERROR_FAIL;
+	}
+
+	if (args_num == 0)
+		goto send_resp;
+	if (data[0] != ESP_SYS_OPEN && args[0] <= ESP_FD_MIN) {
+		LOG_ERROR("Invalid file desc %d!", args[0]);
+		goto send_resp;
+	}
+	switch (data[0]) {
+		case ESP_SYS_OPEN:
+			ret = esp_xtensa_semihost_open(target_to_esp_xtensa(core_target),
+				(const char *)data + hdr_len, data_len - hdr_len, args[0], &err);
+			break;
+		case ESP_SYS_CLOSE:
+			ret = close(args[0]);
+			err = errno;
+			LOG_DEBUG("Close file %d. Ret %d. Error %d.", args[0], ret, err);
+			break;
+		case ESP_SYS_WRITE:
+			ret = write(args[0], data + hdr_len, data_len - hdr_len);
+			err = errno;
+			if (ret > 0)
+				cmd_data->bytes_written += ret;
+			LOG_DEBUG("Wrote file %d. %d bytes.", args[0], ret);
+			break;
+		case ESP_SYS_READ:
+			ret = read(args[0], resp + ESP_SEMIHOST_RESP_HDR_SZ, args[1]);
+			err = errno;
+			if (ret > 0)
+				cmd_data->bytes_read += ret;
+			LOG_DEBUG("Read file %d. %d bytes.", args[0], ret);
+			break;
+		case ESP_SYS_SEEK:
+			ret = lseek(args[0], (int32_t)args[1], args[2]);
+			err = errno;
+			LOG_DEBUG("Seek file %d. To %x, mode %d.", args[0], args[1], args[2]);
+			break;
+	}
+
+send_resp:
+	cmd_data->calls++;
+	if (ret < 0)
+		cmd_data->errors++;
+	else
+		err = 0;
+	resp_len = ESP_SEMIHOST_RESP_HDR_SZ;
+	if (data[0] == ESP_SYS_READ && ret > 0)
+		resp_len += ret;
+	memcpy(resp, &ret, sizeof(ret));
+	memcpy(resp + sizeof(ret), &err, sizeof(err));
+	int res = esp32_apptrace_usr_resp_write(ctx, resp, resp_len);
+	free(resp);
+	return res;
+}
+
+static void esp_semihost_print_stats(struct command_invocation *cmd,
+	struct esp32_apptrace_cmd_ctx *ctx)
+{
+	struct esp32_semihost_cmd_data *cmd_data = ctx->cmd_priv;
+
+	command_print(cmd, "Apptrace semihosting is %s.", ctx->running ? "RUNNING" : "STOPPED");
+	if (!cmd_data)
+		return;
+	command_print(cmd, "Calls %u, failed %u, written %" PRIu64 " bytes, read %" PRIu64 " bytes",
+		cmd_data->calls,
+		cmd_data->errors,
+		cmd_data->bytes_written,
+		cmd_data->bytes_read);
+}
+
+static int esp_semihost_cmd_cleanup(struct esp32_apptrace_cmd_ctx *cmd_ctx)
+{
+	free(cmd_ctx->cmd_priv);
+	esp32_apptrace_cmd_ctx_cleanup(cmd_ctx);
+	memset(cmd_ctx, 0, sizeof(*cmd_ctx));
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(esp32_cmd_semihost_apptrace)
+{
+	static struct esp32_apptrace_cmd_ctx s_sh_cmd_ctx;
+	struct target *target = get_current_target(CMD_CTX);
+	enum target_state old_state = target->state;
+	int res;
+
+	if (CMD_ARGC < 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (strcmp(CMD_ARGV[0], "start") == 0) {
+		uint32_t poll_period = 1;	/* ms */
+		if (CMD_ARGC > 1)
+			COMMAND_PARSE_NUMBER(u32, CMD_ARGV[1], poll_period);
+		if (poll_period == 0) {
+			command_print(CMD, "Poll period must be at least 1 ms!");
+			return ERROR_COMMAND_ARGUMENT_INVALID;
+		}
+		if (s_sh_cmd_ctx.cmd_priv) {
+			command_print(CMD, "Apptrace semihosting is already started!");
+			return ERROR_FAIL;
+		}
+		res = esp32_apptrace_cmd_ctx_init(target, &s_sh_cmd_ctx, ESP_APPTRACE_CMD_MODE_SYNC);
+		if (res != ERROR_OK) {
+			LOG_ERROR("Failed to init cmd ctx (%d)!", res);
+			return res;
+		}
+		s_sh_cmd_ctx.process_data = esp_semihost_process_data;
+		s_sh_cmd_ctx.cmd_priv = calloc(1, sizeof(struct esp32_semihost_cmd_data));
+		if (!s_sh_cmd_ctx.cmd_priv) {
+			LOG_ERROR("Failed to alloc cmd data!");
+			esp32_apptrace_cmd_ctx_cleanup(&s_sh_cmd_ctx);
+			return ERROR_FAIL;
+		}
+		res = esp32_apptrace_connect_targets(&s_sh_cmd_ctx,
+			target,
+			true,
+			old_state == TARGET_RUNNING);
+		if (res != ERROR_OK) {
+			LOG_ERROR("Failed to connect to targets (%d)!", res);
+			esp_semihost_cmd_cleanup(&s_sh_cmd_ctx);
+			return res;
+		}
+		/* requests are serviced from the timer callback, the cores are never halted for them */
+		res = target_register_timer_callback(esp32_apptrace_poll,
+			poll_period,
+			1,
+			&s_sh_cmd_ctx);
+		if (res != ERROR_OK) {
+			LOG_ERROR("Failed to register target timer handler (%d)!", res);
+			esp32_apptrace_connect_targets(&s_sh_cmd_ctx, target, false,
+				old_state == TARGET_RUNNING);
+			esp_semihost_cmd_cleanup(&s_sh_cmd_ctx);
+			return res;
+		}
+	} else if (strcmp(CMD_ARGV[0], "stop") == 0) {
+		if (!s_sh_cmd_ctx.cmd_priv) {
+			command_print(CMD, "Apptrace semihosting is not started!");
+			return ERROR_FAIL;
+		}
+		res = target_unregister_timer_callback(esp32_apptrace_poll, &s_sh_cmd_ctx);
+		if (res != ERROR_OK) {
+			LOG_ERROR("Failed to unregister target timer handler (%d)!", res);
+			return res;
+		}
+		s_sh_cmd_ctx.running = 0;
+		res = esp32_apptrace_connect_targets(&s_sh_cmd_ctx,
+			target,
+			false,
+			old_state == TARGET_RUNNING);
+		if (res != ERROR_OK)
+			LOG_ERROR("Failed to disconnect targets (%d)!", res);
+		esp_semihost_print_stats(CMD, &s_sh_cmd_ctx);
+		esp_semihost_cmd_cleanup(&s_sh_cmd_ctx);
+	} else if (strcmp(CMD_ARGV[0], "status") == 0) {
+		esp_semihost_print_stats(CMD, &s_sh_cmd_ctx);
+	} else
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	return ERROR_OK;
+}
+
 const struct command_registration esp32_apptrace_command_handlers[] = {
 	{
 		.name = "apptrace",
@@ -2590,5 +2829,13 @@ const struct command_registration esp32_apptrace_command_handlers[] = {
 		.help = "GCOV: Dumps gcov info collected on target.",
 		.usage = "",
 	},
+	{
+		.name = "semihost_apptrace",
+		.handler = esp32_cmd_semihost_apptrace,
+		.mode = COMMAND_EXEC,
+		.help =
+			"Service semihosting requests sent over the apptrace channel while the target keeps running.",
+		.usage = "[start [poll_period]] | [stop] | [status]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -438,7 +438,8 @@ static const struct xtensa_power_ops esp32_s2_pwr_ops = {
 
 static const struct esp_xtensa_special_breakpoint_ops esp32_s2_spec_brp_ops = {
 	.breakpoint_add = esp_xtensa_flash_breakpoint_add,
-	.breakpoint_remove = esp_xtensa_flash_breakpoint_remove
+	.breakpoint_remove = esp_xtensa_flash_breakpoint_remove,
+	.breakpoints_flush = esp_xtensa_flash_breakpoints_flush
 };
 
 static const struct xtensa_chip_ops esp32_s2_chip_ops = {
@@ -511,19 +512,20 @@ struct target_type esp32_s2_target = {
 	.arch_state = esp32_s2_arch_state,
 
 	.halt = xtensa_halt,
-	.resume = xtensa_resume,
-	.step = xtensa_step,
+	.resume = esp_xtensa_resume,
+	.step = esp_xtensa_step,
 
 	.assert_reset = esp32_s2_assert_reset,
 	.deassert_reset = xtensa_deassert_reset,
 
 	.virt2phys = esp32_s2_virt2phys,
 	.mmu = xtensa_mmu_is_enabled,
-	.read_memory = xtensa_read_memory,
+	.read_memory = esp_xtensa_read_memory,
 	.write_memory = xtensa_write_memory,
 
-	.read_buffer = xtensa_read_buffer,
+	.read_buffer = esp_xtensa_read_buffer,
 	.write_buffer = xtensa_write_buffer,
+	.mem_batch = esp_xtensa_mem_batch,
 
 	.checksum_memory = xtensa_checksum_memory,
 
@@ -25,18 +25,11 @@
 #include "esp_xtensa.h"
 #include "xtensa_mcore.h"
 #include "esp_xtensa_apptrace.h"
+#include "semihosting_common.h"
 
 #define ESP_XTENSA_SYSCALL     XT_INS_BREAK(1,1)
 #define ESP_XTENSA_SYSCALL_SZ  3
 
-#define ESP_SYS_OPEN        0x01
-#define ESP_SYS_CLOSE       0x02
-#define ESP_SYS_WRITE       0x05
-#define ESP_SYS_READ        0x06
-#define ESP_SYS_SEEK        0x0A
-
-#define ESP_FD_MIN          2
-
 #define ESP_O_RDONLY        0
 #define ESP_O_WRONLY        1
 #define ESP_O_RDWR          2
@@ -103,6 +96,21 @@ static int esp_xtensa_on_exit(struct target *target, void *priv)
 	return ERROR_OK;
 }
 
+/* Apply the flash BP operations deferred by esp_xtensa_breakpoint_add/remove() */
+int esp_xtensa_special_breakpoints_flush(struct target *target)
+{
+	struct esp_xtensa_common *esp_xtensa = target_to_esp_xtensa(target);
+
+	if (esp_xtensa->spec_brps_ops.breakpoints_flush == NULL)
+		return ERROR_OK;
+	int ret = esp_xtensa->spec_brps_ops.breakpoints_flush(target,
+		esp_xtensa->spec_brps,
+		ESP_XTENSA_SPECIAL_BREAKPOINTS_MAX_NUM);
+	if (ret != ERROR_OK)
+		LOG_ERROR("%s: Failed to apply SW flash BPs (%d)!", target_name(target), ret);
+	return ret;
+}
+
 static int esp_xtensa_handle_target_event(struct target *target, enum target_event event,
 	void *priv)
 {
@@ -157,6 +165,9 @@ static int esp_xtensa_handle_target_event(struct target *target, enum target_eve
 					}
 				}
 			}
+			int res = esp_xtensa_special_breakpoints_flush(target);
+			if (res != ERROR_OK)
+				return res;
 			memset(esp_xtensa->spec_brps,
 				0,
 				ESP_XTENSA_SPECIAL_BREAKPOINTS_MAX_NUM*
@@ -179,6 +190,86 @@ static int esp_xtensa_handle_target_event(struct target *target, enum target_eve
 	return ERROR_OK;
 }
 
+int esp_xtensa_mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count)
+{
+	int ret = xtensa_mem_batch(target, ops, count);
+	if (ret != ERROR_OK)
+		return ret;
+	for (unsigned int i = 0; i < count; i++) {
+		if (!ops[i].write)
+			esp_xtensa_special_breakpoints_unpatch(target, ops[i].address, ops[i].size,
+				ops[i].data);
+	}
+	return ERROR_OK;
+}
+
+int esp_xtensa_resume(struct target *target,
+	int current,
+	target_addr_t address,
+	int handle_breakpoints,
+	int debug_execution)
+{
+	/* flash BPs belong to the user program, not to algorithms run by OpenOCD */
+	if (!debug_execution) {
+		int ret = esp_xtensa_special_breakpoints_flush(target);
+		if (ret != ERROR_OK)
+			return ret;
+	}
+	return xtensa_resume(target, current, address, handle_breakpoints, debug_execution);
+}
+
+int esp_xtensa_step(struct target *target,
+	int current,
+	target_addr_t address,
+	int handle_breakpoints)
+{
+	int ret = esp_xtensa_special_breakpoints_flush(target);
+	if (ret != ERROR_OK)
+		return ret;
+	return xtensa_step(target, current, address, handle_breakpoints);
+}
+
+/* Flash BPs removed by GDB stay in flash until the next resume or step.
+ * Put the original instructions back into data read from their addresses. */
+void esp_xtensa_special_breakpoints_unpatch(struct target *target, target_addr_t address,
+	uint32_t size, uint8_t *buffer)
+{
+	struct esp_xtensa_common *esp_xtensa = target_to_esp_xtensa(target);
+
+	if (esp_xtensa->spec_brps == NULL)
+		return;
+	for (size_t slot = 0; slot < ESP_XTENSA_SPECIAL_BREAKPOINTS_MAX_NUM; slot++) {
+		struct esp_xtensa_special_breakpoint *spec_bp = &esp_xtensa->spec_brps[slot];
+		if (spec_bp->pending != ESP_XTENSA_SPEC_BP_PENDING_CLEAR)
+			continue;
+		for (uint8_t i = 0; i < spec_bp->data.insn_sz; i++) {
+			target_addr_t addr = spec_bp->address + i;
+			if (addr >= address && addr - address < size)
+				buffer[addr - address] = spec_bp->data.insn[i];
+		}
+	}
+}
+
+int esp_xtensa_read_memory(struct target *target,
+	target_addr_t address,
+	uint32_t size,
+	uint32_t count,
+	uint8_t *buffer)
+{
+	int ret = xtensa_read_memory(target, address, size, count, buffer);
+	if (ret == ERROR_OK)
+		esp_xtensa_special_breakpoints_unpatch(target, address, size * count, buffer);
+	return ret;
+}
+
+int esp_xtensa_read_buffer(struct target *target,
+	target_addr_t address,
+	uint32_t count,
+	uint8_t *buffer)
+{
+	return esp_xtensa_read_memory(target, address, 1, count, buffer);
+}
+
 int esp_xtensa_init_arch_info(struct target *target, struct target *chip_target,
 	void *arch_info,
 	const struct xtensa_config *xtensa_cfg,
@@ -364,11 +455,21 @@ static int esp_xtensa_special_breakpoint_add(struct target *target, struct break
 	struct esp_xtensa_common *esp_xtensa = target_to_esp_xtensa(target);
 	uint32_t slot;
 
+	/* prefer the slot which is still set in flash at this address */
 	for (slot = 0; slot < ESP_XTENSA_SPECIAL_BREAKPOINTS_MAX_NUM; slot++) {
-		if (esp_xtensa->spec_brps[slot].data.oocd_bp == NULL ||
-			esp_xtensa->spec_brps[slot].data.oocd_bp == breakpoint)
+		struct esp_xtensa_special_breakpoint *spec_bp = &esp_xtensa->spec_brps[slot];
+		if (spec_bp->data.oocd_bp == breakpoint ||
+			(spec_bp->pending == ESP_XTENSA_SPEC_BP_PENDING_CLEAR &&
+			spec_bp->address == breakpoint->address))
 			break;
 	}
+	if (slot == ESP_XTENSA_SPECIAL_BREAKPOINTS_MAX_NUM) {
+		for (slot = 0; slot < ESP_XTENSA_SPECIAL_BREAKPOINTS_MAX_NUM; slot++) {
+			if (esp_xtensa->spec_brps[slot].data.oocd_bp == NULL &&
+				esp_xtensa->spec_brps[slot].pending == ESP_XTENSA_SPEC_BP_PENDING_NONE)
+				break;
+		}
+	}
 	if (slot == ESP_XTENSA_SPECIAL_BREAKPOINTS_MAX_NUM) {
 		LOG_WARNING("%s: max SW flash slot reached, slot=%u", target_name(target), slot);
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
@@ -437,10 +538,66 @@ void esp_xtensa_queue_tdi_idle(struct target *target)
 	jtag_add_plain_ir_scan(1, t, NULL, TAP_IRPAUSE);
 }
 
+int esp_xtensa_semihost_open(struct esp_xtensa_common *esp_xtensa,
+	const char *name,
+	uint32_t name_len,
+	uint32_t esp_flags,
+	int *host_errno)
+{
+	int mode, base_len = 0;
+
+	if (name_len == 0) {
+		LOG_ERROR("Zero file name length!");
+		*host_errno = EINVAL;
+		return -1;
+	}
+	if (esp_xtensa->semihost.basedir && (esp_flags & ESP_O_SEMIHOST_ABSPATH) == 0)
+		base_len = strlen(esp_xtensa->semihost.basedir);
+	char *file_name = malloc(base_len+name_len+1);
+	if (!file_name) {
+		LOG_ERROR("Failed to alloc memory for file name!");
+		*host_errno = EINVAL;
+		return -1;
+	}
+	if (base_len)
+		memcpy(file_name, esp_xtensa->semihost.basedir, base_len);
+	memcpy(file_name+base_len, name, name_len);
+	file_name[base_len+name_len] = 0;
+
+	if (esp_flags & ESP_O_RDWR)
+		mode = O_RDWR;
+	else if (esp_flags & ESP_O_WRONLY)
+		mode = O_WRONLY;
+	else
+		mode = O_RDONLY;
+	if (esp_flags & ESP_O_APPEND)
+		mode |= O_APPEND;
+	if (esp_flags & ESP_O_CREAT)
+		mode |= O_CREAT;
+	if (esp_flags & ESP_O_TRUNC)
+		mode |= O_TRUNC;
+	if (esp_flags & ESP_O_EXCL)
+		mode |= O_EXCL;
+
+#ifdef _WIN32
+	/* Windows needs O_BINARY flag for proper handling of EOLs */
+	mode |= O_BINARY;
+#endif
+	/* cygwin requires the permission setting
+	 * otherwise it will fail to reopen a previously
+	 * written file */
+	int fd = open(file_name, mode, 0644);
+	*host_errno = errno;
+	LOG_DEBUG("Open file '%s' -> %d. Error %d.", file_name, fd, *host_errno);
+	free(file_name);
+	return fd;
+}
+
 static int esp_xtensa_do_semihosting(struct target *target)
 {
 	struct esp_xtensa_common *esp_xtensa = target_to_esp_xtensa(target);
 	int syscall_ret = 0, syscall_errno = 0, retval;
+	int64_t io_ret;
 	/* TODO: use a2, a3, a4, a5, a6 for syscall params when problem with a3 corruption will be
 	 * solved */
 	xtensa_reg_val_t a2 = xtensa_reg_get(target, XT_REG_IDX_A2);
@@ -459,8 +616,6 @@ static int esp_xtensa_do_semihosting(struct target *target)
 	switch (a2) {
 		case ESP_SYS_OPEN:
 		{
-			int mode, base_len = 0;
-
 			if (a4 == 0) {
 				LOG_ERROR("Zero file name length!");
 				syscall_ret = -1;
@@ -468,18 +623,14 @@ static int esp_xtensa_do_semihosting(struct target *target)
 				syscall_errno = EINVAL;
 				break;
 			}
-			if (esp_xtensa->semihost.basedir && (a5 & ESP_O_SEMIHOST_ABSPATH) == 0)
-				base_len = strlen(esp_xtensa->semihost.basedir);
-			char *file_name = malloc(base_len+a4+1);
+			char *file_name = malloc(a4);
 			if (!file_name) {
 				LOG_ERROR("Failed to alloc memory for file name!");
 				syscall_ret = -1;
 				syscall_errno = EINVAL;
 				break;
 			}
-			if (esp_xtensa->semihost.basedir)
-				strcpy(file_name, esp_xtensa->semihost.basedir);
-			retval = target_read_buffer(target, a3, a4, (uint8_t *)file_name+base_len);
+			retval = target_read_buffer(target, a3, a4, (uint8_t *)file_name);
 			if (retval != ERROR_OK) {
 				free(file_name);
 				LOG_ERROR("Failed to read name of file to open!");
@@ -487,36 +638,8 @@ static int esp_xtensa_do_semihosting(struct target *target)
 				syscall_errno = EINVAL;
 				break;
 			}
-			file_name[base_len+a4] = 0;
-
-			if (a5 & ESP_O_RDWR)
-				mode = O_RDWR;
-			else if (a5 & ESP_O_WRONLY)
-				mode = O_WRONLY;
-			else
-				mode = O_RDONLY;
-			if (a5 & ESP_O_APPEND)
-				mode |= O_APPEND;
-			if (a5 & ESP_O_CREAT)
-				mode |= O_CREAT;
-			if (a5 & ESP_O_TRUNC)
-				mode |= O_TRUNC;
-			if (a5 & ESP_O_EXCL)
-				mode |= O_EXCL;
-
-#ifdef _WIN32
-			/* Windows needs O_BINARY flag for proper handling of EOLs */
-			mode |= O_BINARY;
-#endif
-			/* cygwin requires the permission setting
-			 * otherwise it will fail to reopen a previously
-			 * written file */
-			syscall_ret = open(file_name, mode, 0644);
-			syscall_errno = errno;
-			LOG_DEBUG("Open file '%s' -> %d. Error %d.",
-				file_name,
-				syscall_ret,
-				syscall_errno);
+			syscall_ret = esp_xtensa_semihost_open(esp_xtensa, file_name, a4, a5,
+				&syscall_errno);
 			free(file_name);
 			break;
 		}
@@ -548,23 +671,14 @@ static int esp_xtensa_do_semihosting(struct target *target)
 				syscall_errno = 0;
 				break;
 			}
-			uint8_t *buf = malloc(a5);
-			if (!buf) {
-				syscall_ret = -1;
-				syscall_errno = ENOMEM;
-				break;
-			}
-			retval = target_read_buffer(target, a4, a5, buf);
+			retval = semihosting_io_write(target, a3, a4, a5, &io_ret, &syscall_errno);
 			if (retval != ERROR_OK) {
-				free(buf);
 				syscall_ret = -1;
 				syscall_errno = EINVAL;
 				break;
 			}
-			syscall_ret = write(a3, buf, a5);
-			syscall_errno = errno;
-			LOG_DEBUG("Wrote file %d. %d bytes.", a3, a5);
-			free(buf);
+			syscall_ret = io_ret;
+			LOG_DEBUG("Wrote file %d. %d bytes.", a3, syscall_ret);
 			break;
 		}
 		case ESP_SYS_READ:
@@ -582,25 +696,14 @@ static int esp_xtensa_do_semihosting(struct target *target)
 				syscall_errno = 0;
 				break;
 			}
-			uint8_t *buf = malloc(a5);
-			if (!buf) {
+			retval = semihosting_io_read(target, a3, a4, a5, &io_ret, &syscall_errno);
+			if (retval != ERROR_OK) {
 				syscall_ret = -1;
-				syscall_errno = ENOMEM;
+				syscall_errno = EINVAL;
 				break;
 			}
-			syscall_ret = read(a3, buf, a5);
-			syscall_errno = errno;
-			LOG_DEBUG("Read file %d. %d bytes.", a3, a5);
-			if (syscall_ret >= 0) {
-				retval = target_write_buffer(target, a4, syscall_ret, buf);
-				if (retval != ERROR_OK) {
-					free(buf);
-					syscall_ret = -1;
-					syscall_errno = EINVAL;
-					break;
-				}
-			}
-			free(buf);
+			syscall_ret = io_ret;
+			LOG_DEBUG("Read file %d. %d bytes.", a3, syscall_ret);
 			break;
 		}
 		case ESP_SYS_SEEK:
@@ -92,9 +92,19 @@ enum esp_flash_bootstrap {
 
 #define ESP_XTENSA_SPECIAL_BREAKPOINTS_MAX_NUM  32
 
+enum esp_xtensa_spec_bp_pending {
+	ESP_XTENSA_SPEC_BP_PENDING_NONE = 0,
+	ESP_XTENSA_SPEC_BP_PENDING_SET,
+	ESP_XTENSA_SPEC_BP_PENDING_CLEAR,
+};
+
 struct esp_xtensa_special_breakpoint {
 	struct xtensa_sw_breakpoint data;
 	void *priv;
+	/* operation to be applied by breakpoints_flush() */
+	enum esp_xtensa_spec_bp_pending pending;
+	/* kept for pending clear, when 'data.oocd_bp' is already gone */
+	target_addr_t address;
 };
 
 struct esp_xtensa_special_breakpoint_ops {
@@ -102,8 +112,21 @@ struct esp_xtensa_special_breakpoint_ops {
 		struct esp_xtensa_special_breakpoint *spec_bp);
 	int (*breakpoint_remove)(struct target *target,
 		struct esp_xtensa_special_breakpoint *spec_bp);
+	/* applies deferred add/remove operations, called before the target is resumed */
+	int (*breakpoints_flush)(struct target *target,
+		struct esp_xtensa_special_breakpoint *spec_bps, size_t num);
 };
 
+/* ESP semihosting syscall numbers, also used as request codes by the apptrace transport */
+#define ESP_SYS_OPEN        0x01
+#define ESP_SYS_CLOSE       0x02
+#define ESP_SYS_WRITE       0x05
+#define ESP_SYS_READ        0x06
+#define ESP_SYS_SEEK        0x0A
+
+/* host file descriptors up to this one are never handed out to the target */
+#define ESP_FD_MIN          2
+
 struct esp_xtensa_semihost_data {
 	char *basedir;
 };
@@ -139,9 +162,36 @@ void esp_xtensa_queue_tdi_idle(struct target *target);
 int esp_xtensa_breakpoint_add(struct target *target, struct breakpoint *breakpoint);
 int esp_xtensa_breakpoint_remove(struct target *target, struct breakpoint *breakpoint);
 bool esp_xtensa_is_special_breakpoint(struct target *target, struct breakpoint *breakpoint);
+int esp_xtensa_special_breakpoints_flush(struct target *target);
+int esp_xtensa_mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count);
+int esp_xtensa_resume(struct target *target,
+	int current,
+	target_addr_t address,
+	int handle_breakpoints,
+	int debug_execution);
+int esp_xtensa_step(struct target *target,
+	int current,
+	target_addr_t address,
+	int handle_breakpoints);
+void esp_xtensa_special_breakpoints_unpatch(struct target *target, target_addr_t address,
+	uint32_t size, uint8_t *buffer);
+int esp_xtensa_read_memory(struct target *target,
+	target_addr_t address,
+	uint32_t size,
+	uint32_t count,
+	uint8_t *buffer);
+int esp_xtensa_read_buffer(struct target *target,
+	target_addr_t address,
+	uint32_t count,
+	uint8_t *buffer);
 void esp_xtensa_on_reset(struct target *target);
 bool esp_xtensa_on_halt(struct target *target);
 void esp_xtensa_on_poll(struct target *target);
+int esp_xtensa_semihost_open(struct esp_xtensa_common *esp_xtensa,
+	const char *name,
+	uint32_t name_len,
+	uint32_t esp_flags,
+	int *host_errno);
 
 COMMAND_HELPER(esp_xtensa_cmd_flashbootstrap_do, struct esp_xtensa_common *esp_xtensa);
 COMMAND_HELPER(esp_xtensa_cmd_semihost_basedir_do, struct esp_xtensa_common *esp_xtensa);
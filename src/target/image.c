@@ -32,6 +32,11 @@
 #include "image.h"
 #include "target.h"
 #include <helper/log.h>
+#include <helper/crc32.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 /* convert ELF header field to host endianness */
 #define field16(elf, field) \
@@ -501,6 +506,16 @@ static int image_elf_read_section(struct image *image,
 		LOG_DEBUG("read elf: size = 0x%zu at 0x%" PRIx32 "", read_size,
 			field32(elf, segment->p_offset) + offset);
 		/* read initialized area of the segment */
+		if (elf->map) {
+			size_t file_offset = field32(elf, segment->p_offset) + offset;
+			if (file_offset + read_size > elf->map_size) {
+				LOG_ERROR("ELF segment content past end of file");
+				return ERROR_IMAGE_FORMAT_ERROR;
+			}
+			memcpy(buffer, elf->map + file_offset, read_size);
+			*size_read += read_size;
+			return ERROR_OK;
+		}
 		retval = fileio_seek(elf->fileio, field32(elf, segment->p_offset) + offset);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("cannot find ELF segment content, seek failed");
@@ -725,6 +740,168 @@ static int image_mot_buffer_complete(struct image *image)
 	return retval;
 }
 
+/* Parsed IHEX and S-record images are kept across commands, so programming
+ * and then verifying the same file only parses it once. An entry is found by
+ * path, size and modification time; its data is shared with every image
+ * opened from it and freed when the last one is closed after eviction. */
+struct image_cache_entry {
+	char *url;
+	enum image_type type;
+	size_t file_size;
+	int64_t mtime;
+	int num_sections;
+	struct imagesection *sections;
+	uint8_t *buffer;
+	size_t buffer_size;
+	int start_address_set;
+	uint32_t start_address;
+	unsigned int refcount;
+	bool evicted;
+	struct image_cache_entry *next;
+};
+
+#define IMAGE_CACHE_MAX_SIZE	(64 * 1024 * 1024)
+
+/* most recently used first */
+static struct image_cache_entry *image_cache;
+
+static void image_cache_free_entry(struct image_cache_entry *entry)
+{
+	free(entry->url);
+	free(entry->sections);
+	free(entry->buffer);
+	free(entry);
+}
+
+static void image_cache_evict(struct image_cache_entry **link)
+{
+	struct image_cache_entry *entry = *link;
+
+	*link = entry->next;
+	entry->evicted = true;
+	if (!entry->refcount)
+		image_cache_free_entry(entry);
+}
+
+static void image_cache_release(struct image_cache_entry *entry)
+{
+	if (!entry)
+		return;
+
+	entry->refcount--;
+	if (entry->evicted && !entry->refcount)
+		image_cache_free_entry(entry);
+}
+
+/**
+ * Fill in the sections of @a image from the cache if @a fileio still holds
+ * the contents that were parsed before. Returns the referenced entry, or
+ * NULL if the file has to be parsed.
+ */
+static struct image_cache_entry *image_cache_lookup(struct image *image,
+	struct fileio *fileio, const char *url)
+{
+	size_t file_size;
+	int64_t mtime;
+
+	if (fileio_size(fileio, &file_size) != ERROR_OK ||
+		fileio_mtime(fileio, &mtime) != ERROR_OK)
+		return NULL;
+
+	struct image_cache_entry **link = &image_cache;
+	while (*link) {
+		struct image_cache_entry *entry = *link;
+
+		if (entry->type != image->type || strcmp(entry->url, url)) {
+			link = &entry->next;
+			continue;
+		}
+
+		if (entry->file_size != file_size || entry->mtime != mtime) {
+			/* file changed since it was parsed */
+			image_cache_evict(link);
+			return NULL;
+		}
+
+		image->sections = malloc(sizeof(struct imagesection) * entry->num_sections);
+		if (!image->sections)
+			return NULL;
+		memcpy(image->sections, entry->sections, sizeof(struct imagesection) * entry->num_sections);
+		image->num_sections = entry->num_sections;
+		image->start_address_set = entry->start_address_set;
+		image->start_address = entry->start_address;
+
+		/* move to front */
+		*link = entry->next;
+		entry->next = image_cache;
+		image_cache = entry;
+
+		entry->refcount++;
+		LOG_DEBUG("using cached image %s", url);
+		return entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * Hand the freshly parsed data of @a image over to the cache. On success
+ * the cache owns @a buffer (set to NULL) and the returned entry is
+ * referenced by @a image.
+ */
+static struct image_cache_entry *image_cache_insert(struct image *image,
+	struct fileio *fileio, const char *url, uint8_t **buffer)
+{
+	size_t file_size;
+	int64_t mtime;
+
+	if (fileio_size(fileio, &file_size) != ERROR_OK ||
+		fileio_mtime(fileio, &mtime) != ERROR_OK)
+		return NULL;
+
+	/* all our parsers allocate half the file size */
+	size_t buffer_size = file_size >> 1;
+	if (buffer_size > IMAGE_CACHE_MAX_SIZE)
+		return NULL;
+
+	struct image_cache_entry *entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return NULL;
+	entry->url = strdup(url);
+	entry->sections = malloc(sizeof(struct imagesection) * image->num_sections);
+	if (!entry->url || !entry->sections) {
+		image_cache_free_entry(entry);
+		return NULL;
+	}
+	memcpy(entry->sections, image->sections, sizeof(struct imagesection) * image->num_sections);
+	entry->type = image->type;
+	entry->file_size = file_size;
+	entry->mtime = mtime;
+	entry->num_sections = image->num_sections;
+	entry->buffer = *buffer;
+	entry->buffer_size = buffer_size;
+	entry->start_address_set = image->start_address_set;
+	entry->start_address = image->start_address;
+	entry->refcount = 1;
+	*buffer = NULL;
+
+	entry->next = image_cache;
+	image_cache = entry;
+
+	/* drop the least recently used entries beyond the size limit */
+	size_t total = 0;
+	struct image_cache_entry **link = &image_cache;
+	while (*link) {
+		total += (*link)->buffer_size;
+		if (total > IMAGE_CACHE_MAX_SIZE)
+			image_cache_evict(link);
+		else
+			link = &(*link)->next;
+	}
+
+	return entry;
+}
+
 int image_open(struct image *image, const char *url, const char *type_string)
 {
 	int retval = ERROR_OK;
@@ -748,6 +925,10 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			return retval;
 		}
 
+		if (fileio_map(image_binary->fileio, &image_binary->map) != ERROR_OK)
+			image_binary->map = NULL;
+		image_binary->map_size = filesize;
+
 		image->num_sections = 1;
 		image->sections = malloc(sizeof(struct imagesection));
 		image->sections[0].base_address = 0x0;
@@ -762,12 +943,17 @@ int image_open(struct image *image, const char *url, const char *type_string)
 		if (retval != ERROR_OK)
 			return retval;
 
-		retval = image_ihex_buffer_complete(image);
-		if (retval != ERROR_OK) {
-			LOG_ERROR(
-				"failed buffering IHEX image, check server output for additional information");
-			fileio_close(image_ihex->fileio);
-			return retval;
+		image_ihex->buffer = NULL;
+		image_ihex->cache = image_cache_lookup(image, image_ihex->fileio, url);
+		if (!image_ihex->cache) {
+			retval = image_ihex_buffer_complete(image);
+			if (retval != ERROR_OK) {
+				LOG_ERROR(
+					"failed buffering IHEX image, check server output for additional information");
+				fileio_close(image_ihex->fileio);
+				return retval;
+			}
+			image_ihex->cache = image_cache_insert(image, image_ihex->fileio, url, &image_ihex->buffer);
 		}
 	} else if (image->type == IMAGE_ELF) {
 		struct image_elf *image_elf;
@@ -783,6 +969,10 @@ int image_open(struct image *image, const char *url, const char *type_string)
 			fileio_close(image_elf->fileio);
 			return retval;
 		}
+
+		if (fileio_map(image_elf->fileio, &image_elf->map) != ERROR_OK ||
+			fileio_size(image_elf->fileio, &image_elf->map_size) != ERROR_OK)
+			image_elf->map = NULL;
 	} else if (image->type == IMAGE_MEMORY) {
 		struct target *target = get_target(url);
 
@@ -813,12 +1003,17 @@ int image_open(struct image *image, const char *url, const char *type_string)
 		if (retval != ERROR_OK)
 			return retval;
 
-		retval = image_mot_buffer_complete(image);
-		if (retval != ERROR_OK) {
-			LOG_ERROR(
-				"failed buffering S19 image, check server output for additional information");
-			fileio_close(image_mot->fileio);
-			return retval;
+		image_mot->buffer = NULL;
+		image_mot->cache = image_cache_lookup(image, image_mot->fileio, url);
+		if (!image_mot->cache) {
+			retval = image_mot_buffer_complete(image);
+			if (retval != ERROR_OK) {
+				LOG_ERROR(
+					"failed buffering S19 image, check server output for additional information");
+				fileio_close(image_mot->fileio);
+				return retval;
+			}
+			image_mot->cache = image_cache_insert(image, image_mot->fileio, url, &image_mot->buffer);
 		}
 	} else if (image->type == IMAGE_BUILDER) {
 		image->num_sections = 0;
@@ -868,6 +1063,17 @@ int image_read_section(struct image *image,
 		if (section != 0)
 			return ERROR_COMMAND_SYNTAX_ERROR;
 
+		if (image_binary->map) {
+			/* the section size can be changed by the caller, the file can't */
+			if (offset >= image_binary->map_size)
+				size = 0;
+			else if (size > image_binary->map_size - offset)
+				size = image_binary->map_size - offset;
+			memcpy(buffer, image_binary->map + offset, size);
+			*size_read = size;
+			return ERROR_OK;
+		}
+
 		/* seek to offset */
 		retval = fileio_seek(image_binary->fileio, offset);
 		if (retval != ERROR_OK)
@@ -937,6 +1143,48 @@ int image_read_section(struct image *image,
 	return ERROR_OK;
 }
 
+/**
+ * Ask the kernel to start reading the part of a mapped binary or ELF section
+ * that a following image_read_section() will ask for. madvise() returns
+ * immediately and the readahead runs in the background, so disk reads
+ * overlap whatever the caller does next. For other image types, or hosts
+ * without madvise(), it does nothing.
+ */
+void image_prefetch_section(struct image *image, int section, uint32_t offset, uint32_t size)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(MADV_WILLNEED)
+	const uint8_t *map = NULL;
+	size_t map_size = 0;
+	size_t start = offset;
+
+	if (image->type == IMAGE_BINARY) {
+		struct image_binary *image_binary = image->type_private;
+
+		map = image_binary->map;
+		map_size = image_binary->map_size;
+	} else if (image->type == IMAGE_ELF) {
+		struct image_elf *elf = image->type_private;
+		Elf32_Phdr *segment = (Elf32_Phdr *)image->sections[section].private;
+
+		map = elf->map;
+		map_size = elf->map_size;
+		start += field32(elf, segment->p_offset);
+	}
+
+	if (!map || start >= map_size)
+		return;
+
+	size_t end = MIN(start + size, map_size);
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0)
+		return;
+
+	/* the mapping itself is page aligned, so align relative to it */
+	start -= start % page_size;
+	madvise((void *)(map + start), end - start, MADV_WILLNEED);
+#endif
+}
+
 int image_add_section(struct image *image, uint32_t base, uint32_t size, int flags, uint8_t const *data)
 {
 	struct imagesection *section;
@@ -989,6 +1237,9 @@ void image_close(struct image *image)
 			free(image_ihex->buffer);
 			image_ihex->buffer = NULL;
 		}
+
+		image_cache_release(image_ihex->cache);
+		image_ihex->cache = NULL;
 	} else if (image->type == IMAGE_ELF) {
 		struct image_elf *image_elf = image->type_private;
 
@@ -1019,6 +1270,9 @@ void image_close(struct image *image)
 			free(image_mot->buffer);
 			image_mot->buffer = NULL;
 		}
+
+		image_cache_release(image_mot->cache);
+		image_mot->cache = NULL;
 	} else if (image->type == IMAGE_BUILDER) {
 		int i;
 
@@ -1044,31 +1298,13 @@ int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes, uint32_t *checksu
 	uint32_t crc = 0xffffffff;
 	LOG_DEBUG("Calculating checksum");
 
-	static uint32_t crc32_table[256];
-
-	static bool first_init;
-	if (!first_init) {
-		/* Initialize the CRC table and the decoding table.  */
-		unsigned int i, j, c;
-		for (i = 0; i < 256; i++) {
-			/* as per gdb */
-			for (c = i << 24, j = 8; j > 0; --j)
-				c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
-			crc32_table[i] = c;
-		}
-
-		first_init = true;
-	}
-
 	while (nbytes > 0) {
-		int run = nbytes;
+		uint32_t run = nbytes;
 		if (run > 32768)
 			run = 32768;
+		crc = crc32_gdb(crc, buffer, run);
+		buffer += run;
 		nbytes -= run;
-		while (run--) {
-			/* as per gdb */
-			crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ *buffer++) & 255];
-		}
 		keep_alive();
 	}
 
@@ -67,11 +67,16 @@ struct image {
 
 struct image_binary {
 	struct fileio *fileio;
+	const uint8_t *map;		/* whole file mapped, or NULL */
+	size_t map_size;
 };
 
+struct image_cache_entry;
+
 struct image_ihex {
 	struct fileio *fileio;
 	uint8_t *buffer;
+	struct image_cache_entry *cache;	/* parsed data shared with the image cache */
 };
 
 struct image_memory {
@@ -86,16 +91,21 @@ struct image_elf {
 	Elf32_Phdr *segments;
 	uint32_t segment_count;
 	uint8_t endianness;
+	const uint8_t *map;		/* whole file mapped, or NULL */
+	size_t map_size;
 };
 
 struct image_mot {
 	struct fileio *fileio;
 	uint8_t *buffer;
+	struct image_cache_entry *cache;	/* parsed data shared with the image cache */
 };
 
 int image_open(struct image *image, const char *url, const char *type_string);
 int image_read_section(struct image *image, int section, uint32_t offset,
 		uint32_t size, uint8_t *buffer, size_t *size_read);
+void image_prefetch_section(struct image *image, int section, uint32_t offset,
+		uint32_t size);
 void image_close(struct image *image);
 
 int image_add_section(struct image *image, uint32_t base, uint32_t size,
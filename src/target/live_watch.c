@@ -0,0 +1,535 @@
+/***************************************************************************
+ *   Live memory sampling while the target runs                            *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+/*
+ * The live watch samples a set of variables at fixed periods from a timer
+ * callback, using the target's normal memory access path. That is only
+ * non-intrusive where the target can access memory while running, e.g.
+ * through a MEM-AP on ARM or the system bus on RISC-V; elsewhere the reads
+ * fail and are counted as errors.
+ *
+ * Variables due in the same tick that lie close together on the same target
+ * are fetched in one transfer, so watching the fields of a structure costs
+ * about as much as watching one of them.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <helper/log.h>
+#include <helper/time_support.h>
+#include "target.h"
+#include "live_watch.h"
+
+/* Variables this close together are read in one transfer. */
+#define LIVE_WATCH_MERGE_GAP	32
+/* Largest single transfer */
+#define LIVE_WATCH_MERGE_MAX	256
+
+struct live_watch_var {
+	char *name;
+	struct target *target;
+	target_addr_t address;
+	unsigned int size;
+	unsigned int period_ms;
+
+	int64_t due;		/* next sample time, us */
+	int64_t last;		/* time of the previous sample, us, 0 if none */
+
+	uint64_t samples;
+	uint64_t errors;
+	uint64_t missed;	/* periods skipped because we were late */
+	int64_t interval_min, interval_max;
+	int64_t jitter_sum, jitter_max;
+
+	struct live_watch_var *next;
+};
+
+struct live_watch_callback {
+	int (*callback)(const struct live_watch_sample *sample, void *priv);
+	void *priv;
+	struct live_watch_callback *next;
+};
+
+/* Sorted by target and address, so neighbours can be read together. */
+static struct live_watch_var *live_watch_vars;
+static struct live_watch_callback *live_watch_callbacks;
+
+static bool live_watch_running;
+static unsigned int live_watch_tick_ms;
+static FILE *live_watch_file;
+static int64_t live_watch_start;
+static uint64_t live_watch_transfers;
+static uint64_t live_watch_bytes;
+static int64_t live_watch_read_time;
+
+static int64_t live_watch_now(void)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+int live_watch_register_callback(
+		int (*callback)(const struct live_watch_sample *sample, void *priv),
+		void *priv)
+{
+	struct live_watch_callback *entry = malloc(sizeof(*entry));
+	if (!entry) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	entry->callback = callback;
+	entry->priv = priv;
+	entry->next = live_watch_callbacks;
+	live_watch_callbacks = entry;
+	return ERROR_OK;
+}
+
+int live_watch_unregister_callback(
+		int (*callback)(const struct live_watch_sample *sample, void *priv),
+		void *priv)
+{
+	for (struct live_watch_callback **p = &live_watch_callbacks; *p; p = &(*p)->next) {
+		if ((*p)->callback == callback && (*p)->priv == priv) {
+			struct live_watch_callback *entry = *p;
+			*p = entry->next;
+			free(entry);
+			return ERROR_OK;
+		}
+	}
+	return ERROR_FAIL;
+}
+
+static void live_watch_emit(struct live_watch_var *var, uint64_t value, int64_t now)
+{
+	struct live_watch_sample sample = {
+		.target = var->target,
+		.name = var->name,
+		.address = var->address,
+		.size = var->size,
+		.value = value,
+		.timestamp = now - live_watch_start,
+	};
+
+	if (live_watch_file)
+		fprintf(live_watch_file, "%" PRId64 ".%03u %s %s 0x%" TARGET_PRIxADDR " 0x%0*" PRIx64 "\n",
+				sample.timestamp / 1000, (unsigned int)(sample.timestamp % 1000),
+				target_name(var->target), var->name, var->address,
+				var->size * 2, value);
+
+	for (struct live_watch_callback *cb = live_watch_callbacks; cb; cb = cb->next)
+		cb->callback(&sample, cb->priv);
+}
+
+/* Update the statistics of a variable sampled at 'now' and schedule the next
+ * sample. */
+static void live_watch_account(struct live_watch_var *var, int64_t now)
+{
+	int64_t period = var->period_ms * 1000;
+
+	if (var->last) {
+		int64_t interval = now - var->last;
+		int64_t jitter = interval > period ? interval - period : period - interval;
+		if (var->samples == 2 || interval < var->interval_min)
+			var->interval_min = interval;
+		if (interval > var->interval_max)
+			var->interval_max = interval;
+		var->jitter_sum += jitter;
+		if (jitter > var->jitter_max)
+			var->jitter_max = jitter;
+	}
+	var->last = now;
+
+	var->due += period;
+	if (var->due <= now) {
+		/* Don't try to catch up, just note how much we missed. */
+		var->missed += (now - var->due) / period + 1;
+		var->due = now + period;
+	}
+}
+
+static uint64_t live_watch_decode(struct target *target, const uint8_t *buf, unsigned int size)
+{
+	switch (size) {
+		case 1:
+			return *buf;
+		case 2:
+			return target_buffer_get_u16(target, buf);
+		case 4:
+			return target_buffer_get_u32(target, buf);
+		default:
+			return target_buffer_get_u64(target, buf);
+	}
+}
+
+static bool live_watch_aligned(const struct live_watch_var *var)
+{
+	return var->address % var->size == 0;
+}
+
+static int live_watch_timer_callback(void *priv)
+{
+	int64_t now = live_watch_now();
+	uint8_t buf[LIVE_WATCH_MERGE_MAX];
+
+	struct live_watch_var *var = live_watch_vars;
+	while (var) {
+		if (var->due > now || !target_was_examined(var->target)) {
+			var = var->next;
+			continue;
+		}
+
+		/* Extend the transfer over the following due variables as long as
+		 * it stays short. Only naturally aligned ones are merged, and they
+		 * are read with aligned word accesses so each stays atomic. */
+		struct live_watch_var *last = var;
+		target_addr_t base = var->address;
+		target_addr_t end = var->address + var->size;
+		if (live_watch_aligned(var) && var->size <= 4) {
+			base &= ~(target_addr_t)3;
+			end = (end + 3) & ~(target_addr_t)3;
+			for (struct live_watch_var *next = var->next; next; next = next->next) {
+				target_addr_t next_end = (next->address + next->size + 3) & ~(target_addr_t)3;
+				if (next->target != var->target ||
+						next->address > end + LIVE_WATCH_MERGE_GAP ||
+						next_end - base > LIVE_WATCH_MERGE_MAX)
+					break;
+				if (next->due > now)
+					continue;
+				if (!live_watch_aligned(next) || next->size > 4)
+					break;
+				last = next;
+				if (next_end > end)
+					end = next_end;
+			}
+		}
+
+		/* Values are stamped with the time their read started. */
+		int64_t start = live_watch_now();
+		int retval;
+		if (last == var && !live_watch_aligned(var))
+			retval = target_read_buffer(var->target, base, end - base, buf);
+		else if (last == var && var->size == 8)
+			retval = target_read_memory(var->target, base, 4, 2, buf);
+		else if (last == var && var->size < 4 && base == var->address)
+			retval = target_read_memory(var->target, base, var->size, 1, buf);
+		else
+			retval = target_read_memory(var->target, base, 4, (end - base) / 4, buf);
+		live_watch_read_time += live_watch_now() - start;
+		live_watch_transfers++;
+		live_watch_bytes += end - base;
+
+		for (struct live_watch_var *v = var; ; v = v->next) {
+			if (v->due <= now) {
+				if (retval == ERROR_OK) {
+					v->samples++;
+					uint64_t value = live_watch_decode(v->target, buf + (v->address - base), v->size);
+					live_watch_account(v, start);
+					live_watch_emit(v, value, start);
+				} else {
+					v->errors++;
+					v->due = start + v->period_ms * 1000;
+				}
+			}
+			if (v == last)
+				break;
+		}
+		if (retval != ERROR_OK)
+			LOG_DEBUG("live_watch: reading 0x%" TARGET_PRIxADDR " on %s failed",
+					base, target_name(var->target));
+
+		var = last->next;
+	}
+
+	if (live_watch_file)
+		fflush(live_watch_file);
+
+	return ERROR_OK;
+}
+
+static unsigned int live_watch_min_period(void)
+{
+	unsigned int min = 0;
+	for (struct live_watch_var *var = live_watch_vars; var; var = var->next)
+		if (!min || var->period_ms < min)
+			min = var->period_ms;
+	return min;
+}
+
+/* Run the timer as often as the most frequently sampled variable needs. */
+static int live_watch_update_timer(void)
+{
+	unsigned int tick = live_watch_running ? live_watch_min_period() : 0;
+	if (tick == live_watch_tick_ms)
+		return ERROR_OK;
+
+	if (live_watch_tick_ms)
+		target_unregister_timer_callback(live_watch_timer_callback, NULL);
+	live_watch_tick_ms = tick;
+	if (tick)
+		return target_register_timer_callback(live_watch_timer_callback, tick,
+				TARGET_TIMER_TYPE_PERIODIC, NULL);
+	return ERROR_OK;
+}
+
+static struct live_watch_var *live_watch_find(const char *name)
+{
+	for (struct live_watch_var *var = live_watch_vars; var; var = var->next)
+		if (!strcmp(var->name, name))
+			return var;
+	return NULL;
+}
+
+static void live_watch_reset_stats(struct live_watch_var *var, int64_t now)
+{
+	var->due = now;
+	var->last = 0;
+	var->samples = 0;
+	var->errors = 0;
+	var->missed = 0;
+	var->interval_min = 0;
+	var->interval_max = 0;
+	var->jitter_sum = 0;
+	var->jitter_max = 0;
+}
+
+COMMAND_HANDLER(handle_live_watch_add_command)
+{
+	if (CMD_ARGC != 4)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct target *target = get_current_target(CMD_CTX);
+	target_addr_t address;
+	unsigned int size, period_ms;
+	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[2], size);
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[3], period_ms);
+
+	if (size != 1 && size != 2 && size != 4 && size != 8) {
+		command_print(CMD, "size must be 1, 2, 4 or 8");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	if (!period_ms) {
+		command_print(CMD, "period must be at least 1 ms");
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+	if (live_watch_find(CMD_ARGV[0])) {
+		command_print(CMD, "live watch variable %s already exists", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	struct live_watch_var *var = calloc(1, sizeof(*var));
+	if (!var) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	var->name = strdup(CMD_ARGV[0]);
+	var->target = target;
+	var->address = address;
+	var->size = size;
+	var->period_ms = period_ms;
+	live_watch_reset_stats(var, live_watch_now());
+
+	struct live_watch_var **p = &live_watch_vars;
+	while (*p && ((*p)->target->target_number < target->target_number ||
+			((*p)->target == target && (*p)->address <= address)))
+		p = &(*p)->next;
+	var->next = *p;
+	*p = var;
+
+	return live_watch_update_timer();
+}
+
+COMMAND_HANDLER(handle_live_watch_remove_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	bool all = !strcmp(CMD_ARGV[0], "all");
+	bool found = false;
+	struct live_watch_var **p = &live_watch_vars;
+	while (*p) {
+		struct live_watch_var *var = *p;
+		if (all || !strcmp(var->name, CMD_ARGV[0])) {
+			*p = var->next;
+			free(var->name);
+			free(var);
+			found = true;
+		} else {
+			p = &var->next;
+		}
+	}
+	if (!found && !all) {
+		command_print(CMD, "no live watch variable %s", CMD_ARGV[0]);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	return live_watch_update_timer();
+}
+
+COMMAND_HANDLER(handle_live_watch_list_command)
+{
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	for (struct live_watch_var *var = live_watch_vars; var; var = var->next)
+		command_print(CMD, "%s: %s 0x%" TARGET_PRIxADDR " size %u every %u ms",
+				var->name, target_name(var->target), var->address,
+				var->size, var->period_ms);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_live_watch_start_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (live_watch_running) {
+		command_print(CMD, "live watch is already running");
+		return ERROR_FAIL;
+	}
+
+	if (CMD_ARGC == 1) {
+		live_watch_file = fopen(CMD_ARGV[0], "w");
+		if (!live_watch_file) {
+			command_print(CMD, "can't open %s: %s", CMD_ARGV[0], strerror(errno));
+			return ERROR_FAIL;
+		}
+	}
+
+	live_watch_start = live_watch_now();
+	live_watch_transfers = 0;
+	live_watch_bytes = 0;
+	live_watch_read_time = 0;
+	for (struct live_watch_var *var = live_watch_vars; var; var = var->next)
+		live_watch_reset_stats(var, live_watch_start);
+
+	live_watch_running = true;
+	return live_watch_update_timer();
+}
+
+COMMAND_HANDLER(handle_live_watch_stop_command)
+{
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	live_watch_running = false;
+	if (live_watch_file) {
+		fclose(live_watch_file);
+		live_watch_file = NULL;
+	}
+	return live_watch_update_timer();
+}
+
+COMMAND_HANDLER(handle_live_watch_stats_command)
+{
+	if (CMD_ARGC)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int64_t elapsed = live_watch_now() - live_watch_start;
+	if (!live_watch_start || elapsed <= 0) {
+		command_print(CMD, "live watch has not been started");
+		return ERROR_OK;
+	}
+
+	uint64_t total = 0;
+	for (struct live_watch_var *var = live_watch_vars; var; var = var->next) {
+		total += var->samples;
+		command_print(CMD, "%s: %" PRIu64 " samples, %" PRIu64 " errors, %" PRIu64 " missed, "
+				"%.1f Hz (asked %.1f Hz), interval %.1f..%.1f ms, "
+				"jitter avg %.2f max %.2f ms",
+				var->name, var->samples, var->errors, var->missed,
+				var->samples * 1e6 / elapsed, 1000.0 / var->period_ms,
+				var->interval_min / 1000.0, var->interval_max / 1000.0,
+				var->samples > 1 ? var->jitter_sum / 1000.0 / (var->samples - 1) : 0.0,
+				var->jitter_max / 1000.0);
+	}
+
+	command_print(CMD, "%" PRIu64 " samples in %.3f s (%.1f/s), %" PRIu64 " transfers, "
+			"%" PRIu64 " bytes, %.1f%% of the time reading the target",
+			total, elapsed / 1e6, total * 1e6 / elapsed, live_watch_transfers,
+			live_watch_bytes, live_watch_read_time * 100.0 / elapsed);
+	if (live_watch_transfers && live_watch_read_time)
+		command_print(CMD, "max rate about %.0f transfers/s (%.1f us per transfer)",
+				live_watch_transfers * 1e6 / live_watch_read_time,
+				(double)live_watch_read_time / live_watch_transfers);
+	return ERROR_OK;
+}
+
+static const struct command_registration live_watch_subcommand_handlers[] = {
+	{
+		.name = "add",
+		.handler = handle_live_watch_add_command,
+		.mode = COMMAND_EXEC,
+		.help = "sample a variable of the current target periodically",
+		.usage = "name address size(1|2|4|8) period_ms",
+	},
+	{
+		.name = "remove",
+		.handler = handle_live_watch_remove_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop sampling a variable",
+		.usage = "name|'all'",
+	},
+	{
+		.name = "list",
+		.handler = handle_live_watch_list_command,
+		.mode = COMMAND_EXEC,
+		.help = "list the sampled variables",
+		.usage = "",
+	},
+	{
+		.name = "start",
+		.handler = handle_live_watch_start_command,
+		.mode = COMMAND_EXEC,
+		.help = "start sampling, optionally logging the values to a file",
+		.usage = "[filename]",
+	},
+	{
+		.name = "stop",
+		.handler = handle_live_watch_stop_command,
+		.mode = COMMAND_EXEC,
+		.help = "stop sampling",
+		.usage = "",
+	},
+	{
+		.name = "stats",
+		.handler = handle_live_watch_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "show the achieved sample rates and jitter",
+		.usage = "",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+static const struct command_registration live_watch_command_handlers[] = {
+	{
+		.name = "live_watch",
+		.mode = COMMAND_ANY,
+		.help = "sample memory while the target runs",
+		.usage = "",
+		.chain = live_watch_subcommand_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+int live_watch_register_commands(struct command_context *cmd_ctx)
+{
+	return register_commands(cmd_ctx, NULL, live_watch_command_handlers);
+}
@@ -0,0 +1,50 @@
+/***************************************************************************
+ *   Live memory sampling while the target runs                            *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+#ifndef OPENOCD_TARGET_LIVE_WATCH_H
+#define OPENOCD_TARGET_LIVE_WATCH_H
+
+#include <helper/types.h>
+
+struct target;
+struct command_context;
+
+/** One value read by the live watch. */
+struct live_watch_sample {
+	struct target *target;
+	const char *name;
+	target_addr_t address;
+	unsigned int size;
+	uint64_t value;
+	/** Microseconds since "live_watch start". */
+	int64_t timestamp;
+};
+
+/**
+ * Register a function to be called for every value sampled by the live
+ * watch, e.g. to forward it to a server connection.
+ */
+int live_watch_register_callback(
+		int (*callback)(const struct live_watch_sample *sample, void *priv),
+		void *priv);
+int live_watch_unregister_callback(
+		int (*callback)(const struct live_watch_sample *sample, void *priv),
+		void *priv);
+
+int live_watch_register_commands(struct command_context *cmd_ctx);
+
+#endif /* OPENOCD_TARGET_LIVE_WATCH_H */
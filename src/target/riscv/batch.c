@@ -31,6 +31,7 @@ void riscv_batch_free(struct riscv_batch *batch)
 	free(batch->data_in);
 	free(batch->data_out);
 	free(batch->fields);
+	free(batch->read_keys);
 	free(batch);
 }
 
@@ -80,7 +81,7 @@ void riscv_batch_add_dmi_write(struct riscv_batch *batch, unsigned address, uint
 	batch->used_scans++;
 }
 
-size_t riscv_batch_add_dmi_read(struct riscv_batch *batch, unsigned address)
+static void batch_add_dmi_read_scan(struct riscv_batch *batch, unsigned address)
 {
 	assert(batch->used_scans < batch->allocated_scans);
 	struct scan_field *field = batch->fields + batch->used_scans;
@@ -91,6 +92,11 @@ size_t riscv_batch_add_dmi_read(struct riscv_batch *batch, unsigned address)
 	riscv_fill_dmi_nop_u64(batch->target, (char *)field->in_value);
 	batch->last_scan = RISCV_SCAN_TYPE_READ;
 	batch->used_scans++;
+}
+
+size_t riscv_batch_add_dmi_read(struct riscv_batch *batch, unsigned address)
+{
+	batch_add_dmi_read_scan(batch, address);
 
 	/* FIXME We get the read response back on the next scan.  For now I'm
 	 * just sticking a NOP in there, but this should be coalesced away. */
@@ -100,6 +106,17 @@ size_t riscv_batch_add_dmi_read(struct riscv_batch *batch, unsigned address)
 	return batch->read_keys_used++;
 }
 
+size_t riscv_batch_add_dmi_read_pipelined(struct riscv_batch *batch, unsigned address)
+{
+	batch_add_dmi_read_scan(batch, address);
+
+	/* The read response comes back on the next scan, whatever that is.
+	 * riscv_batch_run() ends every batch with a NOP, so there always is
+	 * one. */
+	batch->read_keys[batch->read_keys_used] = batch->used_scans;
+	return batch->read_keys_used++;
+}
+
 uint64_t riscv_batch_get_dmi_read(struct riscv_batch *batch, size_t key)
 {
 	assert(key < batch->read_keys_used);
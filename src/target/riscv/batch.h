@@ -58,6 +58,11 @@ void riscv_batch_add_dmi_write(struct riscv_batch *batch, unsigned address, uint
 size_t riscv_batch_add_dmi_read(struct riscv_batch *batch, unsigned address);
 uint64_t riscv_batch_get_dmi_read(struct riscv_batch *batch, size_t key);
 
+/* Like riscv_batch_add_dmi_read(), but without the NOP after the read: the
+ * result is taken from whatever scan is added next. Used by the system bus
+ * paths, where back-to-back sbdata reads need no gap between them. */
+size_t riscv_batch_add_dmi_read_pipelined(struct riscv_batch *batch, unsigned address);
+
 /* Scans in a NOP. */
 void riscv_batch_add_nop(struct riscv_batch *batch);
 
@@ -1835,37 +1835,6 @@ static void log_memory_access(target_addr_t address, uint64_t value,
 	LOG_DEBUG(fmt, value);
 }
 
-/* Read the relevant sbdata regs depending on size, and put the results into
- * buffer. */
-static int read_memory_bus_word(struct target *target, target_addr_t address,
-		uint32_t size, uint8_t *buffer)
-{
-	uint32_t value;
-	if (size > 12) {
-		if (dmi_read(target, &value, DMI_SBDATA3) != ERROR_OK)
-			return ERROR_FAIL;
-		write_to_buf(buffer + 12, value, 4);
-		log_memory_access(address + 12, value, 4, true);
-	}
-	if (size > 8) {
-		if (dmi_read(target, &value, DMI_SBDATA2) != ERROR_OK)
-			return ERROR_FAIL;
-		write_to_buf(buffer + 8, value, 4);
-		log_memory_access(address + 8, value, 4, true);
-	}
-	if (size > 4) {
-		if (dmi_read(target, &value, DMI_SBDATA1) != ERROR_OK)
-			return ERROR_FAIL;
-		write_to_buf(buffer + 4, value, 4);
-		log_memory_access(address + 4, value, 4, true);
-	}
-	if (dmi_read(target, &value, DMI_SBDATA0) != ERROR_OK)
-		return ERROR_FAIL;
-	write_to_buf(buffer, value, MIN(size, 4));
-	log_memory_access(address, value, MIN(size, 4), true);
-	return ERROR_OK;
-}
-
 static uint32_t sb_sbaccess(unsigned size_bytes)
 {
 	switch (size_bytes) {
@@ -2014,25 +1983,72 @@ static int read_memory_bus_v0(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+static int batch_run(const struct target *target, struct riscv_batch *batch)
+{
+	RISCV013_INFO(info);
+	RISCV_INFO(r);
+	if (r->reset_delays_wait >= 0) {
+		r->reset_delays_wait -= batch->used_scans;
+		if (r->reset_delays_wait <= 0) {
+			batch->idle_count = 0;
+			info->dmi_busy_delay = 0;
+			info->ac_busy_delay = 0;
+		}
+	}
+	return riscv_batch_run(batch);
+}
+
+/* Words moved per riscv_batch in the system bus access paths. */
+#define SBA_BATCH_WORDS 256
+
+/* Called after a batch of system bus accesses found DMI busy or sbbusyerror.
+ * Waits for the bus to become idle and clears the error, so the access can be
+ * restarted. */
+static int sba_recover(struct target *target, bool dmi_busy, uint32_t *sbcs)
+{
+	if (dmi_busy)
+		increase_dmi_busy_delay(target);
+	if (read_sbcs_nonbusy(target, sbcs) != ERROR_OK)
+		return ERROR_FAIL;
+	if (get_field(*sbcs, DMI_SBCS_SBBUSYERROR))
+		dmi_write(target, DMI_SBCS, DMI_SBCS_SBBUSYERROR);
+	return ERROR_OK;
+}
+
+static void sba_log_rate(const char *what, uint32_t size, uint32_t count, int64_t start)
+{
+	int64_t ms = timeval_ms() - start;
+	LOG_DEBUG("%s %d bytes via system bus in %" PRId64 " ms (%.1f KiB/s)",
+			what, size * count, ms, ms ? (size * count) / 1.024 / ms : 0.0);
+}
+
 /**
  * Read the requested memory using the system bus interface.
+ *
+ * With sbreadondata and sbautoincrement set, every sbdata0 read returns one
+ * word and starts the bus read of the next one, so the reads are queued in a
+ * riscv_batch and SBA_BATCH_WORDS words cost one JTAG queue flush. Each batch
+ * ends with an sbcs read. If that shows the bus wasn't done in time
+ * (sbbusyerror), or the DMI was busy, the read restarts from the first word
+ * that may be wrong, with more idle cycles between accesses.
  */
 static int read_memory_bus_v1(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, uint8_t *buffer)
 {
 	RISCV013_INFO(info);
-	target_addr_t next_address = address;
-	target_addr_t end_address = address + count * size;
+	unsigned sbdata_regs = DIV_ROUND_UP(size, 4);
+	int64_t start = timeval_ms();
+	uint32_t index = 0;
 
-	while (next_address < end_address) {
+	while (index < count) {
 		uint32_t sbcs = set_field(0, DMI_SBCS_SBREADONADDR, 1);
 		sbcs |= sb_sbaccess(size);
 		sbcs = set_field(sbcs, DMI_SBCS_SBAUTOINCREMENT, 1);
-		sbcs = set_field(sbcs, DMI_SBCS_SBREADONDATA, count > 1);
+		sbcs = set_field(sbcs, DMI_SBCS_SBREADONDATA, count - index > 1);
 		dmi_write(target, DMI_SBCS, sbcs);
 
 		/* This address write will trigger the first read. */
-		sb_write_address(target, next_address);
+		sb_write_address(target, address + index * size);
 
 		if (info->bus_master_read_delay) {
 			jtag_add_runtest(info->bus_master_read_delay, TAP_IDLE);
@@ -2042,57 +2058,91 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 			}
 		}
 
-		for (uint32_t i = (next_address - address) / size; i < count - 1; i++) {
-			read_memory_bus_word(target, address + i * size, size,
-					buffer + i * size);
-		}
-
-		sbcs = set_field(sbcs, DMI_SBCS_SBREADONDATA, 0);
-		dmi_write(target, DMI_SBCS, sbcs);
+		bool restart = false;
+		while (index < count && !restart) {
+			struct riscv_batch *batch = riscv_batch_alloc(target,
+					SBA_BATCH_WORDS * (sbdata_regs + 1) + 1,
+					info->dmi_busy_delay + info->bus_master_read_delay);
+			uint32_t first = index;
+			uint32_t end = MIN(count, first + SBA_BATCH_WORDS);
+
+			for (uint32_t i = first; i < end; i++) {
+				/* Don't start another bus read after the last word. */
+				if (i == count - 1 && get_field(sbcs, DMI_SBCS_SBREADONDATA))
+					riscv_batch_add_dmi_write(batch, DMI_SBCS,
+							set_field(sbcs, DMI_SBCS_SBREADONDATA, 0));
+				/* sbdata0 last, because reading it starts the next access */
+				for (int j = sbdata_regs - 1; j >= 0; j--)
+					riscv_batch_add_dmi_read_pipelined(batch, DMI_SBDATA0 + j);
+			}
+			size_t sbcs_key = riscv_batch_add_dmi_read_pipelined(batch, DMI_SBCS);
 
-		read_memory_bus_word(target, address + (count - 1) * size, size,
-				buffer + (count - 1) * size);
+			if (batch_run(target, batch) != ERROR_OK) {
+				riscv_batch_free(batch);
+				return ERROR_FAIL;
+			}
 
-		if (read_sbcs_nonbusy(target, &sbcs) != ERROR_OK)
-			return ERROR_FAIL;
+			/* Copy out every word up to the first DMI busy response. */
+			size_t key = 0;
+			for (index = first; index < end; index++) {
+				uint8_t *p = buffer + index * size;
+				uint64_t dmi_out = 0;
+				for (int j = sbdata_regs - 1; j >= 0; j--) {
+					dmi_out = riscv_batch_get_dmi_read(batch, key++);
+					if (get_field(dmi_out, DTM_DMI_OP) != DMI_STATUS_SUCCESS)
+						break;
+					uint32_t value = get_field(dmi_out, DTM_DMI_DATA);
+					write_to_buf(p + 4 * j, value, MIN(size, 4));
+					log_memory_access(address + index * size + 4 * j, value,
+							MIN(size, 4), true);
+				}
+				if (get_field(dmi_out, DTM_DMI_OP) != DMI_STATUS_SUCCESS)
+					break;
+			}
 
-		if (get_field(sbcs, DMI_SBCS_SBBUSYERROR)) {
-			/* We read while the target was busy. Slow down and try again. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBBUSYERROR);
-			next_address = sb_read_address(target);
-			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
-			continue;
-		}
+			uint64_t sbcs_out = riscv_batch_get_dmi_read(batch, sbcs_key);
+			riscv_batch_free(batch);
+
+			dmi_status_t status = get_field(sbcs_out, DTM_DMI_OP);
+			uint32_t sbcs_read = get_field(sbcs_out, DTM_DMI_DATA);
+			if (status == DMI_STATUS_SUCCESS && !get_field(sbcs_read, DMI_SBCS_SBBUSYERROR)) {
+				if (get_field(sbcs_read, DMI_SBCS_SBERROR)) {
+					/* Some error indicating the bus access failed, but not
+					 * because of something we did wrong. */
+					LOG_DEBUG("system bus read failed, sbcs=0x%x", sbcs_read);
+					dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
+					return ERROR_FAIL;
+				}
+				continue;
+			}
 
-		unsigned error = get_field(sbcs, DMI_SBCS_SBERROR);
-		if (error == 0) {
-			next_address = end_address;
-		} else {
-			/* Some error indicating the bus access failed, but not because of
-			 * something we did wrong. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
-			return ERROR_FAIL;
+			if (status != DMI_STATUS_SUCCESS && status != DMI_STATUS_BUSY) {
+				LOG_ERROR("system bus read got DMI error %d", status);
+				return ERROR_FAIL;
+			}
+			if (sba_recover(target, status == DMI_STATUS_BUSY, &sbcs_read) != ERROR_OK)
+				return ERROR_FAIL;
+			if (get_field(sbcs_read, DMI_SBCS_SBBUSYERROR)) {
+				/* We read while the target was busy. The first read that
+				 * failed didn't advance sbaddress, and returned the word the
+				 * bus was still busy with: restart from that one. */
+				target_addr_t failed = sb_read_address(target);
+				uint32_t failed_index = failed > address ? (failed - address) / size : 0;
+				if (failed_index > 0)
+					failed_index--;
+				index = MIN(index, MAX(first, failed_index));
+				info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+				LOG_DEBUG("sbbusyerror at index %d, bus_master_read_delay=%d",
+						index, info->bus_master_read_delay);
+			}
+			restart = true;
 		}
 	}
 
+	sba_log_rate("Read", size, count, start);
 	return ERROR_OK;
 }
 
-static int batch_run(const struct target *target, struct riscv_batch *batch)
-{
-	RISCV013_INFO(info);
-	RISCV_INFO(r);
-	if (r->reset_delays_wait >= 0) {
-		r->reset_delays_wait -= batch->used_scans;
-		if (r->reset_delays_wait <= 0) {
-			batch->idle_count = 0;
-			info->dmi_busy_delay = 0;
-			info->ac_busy_delay = 0;
-		}
-	}
-	return riscv_batch_run(batch);
-}
-
 /**
  * Read the requested memory, taking care to execute every read exactly once,
  * even if cmderr=busy is encountered.
@@ -2385,7 +2435,8 @@ static int read_memory(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, uint8_t *buffer)
 {
 	RISCV013_INFO(info);
-	if (info->progbufsize >= 2 && !riscv_prefer_sba)
+	/* The program buffer needs a halted hart; the system bus doesn't. */
+	if (info->progbufsize >= 2 && !riscv_prefer_sba && target->state == TARGET_HALTED)
 		return read_memory_progbuf(target, address, size, count, buffer);
 
 	if ((get_field(info->sbcs, DMI_SBCS_SBACCESS8) && size == 1) ||
@@ -2494,81 +2545,101 @@ static int write_memory_bus_v0(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+/**
+ * Write the requested memory using the system bus interface.
+ *
+ * Like read_memory_bus_v1(), the sbdata writes are queued in batches of
+ * SBA_BATCH_WORDS words ending with an sbcs read. sbaddress only advances for
+ * writes that made it to the bus, so after sbbusyerror or DMI busy the write
+ * restarts from there.
+ */
 static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer)
 {
 	RISCV013_INFO(info);
-	uint32_t sbcs = sb_sbaccess(size);
-	sbcs = set_field(sbcs, DMI_SBCS_SBAUTOINCREMENT, 1);
-	dmi_write(target, DMI_SBCS, sbcs);
+	unsigned sbdata_regs = DIV_ROUND_UP(size, 4);
+	int64_t start = timeval_ms();
+	uint32_t index = 0;
 
-	target_addr_t next_address = address;
-	target_addr_t end_address = address + count * size;
-
-	sb_write_address(target, next_address);
-	while (next_address < end_address) {
-		for (uint32_t i = (next_address - address) / size; i < count; i++) {
-			const uint8_t *p = buffer + i * size;
-			if (size > 12)
-				dmi_write(target, DMI_SBDATA3,
-						((uint32_t) p[12]) |
-						(((uint32_t) p[13]) << 8) |
-						(((uint32_t) p[14]) << 16) |
-						(((uint32_t) p[15]) << 24));
-			if (size > 8)
-				dmi_write(target, DMI_SBDATA2,
-						((uint32_t) p[8]) |
-						(((uint32_t) p[9]) << 8) |
-						(((uint32_t) p[10]) << 16) |
-						(((uint32_t) p[11]) << 24));
-			if (size > 4)
-				dmi_write(target, DMI_SBDATA1,
-						((uint32_t) p[4]) |
-						(((uint32_t) p[5]) << 8) |
-						(((uint32_t) p[6]) << 16) |
-						(((uint32_t) p[7]) << 24));
-			uint32_t value = p[0];
-			if (size > 2) {
-				value |= ((uint32_t) p[2]) << 16;
-				value |= ((uint32_t) p[3]) << 24;
+	while (index < count) {
+		uint32_t sbcs = sb_sbaccess(size);
+		sbcs = set_field(sbcs, DMI_SBCS_SBAUTOINCREMENT, 1);
+		dmi_write(target, DMI_SBCS, sbcs);
+		sb_write_address(target, address + index * size);
+
+		bool restart = false;
+		while (index < count && !restart) {
+			struct riscv_batch *batch = riscv_batch_alloc(target,
+					SBA_BATCH_WORDS * sbdata_regs + 1,
+					info->dmi_busy_delay + info->bus_master_write_delay);
+			uint32_t first = index;
+			uint32_t end = MIN(count, first + SBA_BATCH_WORDS);
+
+			for (uint32_t i = first; i < end; i++) {
+				const uint8_t *p = buffer + i * size;
+				/* sbdata0 last, because writing it starts the bus write */
+				for (int j = sbdata_regs - 1; j >= 0; j--) {
+					uint32_t value = buf_get_u32(p + 4 * j, 0, 8 * MIN(size, 4));
+					riscv_batch_add_dmi_write(batch, DMI_SBDATA0 + j, value);
+					log_memory_access(address + i * size + 4 * j, value,
+							MIN(size, 4), false);
+				}
 			}
-			if (size > 1)
-				value |= ((uint32_t) p[1]) << 8;
-			dmi_write(target, DMI_SBDATA0, value);
+			size_t sbcs_key = riscv_batch_add_dmi_read_pipelined(batch, DMI_SBCS);
 
-			log_memory_access(address + i * size, value, size, false);
-
-			if (info->bus_master_write_delay) {
-				jtag_add_runtest(info->bus_master_write_delay, TAP_IDLE);
-				if (jtag_execute_queue() != ERROR_OK) {
-					LOG_ERROR("Failed to scan idle sequence");
+			if (batch_run(target, batch) != ERROR_OK) {
+				riscv_batch_free(batch);
+				return ERROR_FAIL;
+			}
+			uint64_t sbcs_out = riscv_batch_get_dmi_read(batch, sbcs_key);
+			riscv_batch_free(batch);
+
+			/* DMI busy is sticky, so any busy write in the batch shows up
+			 * on the sbcs read at its end. */
+			dmi_status_t status = get_field(sbcs_out, DTM_DMI_OP);
+			uint32_t sbcs_read = get_field(sbcs_out, DTM_DMI_DATA);
+			if (status == DMI_STATUS_SUCCESS && !get_field(sbcs_read, DMI_SBCS_SBBUSYERROR)) {
+				if (get_field(sbcs_read, DMI_SBCS_SBERROR)) {
+					/* Some error indicating the bus access failed, but not
+					 * because of something we did wrong. */
+					LOG_DEBUG("system bus write failed, sbcs=0x%x", sbcs_read);
+					dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
 					return ERROR_FAIL;
 				}
+				index = end;
+				continue;
 			}
-		}
-
-		if (read_sbcs_nonbusy(target, &sbcs) != ERROR_OK)
-			return ERROR_FAIL;
 
-		if (get_field(sbcs, DMI_SBCS_SBBUSYERROR)) {
-			/* We wrote while the target was busy. Slow down and try again. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBBUSYERROR);
-			next_address = sb_read_address(target);
-			info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
-			continue;
+			if (status != DMI_STATUS_SUCCESS && status != DMI_STATUS_BUSY) {
+				LOG_ERROR("system bus write got DMI error %d", status);
+				return ERROR_FAIL;
+			}
+			if (sba_recover(target, status == DMI_STATUS_BUSY, &sbcs_read) != ERROR_OK)
+				return ERROR_FAIL;
+			if (get_field(sbcs_read, DMI_SBCS_SBBUSYERROR)) {
+				/* We wrote while the target was busy. Slow down. */
+				info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
+			}
+			target_addr_t next_address = sb_read_address(target);
+			uint32_t next_index = next_address > address ? (next_address - address) / size : 0;
+			index = MIN(end, MAX(first, next_index));
+			LOG_DEBUG("restarting system bus write at index %d, bus_master_write_delay=%d",
+					index, info->bus_master_write_delay);
+			restart = true;
 		}
+	}
 
-		unsigned error = get_field(sbcs, DMI_SBCS_SBERROR);
-		if (error == 0) {
-			next_address = end_address;
-		} else {
-			/* Some error indicating the bus access failed, but not because of
-			 * something we did wrong. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
-			return ERROR_FAIL;
-		}
+	/* Make sure the last write has completed. */
+	uint32_t sbcs;
+	if (read_sbcs_nonbusy(target, &sbcs) != ERROR_OK)
+		return ERROR_FAIL;
+	if (get_field(sbcs, DMI_SBCS_SBERROR)) {
+		LOG_DEBUG("system bus write failed, sbcs=0x%x", sbcs);
+		dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
+		return ERROR_FAIL;
 	}
 
+	sba_log_rate("Wrote", size, count, start);
 	return ERROR_OK;
 }
 
@@ -2779,6 +2850,177 @@ static int write_memory(struct target *target, target_addr_t address,
 	return ERROR_FAIL;
 }
 
+/* Operations of a mem_batch queued per riscv_batch. */
+#define MEM_BATCH_OPS 64
+/* sbcs, up to four address words, two data registers and the sbcs check */
+#define MEM_BATCH_OP_SCANS 8
+
+static bool mem_batch_use_bus(struct target *target, const struct target_mem_op *op)
+{
+	RISCV013_INFO(info);
+
+	if (get_field(info->sbcs, DMI_SBCS_SBVERSION) != 1)
+		return false;
+	if (!((get_field(info->sbcs, DMI_SBCS_SBACCESS8) && op->size == 1) ||
+			(get_field(info->sbcs, DMI_SBCS_SBACCESS16) && op->size == 2) ||
+			(get_field(info->sbcs, DMI_SBCS_SBACCESS32) && op->size == 4) ||
+			(get_field(info->sbcs, DMI_SBCS_SBACCESS64) && op->size == 8)))
+		return false;
+	/* same choice as read_memory() and write_memory() */
+	if (info->progbufsize < 2 || riscv_prefer_sba)
+		return true;
+	return !op->write && target->state != TARGET_HALTED;
+}
+
+/**
+ * Run a batch of single memory accesses with the system bus interface.
+ *
+ * Every access is queued as an sbcs write, the address and the sbdata
+ * accesses, followed by an sbcs read, so MEM_BATCH_OPS accesses cost one
+ * JTAG queue flush. The sbcs read after each access tells which access
+ * first hit DMI busy or sbbusyerror. Those before it are done; the batch
+ * restarts from that access with more idle cycles.
+ */
+static int mem_batch_bus_v1(struct target *target, struct target_mem_op *ops,
+		unsigned int count)
+{
+	RISCV013_INFO(info);
+	unsigned sbasize = get_field(info->sbcs, DMI_SBCS_SBASIZE);
+	unsigned int index = 0;
+
+	while (index < count) {
+		unsigned int first = index;
+		unsigned int end = MIN(count, first + MEM_BATCH_OPS);
+		struct riscv_batch *batch = riscv_batch_alloc(target,
+				(end - first) * MEM_BATCH_OP_SCANS + 1,
+				info->dmi_busy_delay +
+				MAX(info->bus_master_read_delay, info->bus_master_write_delay));
+		size_t data_keys[MEM_BATCH_OPS][2];
+		size_t sbcs_keys[MEM_BATCH_OPS];
+
+		for (unsigned int i = first; i < end; i++) {
+			struct target_mem_op *op = &ops[i];
+			unsigned int sbdata_regs = DIV_ROUND_UP(op->size, 4);
+			uint32_t sbcs = sb_sbaccess(op->size);
+			if (!op->write)
+				sbcs = set_field(sbcs, DMI_SBCS_SBREADONADDR, 1);
+			riscv_batch_add_dmi_write(batch, DMI_SBCS, sbcs);
+
+			if (sbasize > 96)
+				riscv_batch_add_dmi_write(batch, DMI_SBADDRESS3, 0);
+			if (sbasize > 64)
+				riscv_batch_add_dmi_write(batch, DMI_SBADDRESS2, 0);
+			if (sbasize > 32)
+				riscv_batch_add_dmi_write(batch, DMI_SBADDRESS1,
+						(uint64_t)op->address >> 32);
+
+			if (op->write) {
+				/* sbdata0 last, because writing it starts the bus write */
+				riscv_batch_add_dmi_write(batch, DMI_SBADDRESS0, op->address);
+				for (int j = sbdata_regs - 1; j >= 0; j--)
+					riscv_batch_add_dmi_write(batch, DMI_SBDATA0 + j,
+							buf_get_u32(op->data + 4 * j, 0, 8 * MIN(op->size, 4)));
+			} else {
+				/* writing sbaddress0 starts the bus read */
+				riscv_batch_add_dmi_write(batch, DMI_SBADDRESS0, op->address);
+				for (unsigned int j = 0; j < sbdata_regs; j++)
+					data_keys[i - first][j] =
+						riscv_batch_add_dmi_read_pipelined(batch, DMI_SBDATA0 + j);
+			}
+			sbcs_keys[i - first] = riscv_batch_add_dmi_read_pipelined(batch, DMI_SBCS);
+		}
+
+		if (batch_run(target, batch) != ERROR_OK) {
+			riscv_batch_free(batch);
+			return ERROR_FAIL;
+		}
+
+		for (index = first; index < end; index++) {
+			struct target_mem_op *op = &ops[index];
+			uint64_t sbcs_out = riscv_batch_get_dmi_read(batch, sbcs_keys[index - first]);
+			dmi_status_t status = get_field(sbcs_out, DTM_DMI_OP);
+			uint32_t sbcs_read = get_field(sbcs_out, DTM_DMI_DATA);
+
+			if (status != DMI_STATUS_SUCCESS || get_field(sbcs_read, DMI_SBCS_SBBUSYERROR))
+				break;
+			if (get_field(sbcs_read, DMI_SBCS_SBERROR)) {
+				riscv_batch_free(batch);
+				LOG_ERROR("system bus %s at 0x%" TARGET_PRIxADDR " failed, sbcs=0x%x",
+						op->write ? "write" : "read", op->address, sbcs_read);
+				dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
+				return ERROR_FAIL;
+			}
+
+			if (!op->write) {
+				for (unsigned int j = 0; j < DIV_ROUND_UP(op->size, 4); j++) {
+					uint64_t dmi_out = riscv_batch_get_dmi_read(batch,
+							data_keys[index - first][j]);
+					write_to_buf(op->data + 4 * j, get_field(dmi_out, DTM_DMI_DATA),
+							MIN(op->size, 4));
+				}
+				log_memory_access(op->address, buf_get_u64(op->data, 0, 8 * op->size),
+						op->size, true);
+			} else {
+				log_memory_access(op->address, buf_get_u64(op->data, 0, 8 * op->size),
+						op->size, false);
+			}
+		}
+
+		if (index == end) {
+			riscv_batch_free(batch);
+			continue;
+		}
+
+		uint64_t sbcs_out = riscv_batch_get_dmi_read(batch, sbcs_keys[index - first]);
+		riscv_batch_free(batch);
+		dmi_status_t status = get_field(sbcs_out, DTM_DMI_OP);
+		uint32_t sbcs_read = get_field(sbcs_out, DTM_DMI_DATA);
+		if (status != DMI_STATUS_SUCCESS && status != DMI_STATUS_BUSY) {
+			LOG_ERROR("system bus access got DMI error %d", status);
+			return ERROR_FAIL;
+		}
+		if (sba_recover(target, status == DMI_STATUS_BUSY, &sbcs_read) != ERROR_OK)
+			return ERROR_FAIL;
+		if (status == DMI_STATUS_SUCCESS) {
+			/* sbbusyerror: the bus was still busy with this access */
+			if (ops[index].write)
+				info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
+			else
+				info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
+		}
+		LOG_DEBUG("mem_batch restarts at access %u, bus_master_read_delay=%d, "
+				"bus_master_write_delay=%d", index, info->bus_master_read_delay,
+				info->bus_master_write_delay);
+	}
+
+	return ERROR_OK;
+}
+
+/**
+ * Batches that the system bus can do entirely are queued by
+ * mem_batch_bus_v1(). Otherwise every access goes through read_memory() or
+ * write_memory(); program buffer accesses are not batched.
+ */
+static int mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count)
+{
+	bool bus = true;
+	for (unsigned int i = 0; i < count && bus; i++)
+		bus = mem_batch_use_bus(target, &ops[i]);
+	if (bus)
+		return mem_batch_bus_v1(target, ops, count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		int result;
+		if (ops[i].write)
+			result = write_memory(target, ops[i].address, ops[i].size, 1, ops[i].data);
+		else
+			result = read_memory(target, ops[i].address, ops[i].size, 1, ops[i].data);
+		if (result != ERROR_OK)
+			return result;
+	}
+	return ERROR_OK;
+}
+
 static int arch_state(struct target *target)
 {
 	return ERROR_OK;
@@ -2801,6 +3043,7 @@ struct target_type riscv013_target = {
 
 	.read_memory = read_memory,
 	.write_memory = write_memory,
+	.mem_batch = mem_batch,
 
 	.arch_state = arch_state,
 };
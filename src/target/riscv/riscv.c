@@ -926,6 +926,27 @@ static int riscv_write_memory(struct target *target, target_addr_t address,
 	return tt->write_memory(target, address, size, count, buffer);
 }
 
+static int riscv_mem_batch(struct target *target, struct target_mem_op *ops,
+		unsigned int count)
+{
+	if (riscv_select_current_hart(target) != ERROR_OK)
+		return ERROR_FAIL;
+	struct target_type *tt = get_target_type(target);
+	if (tt->mem_batch)
+		return tt->mem_batch(target, ops, count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		int result;
+		if (ops[i].write)
+			result = tt->write_memory(target, ops[i].address, ops[i].size, 1, ops[i].data);
+		else
+			result = tt->read_memory(target, ops[i].address, ops[i].size, 1, ops[i].data);
+		if (result != ERROR_OK)
+			return result;
+	}
+	return ERROR_OK;
+}
+
 static int riscv_get_gdb_reg_list_internal(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class, bool read)
@@ -1979,6 +2000,7 @@ struct target_type riscv_target = {
 
 	.read_memory = riscv_read_memory,
 	.write_memory = riscv_write_memory,
+	.mem_batch = riscv_mem_batch,
 
 	.checksum_memory = riscv_checksum_memory,
 
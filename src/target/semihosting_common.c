@@ -50,6 +50,7 @@
 
 #include <helper/binarybuffer.h>
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include <sys/stat.h>
 
 static const int open_modeflags[12] = {
@@ -805,31 +806,20 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
-					uint8_t *buf = malloc(len);
-					if (!buf) {
-						semihosting->result = -1;
-						semihosting->sys_errno = ENOMEM;
-					} else {
-						semihosting->result = read(fd, buf, len);
-						semihosting->sys_errno = errno;
-						LOG_DEBUG("read(%d, 0x%" PRIx64 ", %zu)=%d",
-							fd,
-							addr,
-							len,
-							(int)semihosting->result);
-						if (semihosting->result >= 0) {
-							retval = target_write_buffer(target, addr,
-									semihosting->result,
-									buf);
-							if (retval != ERROR_OK) {
-								free(buf);
-								return retval;
-							}
-							/* the number of bytes NOT filled in */
-							semihosting->result = len -
-								semihosting->result;
-						}
-						free(buf);
+					retval = semihosting_io_read(target, fd, addr, len,
+							&semihosting->result,
+							&semihosting->sys_errno);
+					if (retval != ERROR_OK)
+						return retval;
+					LOG_DEBUG("read(%d, 0x%" PRIx64 ", %zu)=%d",
+						fd,
+						addr,
+						len,
+						(int)semihosting->result);
+					if (semihosting->result >= 0) {
+						/* the number of bytes NOT filled in */
+						semihosting->result = len -
+							semihosting->result;
 					}
 				}
 			}
@@ -1142,31 +1132,21 @@ int semihosting_common(struct target *target)
 					fileio_info->param_2 = addr;
 					fileio_info->param_3 = len;
 				} else {
-					uint8_t *buf = malloc(len);
-					if (!buf) {
-						semihosting->result = -1;
-						semihosting->sys_errno = ENOMEM;
-					} else {
-						retval = target_read_buffer(target, addr, len, buf);
-						if (retval != ERROR_OK) {
-							free(buf);
-							return retval;
-						}
-						semihosting->result = write(fd, buf, len);
-						semihosting->sys_errno = errno;
-						LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu)=%d",
-							fd,
-							addr,
-							len,
-							(int)semihosting->result);
-						if (semihosting->result >= 0) {
-							/* The number of bytes that are NOT written.
-							 * */
-							semihosting->result = len -
-								semihosting->result;
-						}
-
-						free(buf);
+					retval = semihosting_io_write(target, fd, addr, len,
+							&semihosting->result,
+							&semihosting->sys_errno);
+					if (retval != ERROR_OK)
+						return retval;
+					LOG_DEBUG("write(%d, 0x%" PRIx64 ", %zu)=%d",
+						fd,
+						addr,
+						len,
+						(int)semihosting->result);
+					if (semihosting->result >= 0) {
+						/* The number of bytes that are NOT written.
+						 * */
+						semihosting->result = len -
+							semihosting->result;
 					}
 				}
 			}
@@ -1456,6 +1436,93 @@ static void semihosting_set_field(struct target *target, uint64_t value,
 }
 
 
+/* -------------------------------------------------------------------------
+ * Bulk data transfers. */
+
+/*
+ * SYS_READ/SYS_WRITE data is moved through this buffer chunk by chunk,
+ * so a large request neither allocates memory nor builds one huge
+ * adapter queue. The command loop is single threaded, a single
+ * buffer serves all targets.
+ */
+static uint8_t semihosting_io_buf[SEMIHOSTING_IO_CHUNK_SIZE];
+
+static void semihosting_io_log_rate(const char *op, int fd, size_t len,
+	struct duration *bench)
+{
+	if (!LOG_LEVEL_IS(LOG_LVL_DEBUG) || duration_measure(bench) != ERROR_OK)
+		return;
+	LOG_DEBUG("%s(%d) %zu bytes in %fs (%0.3f KiB/s)", op, fd, len,
+		duration_elapsed(bench), duration_kbps(bench, len));
+}
+
+int semihosting_io_read(struct target *target, int fd, target_addr_t addr,
+	size_t len, int64_t *result, int *host_errno)
+{
+	struct duration bench;
+	size_t done = 0;
+
+	duration_start(&bench);
+	*host_errno = 0;
+	while (done < len) {
+		size_t chunk = MIN(len - done, sizeof(semihosting_io_buf));
+		ssize_t n = read(fd, semihosting_io_buf, chunk);
+		*host_errno = errno;
+		if (n < 0) {
+			if (done == 0) {
+				*result = -1;
+				return ERROR_OK;
+			}
+			break;
+		}
+		if (n > 0) {
+			int retval = target_write_buffer(target, addr + done, n,
+					semihosting_io_buf);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		done += n;
+		/* EOF or an interactive device, don't block waiting for more */
+		if ((size_t)n < chunk)
+			break;
+	}
+	*result = done;
+	semihosting_io_log_rate("read", fd, done, &bench);
+	return ERROR_OK;
+}
+
+int semihosting_io_write(struct target *target, int fd, target_addr_t addr,
+	size_t len, int64_t *result, int *host_errno)
+{
+	struct duration bench;
+	size_t done = 0;
+
+	duration_start(&bench);
+	*host_errno = 0;
+	while (done < len) {
+		size_t chunk = MIN(len - done, sizeof(semihosting_io_buf));
+		int retval = target_read_buffer(target, addr + done, chunk,
+				semihosting_io_buf);
+		if (retval != ERROR_OK)
+			return retval;
+		ssize_t n = write(fd, semihosting_io_buf, chunk);
+		*host_errno = errno;
+		if (n < 0) {
+			if (done == 0) {
+				*result = -1;
+				return ERROR_OK;
+			}
+			break;
+		}
+		done += n;
+		if ((size_t)n < chunk)
+			break;
+	}
+	*result = done;
+	semihosting_io_log_rate("write", fd, done, &bench);
+	return ERROR_OK;
+}
+
 /* -------------------------------------------------------------------------
  * Common semihosting commands handlers. */
 
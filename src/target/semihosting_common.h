@@ -25,6 +25,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <time.h>
+#include <helper/types.h>
 
 /*
  * According to:
@@ -156,8 +157,23 @@ struct semihosting {
 	int (*post_result)(struct target *target);
 };
 
+/** Largest block of SYS_READ/SYS_WRITE data moved at once. */
+#define SEMIHOSTING_IO_CHUNK_SIZE	(16 * 1024)
+
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
 int semihosting_common(struct target *target);
 
+/**
+ * Move up to @a len bytes between the host file @a fd and target memory at
+ * @a addr in bounded chunks. On return @a result holds the number of bytes
+ * transferred, or -1 if nothing could be transferred, and @a host_errno
+ * the errno of the last host call. An error code is returned only if
+ * target memory could not be accessed.
+ */
+int semihosting_io_read(struct target *target, int fd, target_addr_t addr,
+	size_t len, int64_t *result, int *host_errno);
+int semihosting_io_write(struct target *target, int fd, target_addr_t addr,
+	size_t len, int64_t *result, int *host_errno);
+
 #endif	/* OPENOCD_TARGET_SEMIHOSTING_COMMON_H */
@@ -51,6 +51,7 @@
 #include "breakpoints.h"
 #include "register.h"
 #include "trace.h"
+#include "live_watch.h"
 #include "image.h"
 #include "rtos/rtos.h"
 #include "transport/transport.h"
@@ -74,6 +75,7 @@ static int target_gdb_fileio_end_default(struct target *target, int retcode,
 		int fileio_errno, bool ctrl_c);
 static int target_profiling_default(struct target *target, uint32_t *samples,
 		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds);
+static int target_release_persistent_working_areas_before_run(struct target *target);
 
 static size_t target_get_active_core_default(struct target *target);
 static void target_set_active_core_default(struct target *target, size_t core);
@@ -210,6 +212,7 @@ static const Jim_Nvp nvp_target_event[] = {
 	{ .value = TARGET_EVENT_RESUMED, .name = "resumed" },
 	{ .value = TARGET_EVENT_RESUME_START, .name = "resume-start" },
 	{ .value = TARGET_EVENT_RESUME_END, .name = "resume-end" },
+	{ .value = TARGET_EVENT_STEP_START, .name = "step-start" },
 
 	{ .name = "gdb-start", .value = TARGET_EVENT_GDB_START },
 	{ .name = "gdb-end", .value = TARGET_EVENT_GDB_END },
@@ -643,6 +646,14 @@ int target_resume(struct target *target, int current, target_addr_t address,
 
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_START);
 
+	/* the target is leaving the halted state, put back the memory
+	 * held by persistent working areas */
+	if (!debug_execution) {
+		retval = target_release_persistent_working_areas_before_run(target);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
 	/* note that resume *must* be asynchronous. The CPU can halt before
 	 * we poll. The CPU can even halt at the current PC as a result of
 	 * a software breakpoint being inserted by (a bug?) the application.
@@ -668,8 +679,11 @@ static int target_process_reset(struct command_invocation *cmd, enum target_rese
 	}
 
 	struct target *target;
-	for (target = all_targets; target; target = target->next)
+	for (target = all_targets; target; target = target->next) {
 		target_call_reset_callbacks(target, reset_mode);
+		/* RAM contents do not survive reset, forget what was saved */
+		target_release_persistent_working_areas(target, 0);
+	}
 
 	/* disable polling during reset to make reset event scripts
 	 * more predictable, i.e. dr/irscan & pathmove in events will
@@ -1184,6 +1198,32 @@ int target_write_phys_memory(struct target *target,
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
+int target_mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count)
+{
+	if (!target_was_examined(target)) {
+		LOG_ERROR("Target not examined yet");
+		return ERROR_FAIL;
+	}
+
+	bool queued = target->type->mem_batch != NULL;
+	for (unsigned int i = 0; i < count && queued; i++)
+		queued = ops[i].size <= 4;
+	if (queued)
+		return target->type->mem_batch(target, ops, count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		int retval;
+		if (ops[i].write)
+			retval = target_write_memory(target, ops[i].address, ops[i].size, 1, ops[i].data);
+		else
+			retval = target_read_memory(target, ops[i].address, ops[i].size, 1, ops[i].data);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
 int target_add_breakpoint(struct target *target,
 		struct breakpoint *breakpoint)
 {
@@ -1295,6 +1335,13 @@ bool target_supports_gdb_connection(struct target *target)
 int target_step(struct target *target,
 		int current, target_addr_t address, int handle_breakpoints)
 {
+	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
+
+	/* a single step runs user code as well */
+	int retval = target_release_persistent_working_areas_before_run(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return target->type->step(target, current, address, handle_breakpoints);
 }
 
@@ -1878,6 +1925,112 @@ static void target_merge_working_areas(struct working_area_config *wa_cfg)
 	}
 }
 
+/* Extend the saved range of a persistent working area so that it covers
+ * [address, address + size). Only the bytes not saved yet are read from the target. */
+static int target_save_working_area_range(struct target *target, struct working_area_config *wa_cfg,
+		target_addr_t address, uint32_t size)
+{
+	uint32_t start = address - wa_cfg->area;
+	uint32_t end = start + size;
+	int retval;
+
+	if (wa_cfg->saved && start >= wa_cfg->saved_start && end <= wa_cfg->saved_end) {
+		wa_cfg->saved_hits++;
+		return ERROR_OK;
+	}
+
+	if (wa_cfg->saved == NULL) {
+		wa_cfg->saved = malloc(wa_cfg->size & ~3UL);
+		if (wa_cfg->saved == NULL)
+			return ERROR_FAIL;
+		wa_cfg->saved_start = start;
+		wa_cfg->saved_end = start;
+	}
+
+	if (start < wa_cfg->saved_start) {
+		retval = target_read_memory(target, wa_cfg->area + start, 4,
+				(wa_cfg->saved_start - start) / 4, wa_cfg->saved + start);
+		if (retval != ERROR_OK)
+			return retval;
+		wa_cfg->saved_start = start;
+	}
+	if (end > wa_cfg->saved_end) {
+		retval = target_read_memory(target, wa_cfg->area + wa_cfg->saved_end, 4,
+				(end - wa_cfg->saved_end) / 4, wa_cfg->saved + wa_cfg->saved_end);
+		if (retval != ERROR_OK)
+			return retval;
+		wa_cfg->saved_end = end;
+	}
+
+	return ERROR_OK;
+}
+
+/* Write back the saved range of a persistent working area, if any, and drop it */
+static int target_restore_persistent_working_area(struct target *target,
+		struct working_area_config *wa_cfg, int restore)
+{
+	struct duration bench;
+	int retval = ERROR_OK;
+
+	if (wa_cfg->saved == NULL)
+		return ERROR_OK;
+
+	if (restore && wa_cfg->saved_end > wa_cfg->saved_start) {
+		duration_start(&bench);
+		retval = target_write_memory(target, wa_cfg->area + wa_cfg->saved_start, 4,
+				(wa_cfg->saved_end - wa_cfg->saved_start) / 4,
+				wa_cfg->saved + wa_cfg->saved_start);
+		if (retval != ERROR_OK)
+			LOG_ERROR("failed to restore %" PRIu32 " bytes of persistent working area at address "
+					TARGET_ADDR_FMT, wa_cfg->saved_end - wa_cfg->saved_start,
+					wa_cfg->area + wa_cfg->saved_start);
+		else if (duration_measure(&bench) == 0)
+			LOG_DEBUG("PROF: Restored %" PRIu32 " bytes of persistent working area in %g ms, "
+					"%" PRIu32 " backups and %" PRIu32 " restores skipped",
+					wa_cfg->saved_end - wa_cfg->saved_start,
+					duration_elapsed(&bench) * 1000,
+					wa_cfg->saved_hits, wa_cfg->skipped_restores);
+	}
+
+	free(wa_cfg->saved);
+	wa_cfg->saved = NULL;
+	wa_cfg->saved_start = 0;
+	wa_cfg->saved_end = 0;
+	wa_cfg->saved_hits = 0;
+	wa_cfg->skipped_restores = 0;
+
+	return retval;
+}
+
+/* Restore (or just drop, e.g. on reset) the memory saved for persistent working areas.
+ * Called when the target leaves the halted state on behalf of the user. */
+int target_release_persistent_working_areas(struct target *target, int restore)
+{
+	int retval = target_restore_persistent_working_area(target, &target->working_area_cfg, restore);
+	int retval2 = target_restore_persistent_working_area(target, &target->alt_working_area_cfg, restore);
+
+	return retval != ERROR_OK ? retval : retval2;
+}
+
+/* User code is about to run: restore the persistent working areas of @a target
+ * and, for SMP, of the other cores, which the target type may restart as well. */
+static int target_release_persistent_working_areas_before_run(struct target *target)
+{
+	int retval = target_release_persistent_working_areas(target, 1);
+
+	if (target->smp) {
+		for (struct target_list *head = target->head; head; head = head->next) {
+			if (head->target == target)
+				continue;
+			int retval2 = target_release_persistent_working_areas(head->target, 1);
+			if (retval == ERROR_OK)
+				retval = retval2;
+		}
+	}
+
+	return retval;
+}
+
 static int alloc_working_area_try_do(struct target *target, struct working_area_config *wa_cfg, uint32_t size, struct working_area **area)
 {
 	/* Reevaluate working area address based on MMU state*/
@@ -1931,13 +2084,16 @@ static int alloc_working_area_try_do(struct target *target, struct working_area_
 	if (size % 4)
 		size = (size + 3) & (~3UL);
 
-	struct working_area *c = wa_cfg->areas;
+	struct working_area *c = NULL;
 
-	/* Find the first large enough working area */
-	while (c) {
-		if (c->free && c->size >= size)
-			break;
-		c = c->next;
+	/* Find the smallest large enough working area, so that big free areas stay
+	 * available for flash buffers allocated after the algorithm code */
+	for (struct working_area *i = wa_cfg->areas; i; i = i->next) {
+		if (i->free && i->size >= size && (c == NULL || i->size < c->size)) {
+			c = i;
+			if (c->size == size)
+				break;
+		}
 	}
 
 	if (c == NULL)
@@ -1949,7 +2105,11 @@ static int alloc_working_area_try_do(struct target *target, struct working_area_
 	LOG_DEBUG("allocated new working area of %" PRIu32 " bytes at address " TARGET_ADDR_FMT,
 			  size, c->address);
 
-	if (wa_cfg->backup) {
+	if (wa_cfg->backup && wa_cfg->persistent) {
+		int retval = target_save_working_area_range(target, wa_cfg, c->address, c->size);
+		if (retval != ERROR_OK)
+			return retval;
+	} else if (wa_cfg->backup) {
 		if (c->backup == NULL) {
 			c->backup = malloc(c->size);
 			if (c->backup == NULL)
@@ -2007,6 +2167,12 @@ static int target_restore_working_area(struct target *target, struct working_are
 {
 	int retval = ERROR_OK;
 
+	if (wa_cfg->backup && wa_cfg->persistent) {
+		/* deferred until the target is resumed */
+		wa_cfg->skipped_restores++;
+		return ERROR_OK;
+	}
+
 	if (wa_cfg->backup && area->backup != NULL) {
 		retval = target_write_memory(target, area->address, 4, area->size / 4, area->backup);
 		if (retval != ERROR_OK)
@@ -2061,6 +2227,11 @@ int target_free_alt_working_area(struct target *target, struct working_area *are
 	return target_free_working_area_restore(target, &target->alt_working_area_cfg, area, 1);
 }
 
+int target_discard_working_area(struct target *target, struct working_area *area)
+{
+	return target_free_working_area_restore(target, &target->working_area_cfg, area, 0);
+}
+
 /* free resources and restore memory, if restoring memory fails,
  * free up resources anyway
  */
@@ -2085,6 +2256,8 @@ static void target_free_all_working_areas_restore(struct target *target, struct
 	/* Run a merge pass to combine all areas into one */
 	target_merge_working_areas(wa_cfg);
 
+	target_restore_persistent_working_area(target, wa_cfg, restore);
+
 	print_wa_layout(wa_cfg);
 }
 
@@ -2181,6 +2354,11 @@ static void target_destroy(struct target *target)
 
 void target_quit(void)
 {
+	/* OpenOCD lets go of the targets, give the memory held by persistent
+	 * working areas back while the target types are still usable */
+	for (struct target *target = all_targets; target; target = target->next)
+		target_release_persistent_working_areas(target, target->state == TARGET_HALTED);
+
 	target_call_exit_callbacks();
 
 	struct target_event_callback *pe = target_event_callbacks;
@@ -3279,7 +3457,7 @@ COMMAND_HANDLER(handle_step_command)
 
 	struct target *target = get_current_target(CMD_CTX);
 
-	return target->type->step(target, current_pc, addr, 1);
+	return target_step(target, current_pc, addr, 1);
 }
 
 COMMAND_HANDLER(handle_set_cpu_command)
@@ -3559,6 +3737,10 @@ static COMMAND_HELPER(parse_load_image_command_CMD_ARGV, struct image *image,
 	return ERROR_OK;
 }
 
+/* load_image writes each section in chunks of this size; before a chunk
+ * goes to the target, the kernel is asked to read ahead the next one */
+#define LOAD_IMAGE_CHUNK_SIZE		(256 * 1024)
+
 COMMAND_HANDLER(handle_load_image_command)
 {
 	uint8_t *buffer;
@@ -3582,56 +3764,67 @@ COMMAND_HANDLER(handle_load_image_command)
 	if (image_open(&image, CMD_ARGV[0], (CMD_ARGC >= 3) ? CMD_ARGV[2] : NULL) != ERROR_OK)
 		return ERROR_FAIL;
 
+	buffer = malloc(LOAD_IMAGE_CHUNK_SIZE);
+	if (buffer == NULL) {
+		command_print(CMD, "error allocating load buffer");
+		image_close(&image);
+		return ERROR_FAIL;
+	}
+
 	image_size = 0x0;
 	retval = ERROR_OK;
-	for (i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (buffer == NULL) {
-			command_print(CMD,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			break;
-		}
-
+	for (i = 0; i < image.num_sections && retval == ERROR_OK; i++) {
+		target_addr_t base_address = image.sections[i].base_address;
+		uint32_t section_size = image.sections[i].size;
 		uint32_t offset = 0;
-		uint32_t length = buf_cnt;
+		uint32_t length = section_size;
 
 		/* DANGER!!! beware of unsigned comparision here!!! */
 
-		if ((image.sections[i].base_address + buf_cnt >= min_address) &&
-				(image.sections[i].base_address < max_address)) {
+		if (!((base_address + section_size >= min_address) &&
+				(base_address < max_address)))
+			continue;
 
-			if (image.sections[i].base_address < min_address) {
-				/* clip addresses below */
-				offset += min_address-image.sections[i].base_address;
-				length -= offset;
-			}
+		if (base_address < min_address) {
+			/* clip addresses below */
+			offset += min_address - base_address;
+			length -= offset;
+		}
 
-			if (image.sections[i].base_address + buf_cnt > max_address)
-				length -= (image.sections[i].base_address + buf_cnt)-max_address;
+		if (base_address + section_size > max_address)
+			length -= (base_address + section_size) - max_address;
 
-			retval = target_write_buffer(target,
-					image.sections[i].base_address + offset, length, buffer + offset);
-			if (retval != ERROR_OK) {
-				free(buffer);
+		uint32_t written = 0;
+		while (written < length) {
+			uint32_t chunk = MIN(LOAD_IMAGE_CHUNK_SIZE, length - written);
+
+			retval = image_read_section(&image, i, offset + written, chunk, buffer, &buf_cnt);
+			if (retval != ERROR_OK)
 				break;
-			}
-			image_size += length;
-			command_print(CMD, "%u bytes written at address " TARGET_ADDR_FMT "",
-					(unsigned int)length,
-					image.sections[i].base_address + offset);
+			if (buf_cnt == 0)
+				break;
+
+			/* read ahead the next chunk while this one is being written */
+			uint32_t next_size = MIN(LOAD_IMAGE_CHUNK_SIZE, length - written - buf_cnt);
+			if (next_size > 0)
+				image_prefetch_section(&image, i, offset + written + buf_cnt, next_size);
+
+			retval = target_write_buffer(target, base_address + offset + written, buf_cnt, buffer);
+			if (retval != ERROR_OK)
+				break;
+
+			written += buf_cnt;
+			image_size += buf_cnt;
 		}
 
-		free(buffer);
+		if (retval == ERROR_OK)
+			command_print(CMD, "%u bytes written at address " TARGET_ADDR_FMT "",
+					(unsigned int)written,
+					base_address + offset);
 	}
 
+	free(buffer);
+
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
 		command_print(CMD, "downloaded %" PRIu32 " bytes "
 				"in %fs (%0.3f KiB/s)", image_size,
@@ -3712,21 +3905,34 @@ enum verify_mode {
 	IMAGE_CHECKSUM_ONLY = 2
 };
 
+/* verify_image works through each section in chunks of this size, so
+ * memory use stays bounded and a mismatch is found before the rest of the
+ * image has been read */
+#define VERIFY_IMAGE_CHUNK_SIZE		(256 * 1024)
+
 static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode verify)
 {
-	uint8_t *buffer;
+	uint8_t *buffer = NULL;
+	uint8_t *data = NULL;
 	size_t buf_cnt;
 	uint32_t image_size;
 	int i;
 	int retval;
 	uint32_t checksum = 0;
 	uint32_t mem_checksum = 0;
+	bool full_report = false;
+	unsigned int argc = CMD_ARGC;
 
 	struct image image;
 
 	struct target *target = get_current_target(CMD_CTX);
 
-	if (CMD_ARGC < 1)
+	if (verify == IMAGE_VERIFY && argc >= 2 && !strcmp(CMD_ARGV[argc - 1], "full")) {
+		full_report = true;
+		argc--;
+	}
+
+	if (argc < 1 || argc > 3)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	if (!target) {
@@ -3737,7 +3943,7 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 	struct duration bench;
 	duration_start(&bench);
 
-	if (CMD_ARGC >= 2) {
+	if (argc >= 2) {
 		target_addr_t addr;
 		COMMAND_PARSE_ADDRESS(CMD_ARGV[1], addr);
 		image.base_address = addr;
@@ -3749,90 +3955,98 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 
 	image.start_address_set = 0;
 
-	retval = image_open(&image, CMD_ARGV[0], (CMD_ARGC == 3) ? CMD_ARGV[2] : NULL);
+	retval = image_open(&image, CMD_ARGV[0], (argc == 3) ? CMD_ARGV[2] : NULL);
 	if (retval != ERROR_OK)
 		return retval;
 
 	image_size = 0x0;
 	int diffs = 0;
 	retval = ERROR_OK;
-	for (i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (buffer == NULL) {
-			command_print(CMD,
-					"error allocating buffer for section (%d bytes)",
-					(int)(image.sections[i].size));
-			break;
+
+	if (verify >= IMAGE_VERIFY) {
+		buffer = malloc(VERIFY_IMAGE_CHUNK_SIZE);
+		data = malloc(VERIFY_IMAGE_CHUNK_SIZE);
+		if (buffer == NULL || data == NULL) {
+			command_print(CMD, "error allocating verify buffers");
+			retval = ERROR_FAIL;
+			goto done;
 		}
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			break;
+	}
+
+	for (i = 0; i < image.num_sections; i++) {
+		if (verify == IMAGE_TEST) {
+			command_print(CMD, "address " TARGET_ADDR_FMT " length 0x%08" PRIx32,
+						  image.sections[i].base_address,
+						  image.sections[i].size);
+			image_size += image.sections[i].size;
+			continue;
 		}
 
-		if (verify >= IMAGE_VERIFY) {
+		for (uint32_t offset = 0; offset < image.sections[i].size; offset += buf_cnt) {
+			uint32_t chunk = MIN(VERIFY_IMAGE_CHUNK_SIZE, image.sections[i].size - offset);
+			target_addr_t address = image.sections[i].base_address + offset;
+
+			retval = image_read_section(&image, i, offset, chunk, buffer, &buf_cnt);
+			if (retval != ERROR_OK)
+				goto done;
+			if (buf_cnt == 0)
+				break;
+
 			/* calculate checksum of image */
 			retval = image_calculate_checksum(buffer, buf_cnt, &checksum);
-			if (retval != ERROR_OK) {
-				free(buffer);
-				break;
-			}
+			if (retval != ERROR_OK)
+				goto done;
 
-			retval = target_checksum_memory(target, image.sections[i].base_address, buf_cnt, &mem_checksum);
-			if (retval != ERROR_OK) {
-				free(buffer);
-				break;
-			}
-			if ((checksum != mem_checksum) && (verify == IMAGE_CHECKSUM_ONLY)) {
+			retval = target_checksum_memory(target, address, buf_cnt, &mem_checksum);
+			if (retval != ERROR_OK)
+				goto done;
+
+			image_size += buf_cnt;
+			if (checksum == mem_checksum)
+				continue;
+
+			if (verify == IMAGE_CHECKSUM_ONLY) {
 				LOG_ERROR("checksum mismatch");
-				free(buffer);
 				retval = ERROR_FAIL;
 				goto done;
 			}
-			if (checksum != mem_checksum) {
-				/* failed crc checksum, fall back to a binary compare */
-				uint8_t *data;
-
-				if (diffs == 0)
-					LOG_ERROR("checksum mismatch - attempting binary compare");
-
-				data = malloc(buf_cnt);
-
-				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
-				if (retval == ERROR_OK) {
-					uint32_t t;
-					for (t = 0; t < buf_cnt; t++) {
-						if (data[t] != buffer[t]) {
-							command_print(CMD,
-										  "diff %d address 0x%08x. Was 0x%02x instead of 0x%02x",
-										  diffs,
-										  (unsigned)(t + image.sections[i].base_address),
-										  data[t],
-										  buffer[t]);
-							if (diffs++ >= 127) {
-								command_print(CMD, "More than 128 errors, the rest are not printed.");
-								free(data);
-								free(buffer);
-								goto done;
-							}
-						}
-						keep_alive();
+
+			/* failed crc checksum, fall back to a binary compare of this chunk */
+			if (diffs == 0)
+				LOG_ERROR("checksum mismatch - attempting binary compare");
+
+			retval = target_read_buffer(target, address, buf_cnt, data);
+			if (retval != ERROR_OK)
+				goto done;
+
+			for (uint32_t t = 0; t < buf_cnt; t++) {
+				if (data[t] != buffer[t]) {
+					command_print(CMD,
+								  "diff %d address " TARGET_ADDR_FMT ". Was 0x%02x instead of 0x%02x",
+								  diffs,
+								  address + t,
+								  data[t],
+								  buffer[t]);
+					if (diffs++ >= 127) {
+						command_print(CMD, "More than 128 errors, the rest are not printed.");
+						goto done;
 					}
 				}
-				free(data);
 			}
-		} else {
-			command_print(CMD, "address " TARGET_ADDR_FMT " length 0x%08zx",
-						  image.sections[i].base_address,
-						  buf_cnt);
-		}
+			keep_alive();
 
-		free(buffer);
-		image_size += buf_cnt;
+			if (diffs > 0 && !full_report) {
+				command_print(CMD, "Stopped at the first differing block, "
+							  "use 'full' to compare the whole image.");
+				goto done;
+			}
+		}
 	}
 	if (diffs > 0)
 		command_print(CMD, "No more differences found.");
 done:
+	free(buffer);
+	free(data);
 	if (diffs > 0)
 		retval = ERROR_FAIL;
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
@@ -4693,6 +4907,255 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 	return e;
 }
 
+/* Binary mem_batch requests are a sequence of records: a kind byte, a size
+ * byte, the address as a little-endian 64-bit number and, for writes, the
+ * data in target byte order. The reply is the data read, concatenated. */
+#define MEM_BATCH_READ			0
+#define MEM_BATCH_WRITE			1
+#define MEM_BATCH_HEADER_SIZE	10
+
+static bool mem_batch_size_valid(long size)
+{
+	return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+static uint64_t mem_batch_get_value(struct target *target, const struct target_mem_op *op)
+{
+	switch (op->size) {
+		case 8:
+			return target_buffer_get_u64(target, op->data);
+		case 4:
+			return target_buffer_get_u32(target, op->data);
+		case 2:
+			return target_buffer_get_u16(target, op->data);
+		default:
+			return op->data[0];
+	}
+}
+
+static void mem_batch_set_value(struct target *target, struct target_mem_op *op, uint64_t value)
+{
+	switch (op->size) {
+		case 8:
+			target_buffer_set_u64(target, op->data, value);
+			break;
+		case 4:
+			target_buffer_set_u32(target, op->data, value);
+			break;
+		case 2:
+			target_buffer_set_u16(target, op->data, value);
+			break;
+		default:
+			op->data[0] = value;
+			break;
+	}
+}
+
+static int mem_batch_parse_blob(Jim_Interp *interp, const uint8_t *blob, size_t len,
+		struct target_mem_op **ops_out, unsigned int *count_out)
+{
+	struct target_mem_op *ops = NULL;
+	unsigned int count = 0;
+	unsigned int allocated = 0;
+
+	while (len) {
+		uint8_t kind = len >= MEM_BATCH_HEADER_SIZE ? blob[0] : 0xff;
+		uint8_t size = len >= MEM_BATCH_HEADER_SIZE ? blob[1] : 0;
+		size_t record_len = MEM_BATCH_HEADER_SIZE + (kind == MEM_BATCH_WRITE ? size : 0);
+
+		if ((kind != MEM_BATCH_READ && kind != MEM_BATCH_WRITE) ||
+				!mem_batch_size_valid(size) || len < record_len) {
+			Jim_SetResultFormatted(interp, "mem_batch: bad record %d", (int)count);
+			free(ops);
+			return JIM_ERR;
+		}
+
+		if (count == allocated) {
+			allocated = allocated ? allocated * 2 : 64;
+			struct target_mem_op *new_ops = realloc(ops, allocated * sizeof(*ops));
+			if (!new_ops) {
+				free(ops);
+				return JIM_ERR;
+			}
+			ops = new_ops;
+		}
+
+		struct target_mem_op *op = &ops[count++];
+		op->address = le_to_h_u64(blob + 2);
+		op->size = size;
+		op->write = kind == MEM_BATCH_WRITE;
+		if (op->write)
+			memcpy(op->data, blob + MEM_BATCH_HEADER_SIZE, size);
+
+		blob += record_len;
+		len -= record_len;
+	}
+
+	*ops_out = ops;
+	*count_out = count;
+	return JIM_OK;
+}
+
+static int mem_batch_parse_list(Jim_Interp *interp, struct target *target,
+		int argc, Jim_Obj *const *argv, struct target_mem_op *ops)
+{
+	for (int i = 0; i < argc; i++) {
+		int n = Jim_ListLength(interp, argv[i]);
+		const char *kind = n > 0 ? Jim_GetString(Jim_ListGetIndex(interp, argv[i], 0), NULL) : "";
+		bool write = strcmp(kind, "w") == 0;
+		long size = 0;
+		target_addr_t address;
+		uint64_t value = 0;
+
+		if ((!write && strcmp(kind, "r")) || n != (write ? 4 : 3) ||
+				Jim_GetLong(interp, Jim_ListGetIndex(interp, argv[i], 1), &size) != JIM_OK ||
+				!mem_batch_size_valid(size) ||
+				parse_target_addr(Jim_GetString(Jim_ListGetIndex(interp, argv[i], 2), NULL),
+					&address) != ERROR_OK ||
+				(write && parse_u64(Jim_GetString(Jim_ListGetIndex(interp, argv[i], 3), NULL),
+					&value) != ERROR_OK) ||
+				(size < 8 && (value >> (8 * size)))) {
+			Jim_SetResultFormatted(interp, "mem_batch: bad operation \"%#s\"", argv[i]);
+			return JIM_ERR;
+		}
+
+		ops[i].address = address;
+		ops[i].size = size;
+		ops[i].write = write;
+		if (write)
+			mem_batch_set_value(target, &ops[i], value);
+	}
+
+	return JIM_OK;
+}
+
+static int target_mem_batch_jim(Jim_Interp *interp, struct target *target,
+		int argc, Jim_Obj *const *argv)
+{
+	const char *usage = "{r size address} | {w size address value} ... | -binary data | -hex data";
+	struct target_mem_op *ops = NULL;
+	unsigned int count = 0;
+	bool binary = false;
+	bool hex = false;
+	int e;
+
+	if (argc > 0) {
+		const char *opt = Jim_GetString(argv[0], NULL);
+		binary = strcmp(opt, "-binary") == 0;
+		hex = strcmp(opt, "-hex") == 0;
+	}
+
+	if (binary || hex) {
+		if (argc != 2) {
+			Jim_WrongNumArgs(interp, 0, argv, usage);
+			return JIM_ERR;
+		}
+
+		int len;
+		const char *request = Jim_GetString(argv[1], &len);
+		uint8_t *decoded = NULL;
+		if (hex) {
+			decoded = malloc(len / 2 + 1);
+			if (!decoded)
+				return JIM_ERR;
+			if (len % 2 || unhexify(decoded, request, len / 2) != (size_t)len / 2) {
+				Jim_SetResultFormatted(interp, "mem_batch: bad hex data");
+				free(decoded);
+				return JIM_ERR;
+			}
+			len /= 2;
+		}
+		e = mem_batch_parse_blob(interp, hex ? decoded : (const uint8_t *)request, len,
+				&ops, &count);
+		free(decoded);
+	} else {
+		if (argc < 1) {
+			Jim_WrongNumArgs(interp, 0, argv, usage);
+			return JIM_ERR;
+		}
+		count = argc;
+		ops = calloc(count, sizeof(*ops));
+		if (!ops)
+			return JIM_ERR;
+		e = mem_batch_parse_list(interp, target, argc, argv, ops);
+	}
+	if (e != JIM_OK) {
+		free(ops);
+		return e;
+	}
+
+	int retval = target_mem_batch(target, ops, count);
+	if (retval != ERROR_OK) {
+		Jim_SetResultFormatted(interp, "mem_batch: memory access failed");
+		free(ops);
+		return JIM_ERR;
+	}
+
+	if (binary || hex) {
+		size_t len = 0;
+		for (unsigned int i = 0; i < count; i++)
+			len += ops[i].write ? 0 : ops[i].size;
+
+		uint8_t *data = malloc(len + 1);
+		char *text = hex ? malloc(len * 2 + 1) : NULL;
+		if (!data || (hex && !text)) {
+			free(data);
+			free(text);
+			free(ops);
+			return JIM_ERR;
+		}
+
+		uint8_t *p = data;
+		for (unsigned int i = 0; i < count; i++) {
+			if (!ops[i].write) {
+				memcpy(p, ops[i].data, ops[i].size);
+				p += ops[i].size;
+			}
+		}
+
+		if (hex) {
+			hexify(text, data, len, len * 2 + 1);
+			Jim_SetResult(interp, Jim_NewStringObj(interp, text, len * 2));
+		} else {
+			Jim_SetResult(interp, Jim_NewStringObj(interp, (const char *)data, len));
+		}
+		free(text);
+		free(data);
+	} else {
+		Jim_Obj *results = Jim_NewListObj(interp, NULL, 0);
+		for (unsigned int i = 0; i < count; i++) {
+			char buf[24];
+
+			if (ops[i].write)
+				continue;
+			snprintf(buf, sizeof(buf), "0x%0*" PRIx64, (int)ops[i].size * 2,
+					mem_batch_get_value(target, &ops[i]));
+			Jim_ListAppendElement(interp, results, Jim_NewStringObj(interp, buf, -1));
+		}
+		Jim_SetResult(interp, results);
+	}
+
+	free(ops);
+	return JIM_OK;
+}
+
+static int jim_mem_batch(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	struct command_context *context;
+	struct target *target;
+
+	context = current_command_context(interp);
+	assert(context != NULL);
+
+	target = get_current_target(context);
+	if (target == NULL) {
+		LOG_ERROR("mem_batch: no current target");
+		return JIM_ERR;
+	}
+
+	return target_mem_batch_jim(interp, target, argc - 1, argv + 1);
+}
+
 /* FIX? should we propagate errors here rather than printing them
  * and continuing?
  */
@@ -4759,6 +5222,7 @@ enum target_cfg_param {
 	TCFG_WORK_AREA_PHYS,
 	TCFG_WORK_AREA_SIZE,
 	TCFG_WORK_AREA_BACKUP,
+	TCFG_WORK_AREA_PERSISTENT,
 	TCFG_ENDIAN,
 	TCFG_COREID,
 	TCFG_CHAIN_POSITION,
@@ -4768,6 +5232,7 @@ enum target_cfg_param {
 	TCFG_ALT_WORK_AREA_PHYS,
 	TCFG_ALT_WORK_AREA_SIZE,
 	TCFG_ALT_WORK_AREA_BACKUP,
+	TCFG_ALT_WORK_AREA_PERSISTENT,
 	TCFG_DEFER_EXAMINE,
 	TCFG_GDB_PORT,
 };
@@ -4779,6 +5244,7 @@ static Jim_Nvp nvp_config_opts[] = {
 	{ .name = "-work-area-phys",   .value = TCFG_WORK_AREA_PHYS },
 	{ .name = "-work-area-size",   .value = TCFG_WORK_AREA_SIZE },
 	{ .name = "-work-area-backup", .value = TCFG_WORK_AREA_BACKUP },
+	{ .name = "-work-area-persistent", .value = TCFG_WORK_AREA_PERSISTENT },
 	{ .name = "-endian" ,          .value = TCFG_ENDIAN },
 	{ .name = "-coreid",           .value = TCFG_COREID },
 	{ .name = "-chain-position",   .value = TCFG_CHAIN_POSITION },
@@ -4788,6 +5254,7 @@ static Jim_Nvp nvp_config_opts[] = {
 	{ .name = "-alt-work-area-phys",   .value = TCFG_ALT_WORK_AREA_PHYS },
 	{ .name = "-alt-work-area-size",   .value = TCFG_ALT_WORK_AREA_SIZE },
 	{ .name = "-alt-work-area-backup", .value = TCFG_ALT_WORK_AREA_BACKUP },
+	{ .name = "-alt-work-area-persistent", .value = TCFG_ALT_WORK_AREA_PERSISTENT },
 	{ .name = "-defer-examine",    .value = TCFG_DEFER_EXAMINE },
 	{ .name = "-gdb-port",         .value = TCFG_GDB_PORT },
 	{ .name = NULL, .value = -1 }
@@ -5026,6 +5493,29 @@ no_params:
 			/* loop for more e*/
 			break;
 
+		case TCFG_WORK_AREA_PERSISTENT:
+		case TCFG_ALT_WORK_AREA_PERSISTENT:
+			if (goi->isconfigure) {
+				target_free_all_working_areas_restore(target, n->value == TCFG_ALT_WORK_AREA_PERSISTENT ?
+					&target->alt_working_area_cfg : &target->working_area_cfg, 1);
+				e = Jim_GetOpt_Wide(goi, &w);
+				if (e != JIM_OK)
+					return e;
+				if (n->value == TCFG_ALT_WORK_AREA_PERSISTENT)
+					target->alt_working_area_cfg.persistent = (w != 0);
+				else
+					target->working_area_cfg.persistent = (w != 0);
+			} else {
+				if (goi->argc != 0)
+					goto no_params;
+			}
+			if (n->value == TCFG_ALT_WORK_AREA_PERSISTENT)
+				Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->alt_working_area_cfg.persistent));
+			else
+				Jim_SetResult(goi->interp, Jim_NewIntObj(goi->interp, target->working_area_cfg.persistent));
+			/* loop for more */
+			break;
+
 
 		case TCFG_ENDIAN:
 			if (goi->isconfigure) {
@@ -5177,6 +5667,13 @@ static int jim_target_array2mem(Jim_Interp *interp,
 	return target_array2mem(interp, target, argc - 1, argv + 1);
 }
 
+static int jim_target_mem_batch(Jim_Interp *interp,
+		int argc, Jim_Obj *const *argv)
+{
+	struct target *target = Jim_CmdPrivData(interp);
+	return target_mem_batch_jim(interp, target, argc - 1, argv + 1);
+}
+
 static int jim_target_tap_disabled(Jim_Interp *interp)
 {
 	Jim_SetResultFormatted(interp, "[TAP is disabled]");
@@ -5514,6 +6011,17 @@ static const struct command_registration target_instance_command_handlers[] = {
 			"from target memory",
 		.usage = "arrayname bitwidth address count",
 	},
+	{
+		.name = "mem_batch",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_target_mem_batch,
+		.help = "Perform a batch of 8/16/32/64 bit memory reads "
+			"and writes, returning the values read (queued on "
+			"Cortex-M, Xtensa and RISC-V system bus access, one by "
+			"one elsewhere)",
+		.usage = "{r size address} | {w size address value} ... "
+			"| -binary data | -hex data",
+	},
 	{
 		.name = "eventlist",
 		.handler = handle_target_event_list,
@@ -6565,7 +7073,7 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.name = "verify_image",
 		.handler = handle_verify_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "filename [offset [type]]",
+		.usage = "filename [offset [type]] ['full']",
 	},
 	{
 		.name = "test_image",
@@ -6589,6 +7097,17 @@ static const struct command_registration target_exec_command_handlers[] = {
 			"and write the 8/16/32 bit values",
 		.usage = "arrayname bitwidth address count",
 	},
+	{
+		.name = "mem_batch",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_mem_batch,
+		.help = "perform a batch of 8/16/32/64 bit memory reads and "
+			"writes with as few adapter round trips as the target "
+			"allows (queued on Cortex-M, Xtensa and RISC-V system "
+			"bus access, one by one elsewhere), returning the values read",
+		.usage = "{r size address} | {w size address value} ... "
+			"| -binary data | -hex data",
+	},
 	{
 		.name = "reset_nag",
 		.handler = handle_target_reset_nag,
@@ -6633,6 +7152,10 @@ static int target_register_user_commands(struct command_context *cmd_ctx)
 	if (retval != ERROR_OK)
 		return retval;
 
+	retval = live_watch_register_commands(cmd_ctx);
+	if (retval != ERROR_OK)
+		return retval;
+
 
 	return register_commands(cmd_ctx, NULL, target_exec_command_handlers);
 }
@@ -133,6 +133,12 @@ struct working_area_config {
 	target_addr_t phys;			/* physical address */
 	uint32_t size;			/* size in bytes */
 	uint32_t backup;		/* whether the content of the working area has to be preserved */
+	bool persistent;		/* keep working area contents until the target is resumed */
+	uint8_t *saved;			/* persistent mode: original contents of the working area */
+	uint32_t saved_start;	/* persistent mode: saved range offsets */
+	uint32_t saved_end;
+	uint32_t saved_hits;	/* persistent mode: backups served from the saved range */
+	uint32_t skipped_restores;	/* persistent mode: restores deferred until resume */
 	struct working_area *areas;/* list of allocated working areas */
 };
 
@@ -263,6 +269,7 @@ enum target_event {
 	TARGET_EVENT_RESUMED,		/* target resumed to normal execution */
 	TARGET_EVENT_RESUME_START,
 	TARGET_EVENT_RESUME_END,
+	TARGET_EVENT_STEP_START,
 
 	TARGET_EVENT_GDB_START, /* debugger started execution (step/run) */
 	TARGET_EVENT_GDB_END, /* debugger stopped execution (step/run) */
@@ -347,6 +354,14 @@ struct target_memory_check_block {
 	uint32_t result;
 };
 
+/** One access of a batch, see target_mem_batch(). */
+struct target_mem_op {
+	target_addr_t address;
+	uint32_t size;		/* 1, 2, 4 or 8 bytes */
+	bool write;
+	uint8_t data[8];	/* in target byte order; written, or filled in by a read */
+};
+
 int target_register_commands(struct command_context *cmd_ctx);
 int target_examine(void);
 
@@ -620,6 +635,14 @@ int target_write_memory(struct target *target,
 int target_write_phys_memory(struct target *target,
 		target_addr_t address, uint32_t size, uint32_t count, const uint8_t *buffer);
 
+/**
+ * Perform the @a count single-item accesses in @a ops in order, stopping
+ * at the first that fails. Targets implementing target->type->mem_batch
+ * queue them all and flush the debug adapter once; otherwise each is a
+ * target_read_memory() or target_write_memory() of its own.
+ */
+int target_mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count);
+
 /*
  * Write to target memory using the virtual address.
  *
@@ -717,7 +740,12 @@ int target_alloc_alt_working_area_try(struct target *target,
 		uint32_t size, struct working_area **area);
 int target_free_working_area(struct target *target, struct working_area *area);
 int target_free_alt_working_area(struct target *target, struct working_area *area);
+/* Free a working area without writing its backup back, e.g. after a reset */
+int target_discard_working_area(struct target *target, struct working_area *area);
 void target_free_all_working_areas(struct target *target);
+/* Write back (restore != 0) or drop the memory saved for persistent working areas
+ * ("-work-area-persistent"). Done automatically on resume, step, reset and exit. */
+int target_release_persistent_working_areas(struct target *target, int restore);
 uint32_t target_get_working_area_avail(struct target *target);
 uint32_t target_get_alt_working_area_avail(struct target *target);
 
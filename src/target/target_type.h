@@ -144,6 +144,15 @@ struct target_type {
 	int (*write_buffer)(struct target *target, target_addr_t address,
 			uint32_t size, const uint8_t *buffer);
 
+	/**
+	 * Optional; queue a batch of 1, 2 or 4 byte accesses and flush the
+	 * adapter once. Do @b not call this function directly, use
+	 * target_mem_batch() instead, which falls back to one access at a
+	 * time without it.
+	 */
+	int (*mem_batch)(struct target *target, struct target_mem_op *ops,
+			unsigned int count);
+
 	int (*checksum_memory)(struct target *target, target_addr_t address,
 			uint32_t count, uint32_t *checksum);
 	int (*blank_check_memory)(struct target *target,
@@ -528,10 +528,15 @@ static int xtensa_write_dirty_registers(struct target *target)
 			xtensa_queue_exec_ins(xtensa, XT_INS_ROTW(4));
 		}
 	}
-	res = jtag_execute_queue();
+	/* Nothing is read back here, so let the adapter I/O thread push the
+	 * write-back out while the DSR check below is being queued. */
+	struct jtag_future *write_back;
+	res = jtag_execute_queue_async(&write_back);
+	if (res != ERROR_OK)
+		return res;
 	xtensa_core_status_check(target);
 
-	return res;
+	return jtag_future_wait(write_back);
 }
 
 static inline bool xtensa_is_stopped(struct target *target)
@@ -673,6 +678,8 @@ int xtensa_assert_reset(struct target *target)
 		target_name(target),
 		target->coreid,
 		target->target_number);
+	/* RAM is lost, don't write the backup back in the middle of the reset */
+	xtensa_algo_resident_drop(target);
 	target->state = TARGET_RESET;
 	xtensa_queue_pwr_reg_write(xtensa,
 		DMREG_PWRCTL,
@@ -1014,6 +1021,10 @@ int xtensa_resume(struct target *target,
 {
 	LOG_DEBUG("%s:", target_name(target));
 
+	/* application can clobber RAM holding the stub */
+	if (!debug_execution)
+		xtensa_algo_resident_release(target);
+
 	int res = xtensa_prepare_resume(target,
 		current,
 		address,
@@ -1023,7 +1034,12 @@ int xtensa_resume(struct target *target,
 		LOG_ERROR("%s: Failed to prepare for resume!", target_name(target));
 		return res;
 	}
-	res = xtensa_do_resume(target);
+
+	/* Let the adapter I/O thread shift RFDO out while the resume is being
+	 * reported; anything the event handlers queue runs after it. */
+	struct jtag_future *rfdo;
+	xtensa_queue_exec_ins(target_to_xtensa(target), XT_INS_RFDO);
+	res = jtag_execute_queue_async(&rfdo);
 	if (res != ERROR_OK) {
 		LOG_ERROR("%s: Failed to resume!", target_name(target));
 		return res;
@@ -1035,9 +1051,15 @@ int xtensa_resume(struct target *target,
 	else
 		target->state = TARGET_DEBUG_RUNNING;
 	int res1 = target_call_event_callbacks(target, TARGET_EVENT_RESUMED);
-	if (res1 != ERROR_OK)
-		res = res1;
-	return res;
+
+	res = jtag_future_wait(rfdo);
+	if (res != ERROR_OK) {
+		/* the core did not leave debug mode, the next poll sees it halted */
+		LOG_ERROR("%s: Failed to exec RFDO %d!", target_name(target), res);
+		return res;
+	}
+	xtensa_core_status_check(target);
+	return res1;
 }
 
 static bool xtensa_pc_in_winexc(struct target *target, target_addr_t pc)
@@ -1081,6 +1103,9 @@ int xtensa_do_step(struct target *target,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	/* application code is going to run */
+	xtensa_algo_resident_release(target);
+
 	if (xtensa->core_config->debug.icount_sz != 32) {
 		LOG_WARNING("%s: stepping for ICOUNT less then 32 bits is not implemented!",
 			target_name(target));
@@ -1484,12 +1509,121 @@ int xtensa_write_buffer(struct target *target,
 	return xtensa_write_memory(target, address, 1, count, buffer);
 }
 
+/* Queue reading the aligned words that hold [address, address + size) into
+ * words, A3 must be marked dirty */
+static void xtensa_queue_mem_words_read(struct xtensa *xtensa, target_addr_t address,
+	uint32_t size, uint8_t *words)
+{
+	target_addr_t adr = address & ~3;
+	target_addr_t end = (address + size + 3) & ~3;
+
+	xtensa_queue_dbg_reg_write(xtensa, NARADR_DDR, adr);
+	xtensa_queue_exec_ins(xtensa, XT_INS_RSR(XT_SR_DDR, XT_REG_A3));
+	for (; adr != end; adr += 4, words += 4) {
+		xtensa_queue_exec_ins(xtensa, XT_INS_LDDR32P(XT_REG_A3));
+		xtensa_queue_dbg_reg_read(xtensa, NARADR_DDR, words);
+	}
+}
+
+static void xtensa_queue_mem_words_write(struct xtensa *xtensa, target_addr_t address,
+	uint32_t size, const uint8_t *words)
+{
+	target_addr_t adr = address & ~3;
+	target_addr_t end = (address + size + 3) & ~3;
+
+	xtensa_queue_dbg_reg_write(xtensa, NARADR_DDR, adr);
+	xtensa_queue_exec_ins(xtensa, XT_INS_RSR(XT_SR_DDR, XT_REG_A3));
+	for (; adr != end; adr += 4, words += 4) {
+		xtensa_queue_dbg_reg_write(xtensa, NARADR_DDR, buf_get_u32(words, 0, 32));
+		xtensa_queue_exec_ins(xtensa, XT_INS_SDDR32P(XT_REG_A3));
+	}
+}
+
+/**
+ * Run a batch of single memory accesses with one JTAG queue flush.
+ *
+ * Memory is only accessed in aligned words, as in xtensa_read_memory() and
+ * xtensa_write_memory(). A write that doesn't cover a whole aligned word
+ * needs the old word first: it is queued after everything before it, and
+ * the queue is flushed there, so each such write costs one more flush.
+ */
+int xtensa_mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+	int res = ERROR_OK;
+
+	if (target->state != TARGET_HALTED) {
+		LOG_WARNING("%s: %s: target not halted", __func__, target_name(target));
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (!xtensa_memory_op_validate(xtensa, ops[i].address,
+				ops[i].write ? XT_MEM_ACCESS_WRITE : XT_MEM_ACCESS_READ) &&
+			!xtensa->permissive_mode) {
+			LOG_DEBUG("address "TARGET_ADDR_FMT " not %s", ops[i].address,
+				ops[i].write ? "writable" : "readable");
+			return ERROR_FAIL;
+		}
+	}
+
+	/* an access of up to 8 bytes spans at most 3 aligned words */
+	uint8_t *words = calloc(count, 12);
+	if (!words && count) {
+		LOG_ERROR("%s: Out of memory!", __func__);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	/*We're going to use A3 here */
+	xtensa_mark_register_dirty(xtensa, XT_REG_IDX_A3);
+
+	for (unsigned int i = 0; i < count && res == ERROR_OK; i++) {
+		struct target_mem_op *op = &ops[i];
+		uint8_t *op_words = &words[12 * i];
+		bool partial = (op->address & 3) || (op->size & 3);
+
+		if (!op->write || partial)
+			xtensa_queue_mem_words_read(xtensa, op->address, op->size, op_words);
+		if (!op->write)
+			continue;
+
+		if (partial) {
+			res = jtag_execute_queue();
+			if (res == ERROR_OK)
+				res = xtensa_core_status_check(target);
+			if (res != ERROR_OK)
+				break;
+		}
+		memcpy(&op_words[op->address & 3], op->data, op->size);
+		xtensa_queue_mem_words_write(xtensa, op->address, op->size, op_words);
+	}
+
+	int flush_res = jtag_execute_queue();
+	if (flush_res == ERROR_OK)
+		flush_res = xtensa_core_status_check(target);
+	if (res == ERROR_OK)
+		res = flush_res;
+
+	if (res == ERROR_OK) {
+		for (unsigned int i = 0; i < count; i++) {
+			if (!ops[i].write)
+				memcpy(ops[i].data, &words[12 * i + (ops[i].address & 3)], ops[i].size);
+		}
+	} else {
+		LOG_WARNING("%s: Failed batch of %u memory accesses", target_name(target), count);
+	}
+
+	free(words);
+	return res;
+}
+
 int xtensa_checksum_memory(struct target *target,
 	target_addr_t address,
 	uint32_t count,
 	uint32_t *checksum)
 {
-	LOG_WARNING("not implemented yet");
+	/* target_checksum_memory() falls back to reading memory and computing CRC on host */
+	LOG_DEBUG("not implemented yet");
 	return ERROR_FAIL;
 }
 
@@ -1536,6 +1670,7 @@ int xtensa_poll(struct target *target)
 		LOG_INFO("%s: Debug controller %d was reset.", target_name(target), target->coreid);
 	if (xtensa_dm_core_was_reset(&xtensa->dbg_mod)) {
 		LOG_INFO("%s: Core %d was reset.", target_name(target), target->coreid);
+		xtensa_algo_resident_drop(target);
 		if (xtensa->chip_ops != NULL && xtensa->chip_ops->on_reset != NULL)
 			xtensa->chip_ops->on_reset(target);
 	}
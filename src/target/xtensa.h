@@ -266,6 +266,15 @@ struct xtensa_sw_breakpoint {
 	uint8_t insn_sz;	/* 2 or 3 bytes */
 };
 
+/* Algorithm code kept loaded in the working area between runs while the target stays
+ * halted, see xtensa_algorithm.c */
+struct xtensa_algo_resident {
+	struct working_area *code;
+	uint32_t code_size;
+	uint32_t code_checksum;
+	uint32_t reuse_count;
+};
+
 struct xtensa_chip_ops {
 	void (*on_reset)(struct target *target);
 	void (*on_poll)(struct target *target);
@@ -290,6 +299,7 @@ struct xtensa {
 	bool trace_active;
 	bool permissive_mode;
 	bool suppress_dsr_errors;
+	struct xtensa_algo_resident algo_resident;
 };
 
 static inline struct xtensa *target_to_xtensa(struct target *target)
@@ -444,6 +454,7 @@ int xtensa_write_buffer(struct target *target,
 	target_addr_t address,
 	uint32_t count,
 	const uint8_t *buffer);
+int xtensa_mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count);
 int xtensa_checksum_memory(struct target *target, target_addr_t address,
 	uint32_t count, uint32_t *checksum);
 int xtensa_assert_reset(struct target *target);
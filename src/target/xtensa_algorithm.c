@@ -25,6 +25,8 @@
 
 #define XTENSA_STUB_DEBUG            0
 #define XTENSA_ALGORITHM_EXIT_TMO    40000	/* ms */
+/* words of resident code compared with the image before it is reused */
+#define XTENSA_STUB_RESIDENT_PROBES  8
 
 #if XTENSA_STUB_DEBUG
 #define XTENSA_STUB_STACK_STAMP      0xCE
@@ -84,6 +86,137 @@ static void xtensa_algo_args_init(struct xtensa_stub *stub, uint32_t stack_addr)
 								 * interrupts level (6) */
 }
 
+static void xtensa_algo_resident_free(struct target *target, bool restore)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+	struct xtensa_algo_resident *resident = &xtensa->algo_resident;
+
+	if (resident->code_size == 0)
+		return;
+	LOG_DEBUG("%s resident stub code (%u bytes, reused %u times)",
+		restore ? "Release" : "Drop", resident->code_size, resident->reuse_count);
+	/* may have been already freed along with all working areas */
+	if (resident->code) {
+		if (restore)
+			target_free_working_area(target, resident->code);
+		else
+			target_discard_working_area(target, resident->code);
+	}
+	resident->code_size = 0;
+	resident->code_checksum = 0;
+	resident->reuse_count = 0;
+}
+
+void xtensa_algo_resident_release(struct target *target)
+{
+	xtensa_algo_resident_free(target, true);
+}
+
+void xtensa_algo_resident_drop(struct target *target)
+{
+	xtensa_algo_resident_free(target, false);
+}
+
+/* Cheap check that the resident code is still there before reusing it: compare
+ * a few words spread over the code area with the image. */
+static bool xtensa_stub_resident_intact(struct target *target,
+	struct xtensa_algo_resident *resident,
+	const uint8_t *code)
+{
+	uint32_t words = resident->code_size / 4;
+	uint8_t word[4];
+
+	for (uint32_t i = 0; i < XTENSA_STUB_RESIDENT_PROBES && i < words; i++) {
+		uint32_t offset = 4 * (words <= XTENSA_STUB_RESIDENT_PROBES ? i :
+			(uint32_t)((uint64_t)(words - 1) * i / (XTENSA_STUB_RESIDENT_PROBES - 1)));
+		if (target_read_memory(target, resident->code->address + offset, 4, 1,
+				word) != ERROR_OK)
+			return false;
+		if (memcmp(word, code + offset, sizeof(word)) != 0) {
+			LOG_DEBUG("Resident stub code changed at offset %u", offset);
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Places stub code section into the resident working area. The section is uploaded
+ * only if the resident code is missing or its checksum does not match the image. */
+static int xtensa_stub_resident_load(struct target *target,
+	struct xtensa_algo_image *algo_image,
+	int sec_num)
+{
+	struct xtensa *xtensa = target_to_xtensa(target);
+	struct xtensa_algo_resident *resident = &xtensa->algo_resident;
+	struct imagesection *section = &algo_image->image.sections[sec_num];
+	uint32_t checksum, target_checksum;
+	size_t size_read = 0;
+	int retval;
+
+	uint8_t *buf = malloc(section->size);
+	if (buf == NULL) {
+		LOG_ERROR("Failed to alloc memory for stub code!");
+		return ERROR_FAIL;
+	}
+	retval = image_read_section(&algo_image->image, sec_num, 0, section->size, buf, &size_read);
+	if (retval != ERROR_OK || size_read != section->size) {
+		LOG_ERROR("Failed to read stub section (%d)!", retval);
+		retval = ERROR_FAIL;
+		goto _exit;
+	}
+	retval = image_calculate_checksum(buf, section->size, &checksum);
+	if (retval != ERROR_OK)
+		goto _exit;
+
+	if (resident->code && resident->code_size == section->size &&
+		resident->code_checksum == checksum &&
+		(section->base_address == 0 || section->base_address == resident->code->address) &&
+		xtensa_stub_resident_intact(target, resident, buf)) {
+		section->base_address = resident->code->address;
+		resident->reuse_count++;
+		LOG_DEBUG("PROF: Reused resident stub code (%u bytes) @ " TARGET_ADDR_FMT,
+			resident->code_size, resident->code->address);
+		goto _exit;
+	}
+
+	xtensa_algo_resident_release(target);
+	if (target_alloc_working_area(target, section->size, &resident->code) != ERROR_OK) {
+		LOG_ERROR("no working area available, can't alloc space for stub code!");
+		retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		goto _exit;
+	}
+	resident->code_size = section->size;
+	if (section->base_address == 0) {
+		section->base_address = resident->code->address;
+	} else if (resident->code->address != section->base_address) {
+		LOG_ERROR("working area " TARGET_ADDR_FMT " and stub code section " TARGET_ADDR_FMT
+			" address mismatch!", resident->code->address, section->base_address);
+		retval = ERROR_FAIL;
+		goto _release;
+	}
+	retval = target_write_buffer(target, section->base_address, section->size, buf);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Failed to write stub section!");
+		goto _release;
+	}
+	/* code is going to be reused without uploading, so make sure it got there intact */
+	retval = target_checksum_memory(target, section->base_address, section->size,
+		&target_checksum);
+	if (retval != ERROR_OK || target_checksum != checksum) {
+		LOG_ERROR("Resident stub code checksum mismatch (%x != %x)!", target_checksum, checksum);
+		retval = ERROR_FAIL;
+		goto _release;
+	}
+	resident->code_checksum = checksum;
+	goto _exit;
+
+_release:
+	xtensa_algo_resident_release(target);
+_exit:
+	free(buf);
+	return retval;
+}
+
 static int xtensa_stub_load(struct target *target,
 	struct xtensa_algo_image *algo_image,
 	struct xtensa_stub *stub,
@@ -113,7 +246,12 @@ static int xtensa_stub_load(struct target *target,
 				section->base_address,
 				section->size,
 				section->flags);
-			if (section->flags & IMAGE_ELF_PHF_EXEC) {
+			if ((section->flags & IMAGE_ELF_PHF_EXEC) && algo_image->resident) {
+				retval = xtensa_stub_resident_load(target, algo_image, i);
+				if (retval != ERROR_OK)
+					goto _on_error;
+				continue;
+			} else if (section->flags & IMAGE_ELF_PHF_EXEC) {
 				if (target_alloc_working_area(target, section->size,
 						&stub->code) != ERROR_OK) {
 					LOG_ERROR(
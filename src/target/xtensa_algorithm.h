@@ -175,6 +175,9 @@ struct xtensa_algo_image {
 	struct image image;
 	/** Stub BSS section size. */
 	uint32_t bss_size;
+	/** Keep stub code loaded after the run. Subsequent runs of the same image
+	 * only reload the data section until the target is resumed or reset. */
+	bool resident;
 };
 
 struct xtensa_algo_run_data;
@@ -364,4 +367,21 @@ int xtensa_run_algorithm_onboard(struct target *target,
 	struct xtensa_algo_run_data *run,
 	void *func_entry);
 
+/**
+ * Releases the working area holding resident algorithm code, if any, and
+ * restores its backup. Called when the target is resumed (not on behalf of
+ * the debugger) or stepped.
+ *
+ * @param target Pointer to target.
+ */
+void xtensa_algo_resident_release(struct target *target);
+
+/**
+ * Forgets the resident algorithm code without touching target memory.
+ * Called on reset, when RAM contents are gone anyway.
+ *
+ * @param target Pointer to target.
+ */
+void xtensa_algo_resident_drop(struct target *target);
+
 #endif	/* XTENSA_ESP32_H */
@@ -246,6 +246,27 @@ int xtensa_mcore_write_memory(struct target *target,
 	return sub_target->type->write_memory(sub_target, address, size, count, buffer);
 }
 
+int xtensa_mcore_mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count)
+{
+	struct xtensa_mcore_common *xtensa_mcore = target_to_xtensa_mcore(target);
+	struct target *sub_target = &xtensa_mcore->cores_targets[xtensa_mcore->active_core];
+	if (sub_target->type->mem_batch)
+		return sub_target->type->mem_batch(sub_target, ops, count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		int ret;
+		if (ops[i].write)
+			ret = sub_target->type->write_memory(sub_target, ops[i].address, ops[i].size, 1,
+				ops[i].data);
+		else
+			ret = sub_target->type->read_memory(sub_target, ops[i].address, ops[i].size, 1,
+				ops[i].data);
+		if (ret != ERROR_OK)
+			return ret;
+	}
+	return ERROR_OK;
+}
+
 int xtensa_mcore_write_buffer(struct target *target,
 	target_addr_t address,
 	uint32_t count,
@@ -109,6 +109,7 @@ int xtensa_mcore_write_memory(struct target *target,
 	uint32_t size,
 	uint32_t count,
 	const uint8_t *buffer);
+int xtensa_mcore_mem_batch(struct target *target, struct target_mem_op *ops, unsigned int count);
 int xtensa_mcore_write_buffer(struct target *target,
 	target_addr_t address,
 	uint32_t count,
@@ -0,0 +1,141 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+/*
+ * Host-side check of crc32_gdb() from src/helper/crc32.c against the plain
+ * bytewise algorithm GDB uses, plus a throughput comparison of the two.
+ * From the top of the source tree:
+ *
+ *   gcc -O2 -Isrc/helper -o crc32_test testing/crc32/crc32_test.c src/helper/crc32.c
+ *   ./crc32_test          # verify only
+ *   ./crc32_test -b       # verify, then benchmark on a 16 MiB buffer
+ *
+ * Exits with 0 when every CRC matches.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc32.h"
+
+#define BENCH_SIZE	(16 * 1024 * 1024)
+
+/* the loop image_calculate_checksum() used before slice-by-8 */
+static uint32_t crc32_bytewise(uint32_t crc, const uint8_t *buffer, size_t nbytes)
+{
+	static uint32_t table[256];
+	static bool first_init;
+
+	if (!first_init) {
+		for (unsigned int i = 0; i < 256; i++) {
+			uint32_t c = i << 24;
+			for (unsigned int j = 0; j < 8; j++)
+				c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
+			table[i] = c;
+		}
+		first_init = true;
+	}
+
+	while (nbytes--)
+		crc = (crc << 8) ^ table[((crc >> 24) ^ *buffer++) & 255];
+	return crc;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+	bool bench = argc > 1 && strcmp(argv[1], "-b") == 0;
+	int failures = 0;
+
+	/* CRC-32/MPEG-2 check value, the same parameters as GDB's CRC */
+	const char *check = "123456789";
+	uint32_t crc = crc32_gdb(0xffffffff, (const uint8_t *)check, strlen(check));
+	if (crc != 0x0376e6e7) {
+		printf("FAIL: check value 0x%08" PRIx32 ", expected 0x0376e6e7\n", crc);
+		failures++;
+	}
+
+	uint8_t *buffer = malloc(BENCH_SIZE);
+	if (!buffer) {
+		printf("FAIL: out of memory\n");
+		return 1;
+	}
+	srand(1);
+	for (size_t i = 0; i < BENCH_SIZE; i++)
+		buffer[i] = rand();
+
+	/* every alignment and tail length, then random runs */
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t len = 0; len < 64; len++) {
+			if (crc32_gdb(0xffffffff, buffer + offset, len) !=
+					crc32_bytewise(0xffffffff, buffer + offset, len)) {
+				printf("FAIL: offset %zu length %zu\n", offset, len);
+				failures++;
+			}
+		}
+	}
+	for (int i = 0; i < 2000; i++) {
+		size_t offset = rand() % 4096;
+		size_t len = rand() % 65536;
+		if (crc32_gdb(0xffffffff, buffer + offset, len) !=
+				crc32_bytewise(0xffffffff, buffer + offset, len)) {
+			printf("FAIL: offset %zu length %zu\n", offset, len);
+			failures++;
+		}
+	}
+
+	/* image_calculate_checksum() feeds the CRC in runs */
+	uint32_t whole = crc32_bytewise(0xffffffff, buffer, 1000003);
+	uint32_t runs = 0xffffffff;
+	for (size_t done = 0; done < 1000003; done += 32771)
+		runs = crc32_gdb(runs, buffer + done, done + 32771 > 1000003 ? 1000003 - done : 32771);
+	if (runs != whole) {
+		printf("FAIL: CRC in runs 0x%08" PRIx32 ", expected 0x%08" PRIx32 "\n", runs, whole);
+		failures++;
+	}
+
+	if (bench && !failures) {
+		double t0 = now();
+		uint32_t a = crc32_bytewise(0xffffffff, buffer, BENCH_SIZE);
+		double t1 = now();
+		uint32_t b = crc32_gdb(0xffffffff, buffer, BENCH_SIZE);
+		double t2 = now();
+		if (a != b) {
+			printf("FAIL: 16 MiB buffer\n");
+			failures++;
+		}
+		printf("bytewise %.0f MB/s, crc32_gdb %.0f MB/s\n",
+			BENCH_SIZE / 1e6 / (t1 - t0), BENCH_SIZE / 1e6 / (t2 - t1));
+	}
+
+	free(buffer);
+
+	if (failures) {
+		printf("%d CRC mismatches\n", failures);
+		return 1;
+	}
+	printf("all CRCs match\n");
+	return 0;
+}